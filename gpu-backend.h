@@ -0,0 +1,128 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Sampling backend interface
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#ifndef GPU_BACKEND_H
+#define GPU_BACKEND_H
+
+#include <glib.h>
+
+#include <nvml.h>
+
+/* A sampling backend is a table of functions with the same signatures as
+ * the NVML calls the plugin makes, so the sampler code reads the same
+ * whether it talks to the driver or to a synthetic GPU.  Field names
+ * are the NVML function names without the "nvml" prefix. */
+typedef struct {
+    const gchar  *name;
+    
+    nvmlReturn_t (*Init)(void);
+    nvmlReturn_t (*Shutdown)(void);
+    const char * (*ErrorString)(nvmlReturn_t result);
+    
+    nvmlReturn_t (*DeviceGetCount)(unsigned int *deviceCount);
+    nvmlReturn_t (*DeviceGetHandleByIndex)(unsigned int index, nvmlDevice_t *device);
+    nvmlReturn_t (*DeviceGetHandleByUUID)(const char *uuid, nvmlDevice_t *device);
+    nvmlReturn_t (*DeviceGetName)(nvmlDevice_t device, char *name, unsigned int length);
+    nvmlReturn_t (*DeviceGetUUID)(nvmlDevice_t device, char *uuid, unsigned int length);
+    nvmlReturn_t (*DeviceGetPciInfo)(nvmlDevice_t device, nvmlPciInfo_t *pci);
+    nvmlReturn_t (*DeviceGetTemperatureThreshold)(nvmlDevice_t device,
+                                                  nvmlTemperatureThresholds_t thresholdType,
+                                                  unsigned int *temp);
+    
+    nvmlReturn_t (*DeviceGetUtilizationRates)(nvmlDevice_t device, nvmlUtilization_t *utilization);
+    nvmlReturn_t (*DeviceGetMemoryInfo)(nvmlDevice_t device, nvmlMemory_t *memory);
+    nvmlReturn_t (*DeviceGetTemperature)(nvmlDevice_t device, nvmlTemperatureSensors_t sensorType,
+                                         unsigned int *temp);
+    nvmlReturn_t (*DeviceGetPowerUsage)(nvmlDevice_t device, unsigned int *power);
+    nvmlReturn_t (*DeviceGetCurrentClocksThrottleReasons)(nvmlDevice_t device,
+                                                          unsigned long long *clocksThrottleReasons);
+    nvmlReturn_t (*DeviceGetFieldValues)(nvmlDevice_t device, int valuesCount,
+                                         nvmlFieldValue_t *values);
+    nvmlReturn_t (*DeviceGetSamples)(nvmlDevice_t device, nvmlSamplingType_t type,
+                                     unsigned long long lastSeenTimeStamp,
+                                     nvmlValueType_t *sampleValType,
+                                     unsigned int *sampleCount, nvmlSample_t *samples);
+    
+    /* Processes using the GPU */
+    nvmlReturn_t (*DeviceGetComputeRunningProcesses)(nvmlDevice_t device, unsigned int *infoCount,
+                                                     nvmlProcessInfo_t *infos);
+    nvmlReturn_t (*DeviceGetGraphicsRunningProcesses)(nvmlDevice_t device, unsigned int *infoCount,
+                                                      nvmlProcessInfo_t *infos);
+    nvmlReturn_t (*DeviceGetProcessUtilization)(nvmlDevice_t device,
+                                                nvmlProcessUtilizationSample_t *utilization,
+                                                unsigned int *processSamplesCount,
+                                                unsigned long long lastSeenTimeStamp);
+    
+    /* Events */
+    nvmlReturn_t (*EventSetCreate)(nvmlEventSet_t *set);
+    nvmlReturn_t (*DeviceGetSupportedEventTypes)(nvmlDevice_t device,
+                                                 unsigned long long *eventTypes);
+    nvmlReturn_t (*DeviceRegisterEvents)(nvmlDevice_t device, unsigned long long eventTypes,
+                                         nvmlEventSet_t set);
+    nvmlReturn_t (*EventSetWait)(nvmlEventSet_t set, nvmlEventData_t *data,
+                                 unsigned int timeoutms);
+    nvmlReturn_t (*EventSetFree)(nvmlEventSet_t set);
+    
+    /* MIG enumeration */
+    nvmlReturn_t (*DeviceGetMigMode)(nvmlDevice_t device, unsigned int *currentMode,
+                                     unsigned int *pendingMode);
+    nvmlReturn_t (*DeviceGetMaxMigDeviceCount)(nvmlDevice_t device, unsigned int *count);
+    nvmlReturn_t (*DeviceGetMigDeviceHandleByIndex)(nvmlDevice_t device, unsigned int index,
+                                                    nvmlDevice_t *migDevice);
+    nvmlReturn_t (*DeviceGetGpuInstanceId)(nvmlDevice_t device, unsigned int *id);
+    
+    /* GPU performance monitoring, the only per MIG instance utilization */
+    nvmlReturn_t (*GpmQueryDeviceSupport)(nvmlDevice_t device, nvmlGpmSupport_t *gpmSupport);
+    nvmlReturn_t (*GpmSampleAlloc)(nvmlGpmSample_t *gpmSample);
+    nvmlReturn_t (*GpmSampleFree)(nvmlGpmSample_t gpmSample);
+    nvmlReturn_t (*GpmMigSampleGet)(nvmlDevice_t device, unsigned int gpuInstanceId,
+                                    nvmlGpmSample_t gpmSample);
+    nvmlReturn_t (*GpmMetricsGet)(nvmlGpmMetricsGet_t *metricsGet);
+} GpuBackend;
+
+/* Environment variable selecting the backend ("nvml" or "synthetic") */
+#define GPU_BACKEND_ENV "GKRELLM_GPU_BACKEND"
+
+/* Environment variable configuring the synthetic backend */
+#define GPU_SYNTHETIC_ENV "GKRELLM_GPU_SYNTHETIC"
+
+/* The NVIDIA driver, loaded from libnvidia-ml at run time; NULL if the
+ * library is missing or too old */
+const GpuBackend *gpu_backend_nvml(void);
+
+/* Deterministic fake GPUs, configured from a spec string such as
+ * "gpus=4,wave=sine,period=60,latency=500,lost=2@30,mig=7,procs=3,xid=1@20" */
+const GpuBackend *gpu_backend_synthetic(const gchar *spec);
+
+#endif /* GPU_BACKEND_H */
@@ -0,0 +1,428 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - OpenMetrics exporter on a local socket
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#include "gpu-exporter.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+/* The exporter speaks just enough HTTP/1.0 for a Prometheus scrape: each
+ * connection sends one request, gets the current response and is closed.
+ * The response, headers included, is built once per publish and shared
+ * by every scrape until the next one, so a scrape costs a read and a
+ * write and never touches NVML. */
+
+#define GPU_EXPORTER_MAX_CLIENTS 8     /* Connections served at once */
+#define GPU_EXPORTER_REQUEST_MAX 2048  /* Longest request header read */
+#define GPU_EXPORTER_TIMEOUT_S 5       /* Time a client has to finish */
+
+#define GPU_EXPORTER_CONTENT_TYPE \
+    "application/openmetrics-text; version=1.0.0; charset=utf-8"
+
+struct _GpuExporter {
+    gint         fd;               /* Listening socket */
+    guint        watch;            /* Accept watch */
+    gchar        *unix_path;       /* Socket file to remove, NULL for TCP */
+    GBytes       *response;        /* Current response, NULL until published */
+    GList        *clients;
+};
+
+typedef struct {
+    GpuExporter  *exporter;
+    gint         fd;
+    guint        watch;            /* Read, then write, watch */
+    guint        timeout;
+    gchar        request[GPU_EXPORTER_REQUEST_MAX];
+    gsize        received;
+    GBytes       *response;        /* Response being sent, a reference */
+    gsize        sent;
+} GpuExporterClient;
+
+static const gchar response_unavailable[] =
+    "HTTP/1.0 503 Service Unavailable\r\nContent-Length: 0\r\n\r\n";
+static const gchar response_bad_method[] =
+    "HTTP/1.0 405 Method Not Allowed\r\nAllow: GET\r\nContent-Length: 0\r\n\r\n";
+
+static void
+client_free(GpuExporterClient *client)
+{
+    GpuExporter *exporter = client->exporter;
+    
+    exporter->clients = g_list_remove(exporter->clients, client);
+    if (client->watch) {
+        g_source_remove(client->watch);
+    }
+    if (client->timeout) {
+        g_source_remove(client->timeout);
+    }
+    if (client->response) {
+        g_bytes_unref(client->response);
+    }
+    close(client->fd);
+    g_free(client);
+}
+
+static gboolean
+client_timeout(gpointer data)
+{
+    GpuExporterClient *client = data;
+    
+    client->timeout = 0;
+    client_free(client);
+    return FALSE;
+}
+
+static gboolean
+client_write(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    GpuExporterClient *client = data;
+    gsize length;
+    const gchar *bytes = g_bytes_get_data(client->response, &length);
+    gssize n;
+    
+    if (condition & (G_IO_ERR | G_IO_HUP | G_IO_NVAL)) {
+        client->watch = 0;
+        client_free(client);
+        return FALSE;
+    }
+    
+    /* MSG_NOSIGNAL: a scraper hanging up must not raise SIGPIPE in GKrellM */
+    n = send(client->fd, bytes + client->sent, length - client->sent, MSG_NOSIGNAL);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return TRUE;
+    }
+    if (n > 0) {
+        client->sent += n;
+    }
+    if (n <= 0 || client->sent == length) {
+        client->watch = 0;
+        client_free(client);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* Start sending once the request header is in */
+static void
+client_respond(GpuExporterClient *client)
+{
+    GIOChannel *channel;
+    
+    if (strncmp(client->request, "GET ", 4) != 0) {
+        client->response = g_bytes_new_static(response_bad_method,
+                                              sizeof(response_bad_method) - 1);
+    }
+    else if (client->exporter->response) {
+        client->response = g_bytes_ref(client->exporter->response);
+    }
+    else {
+        client->response = g_bytes_new_static(response_unavailable,
+                                              sizeof(response_unavailable) - 1);
+    }
+    
+    channel = g_io_channel_unix_new(client->fd);
+    client->watch = g_io_add_watch(channel, G_IO_OUT | G_IO_ERR | G_IO_HUP,
+                                   client_write, client);
+    g_io_channel_unref(channel);
+}
+
+static gboolean
+client_read(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    GpuExporterClient *client = data;
+    gssize n;
+    
+    n = recv(client->fd, client->request + client->received,
+             sizeof(client->request) - 1 - client->received, 0);
+    if (n < 0 && (errno == EAGAIN || errno == EINTR)) {
+        return TRUE;
+    }
+    if (n <= 0) {
+        client->watch = 0;
+        client_free(client);
+        return FALSE;
+    }
+    client->received += n;
+    client->request[client->received] = '\0';
+    
+    if (strstr(client->request, "\r\n\r\n") || strstr(client->request, "\n\n")) {
+        client_respond(client);
+        return FALSE;
+    }
+    if (client->received == sizeof(client->request) - 1) {
+        /* Headers this long are not from a scraper */
+        client->watch = 0;
+        client_free(client);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+static gboolean
+exporter_accept(GIOChannel *channel, GIOCondition condition, gpointer data)
+{
+    GpuExporter *exporter = data;
+    GpuExporterClient *client;
+    GIOChannel *client_channel;
+    gint fd;
+    
+    fd = accept4(exporter->fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+        return TRUE;
+    }
+    if (g_list_length(exporter->clients) >= GPU_EXPORTER_MAX_CLIENTS) {
+        close(fd);
+        return TRUE;
+    }
+    
+    client = g_new0(GpuExporterClient, 1);
+    client->exporter = exporter;
+    client->fd = fd;
+    client_channel = g_io_channel_unix_new(fd);
+    client->watch = g_io_add_watch(client_channel, G_IO_IN | G_IO_ERR | G_IO_HUP,
+                                   client_read, client);
+    g_io_channel_unref(client_channel);
+    client->timeout = g_timeout_add_seconds(GPU_EXPORTER_TIMEOUT_S,
+                                            client_timeout, client);
+    exporter->clients = g_list_prepend(exporter->clients, client);
+    return TRUE;
+}
+
+/* A socket file left by a crashed GKrellM is removed, one that still
+ * accepts connections belongs to another exporter and is left alone */
+static gboolean
+unix_path_available(const gchar *path, const struct sockaddr_un *addr)
+{
+    struct stat st;
+    gint fd, result;
+    
+    if (lstat(path, &st) < 0) {
+        return errno == ENOENT;
+    }
+    if (!S_ISSOCK(st.st_mode)) {
+        return FALSE;
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    result = connect(fd, (const struct sockaddr *) addr, sizeof(*addr));
+    close(fd);
+    if (result == 0) {
+        return FALSE;
+    }
+    return unlink(path) == 0;
+}
+
+static gint
+listen_unix(const gchar *path)
+{
+    struct sockaddr_un addr;
+    gint fd;
+    
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        g_warning("GPU plugin: exporter socket path %s is too long\n", path);
+        return -1;
+    }
+    g_strlcpy(addr.sun_path, path, sizeof(addr.sun_path));
+    if (!unix_path_available(path, &addr)) {
+        g_warning("GPU plugin: exporter socket %s is in use\n", path);
+        return -1;
+    }
+    
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0 || bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        g_warning("GPU plugin: cannot bind exporter to %s: %s\n", path, g_strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static gboolean
+is_loopback(const struct sockaddr *sa)
+{
+    if (sa->sa_family == AF_INET) {
+        return (ntohl(((const struct sockaddr_in *) sa)->sin_addr.s_addr) >> 24) == 127;
+    }
+    if (sa->sa_family == AF_INET6) {
+        return IN6_IS_ADDR_LOOPBACK(&((const struct sockaddr_in6 *) sa)->sin6_addr);
+    }
+    return FALSE;
+}
+
+/* Metrics are only served to this host, so every address the host name
+ * resolves to must be a loopback address */
+static gint
+listen_tcp(const gchar *address)
+{
+    struct addrinfo hints, *ai, *res;
+    const gchar *colon = strrchr(address, ':');
+    gchar *host;
+    const gchar *port;
+    gint fd = -1, one = 1, result;
+    
+    if (colon) {
+        host = g_strndup(address, colon - address);
+        port = colon + 1;
+    }
+    else {
+        host = g_strdup("127.0.0.1");
+        port = address;
+    }
+    if (host[0] == '[' && host[strlen(host) - 1] == ']') {
+        memmove(host, host + 1, strlen(host) - 2);
+        host[strlen(host) - 2] = '\0';
+    }
+    
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_NUMERICSERV;
+    result = getaddrinfo(host, port, &hints, &res);
+    if (result != 0) {
+        g_warning("GPU plugin: bad exporter address %s: %s\n", address, gai_strerror(result));
+        g_free(host);
+        return -1;
+    }
+    for (ai = res; ai; ai = ai->ai_next) {
+        if (!is_loopback(ai->ai_addr)) {
+            g_warning("GPU plugin: exporter address %s is not a loopback address\n", address);
+            goto out;
+        }
+    }
+    
+    for (ai = res; ai && fd < 0; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                    ai->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    if (fd < 0) {
+        g_warning("GPU plugin: cannot bind exporter to %s: %s\n", address, g_strerror(errno));
+    }
+    
+out:
+    freeaddrinfo(res);
+    g_free(host);
+    return fd;
+}
+
+GpuExporter *
+gpu_exporter_new(const gchar *address)
+{
+    GpuExporter *exporter;
+    GIOChannel *channel;
+    gint fd;
+    
+    if (g_str_has_prefix(address, "unix:")) {
+        fd = listen_unix(address + 5);
+    }
+    else {
+        fd = listen_tcp(address);
+    }
+    if (fd < 0) {
+        return NULL;
+    }
+    if (listen(fd, GPU_EXPORTER_MAX_CLIENTS) < 0) {
+        g_warning("GPU plugin: cannot listen on %s: %s\n", address, g_strerror(errno));
+        close(fd);
+        return NULL;
+    }
+    
+    exporter = g_new0(GpuExporter, 1);
+    exporter->fd = fd;
+    if (g_str_has_prefix(address, "unix:")) {
+        exporter->unix_path = g_strdup(address + 5);
+    }
+    channel = g_io_channel_unix_new(fd);
+    exporter->watch = g_io_add_watch(channel, G_IO_IN, exporter_accept, exporter);
+    g_io_channel_unref(channel);
+    
+    return exporter;
+}
+
+void
+gpu_exporter_free(GpuExporter *exporter)
+{
+    if (!exporter) {
+        return;
+    }
+    while (exporter->clients) {
+        client_free(exporter->clients->data);
+    }
+    g_source_remove(exporter->watch);
+    close(exporter->fd);
+    if (exporter->unix_path) {
+        unlink(exporter->unix_path);
+        g_free(exporter->unix_path);
+    }
+    if (exporter->response) {
+        g_bytes_unref(exporter->response);
+    }
+    g_free(exporter);
+}
+
+void
+gpu_exporter_publish(GpuExporter *exporter, const gchar *text, gsize length)
+{
+    GString *response;
+    
+    response = g_string_sized_new(length + 128);
+    g_string_printf(response,
+                    "HTTP/1.0 200 OK\r\n"
+                    "Content-Type: " GPU_EXPORTER_CONTENT_TYPE "\r\n"
+                    "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+                    "\r\n", length);
+    g_string_append_len(response, text, length);
+    
+    if (exporter->response) {
+        g_bytes_unref(exporter->response);
+    }
+    exporter->response = g_string_free_to_bytes(response);
+}
@@ -0,0 +1,53 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - OpenMetrics exporter
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#ifndef GPU_EXPORTER_H
+#define GPU_EXPORTER_H
+
+#include <glib.h>
+
+typedef struct _GpuExporter GpuExporter;
+
+/* Listen on address, "unix:PATH" for a Unix domain socket or "[HOST:]PORT"
+ * for a loopback TCP port, and serve scrapes from the GLib main loop.
+ * NULL if the address is not local or cannot be bound. */
+GpuExporter *gpu_exporter_new(const gchar *address);
+
+void gpu_exporter_free(GpuExporter *exporter);
+
+/* Replace the metrics served, OpenMetrics text ending in "# EOF".
+ * Scrapes in progress finish with the text they started with. */
+void gpu_exporter_publish(GpuExporter *exporter, const gchar *text, gsize length);
+
+#endif /* GPU_EXPORTER_H */
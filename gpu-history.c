@@ -0,0 +1,206 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Persistent chart history in a memory-mapped file
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#include "gpu-history.h"
+
+#include <glib/gstdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+/* A history file is a header followed by one ring of points per tier.
+ * Every point sits at a fixed place, its period modulo the ring size, so
+ * recording a second updates a point in place in each tier and the file
+ * never grows.  A point left from an earlier pass around the ring is
+ * told apart by its period. */
+
+#define GPU_HISTORY_MAGIC "GKGPUHST"
+#define GPU_HISTORY_VERSION 1
+
+static const guint tier_resolution[GPU_HISTORY_TIERS] = { 1, 60, 3600 };
+static const guint tier_points[GPU_HISTORY_TIERS] = {
+    3600,                          /* An hour of seconds */
+    1440,                          /* A day of minutes */
+    720                            /* A month of hours */
+};
+
+typedef struct {
+    gchar        magic[8];         /* GPU_HISTORY_MAGIC, not terminated */
+    guint32      version;
+    guint32      point_size;       /* sizeof(GpuHistoryPoint) */
+    guint32      resolution[GPU_HISTORY_TIERS];
+    guint32      points[GPU_HISTORY_TIERS];
+} GpuHistoryHeader;
+
+G_STATIC_ASSERT(sizeof(GpuHistoryPoint) == 28);
+
+struct _GpuHistory {
+    gpointer     map;              /* The whole file */
+    gsize        size;
+    GpuHistoryPoint *tiers[GPU_HISTORY_TIERS];
+};
+
+static void
+history_header_init(GpuHistoryHeader *header)
+{
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, GPU_HISTORY_MAGIC, sizeof(header->magic));
+    header->version = GPU_HISTORY_VERSION;
+    header->point_size = sizeof(GpuHistoryPoint);
+    for (gint i = 0; i < GPU_HISTORY_TIERS; ++i) {
+        header->resolution[i] = tier_resolution[i];
+        header->points[i] = tier_points[i];
+    }
+}
+
+GpuHistory *
+gpu_history_open(const gchar *path)
+{
+    GpuHistoryHeader header;
+    GpuHistory *history;
+    struct stat st;
+    gpointer map;
+    gsize size, offset;
+    gint fd;
+    
+    history_header_init(&header);
+    size = sizeof(header);
+    for (gint i = 0; i < GPU_HISTORY_TIERS; ++i) {
+        size += tier_points[i] * sizeof(GpuHistoryPoint);
+    }
+    
+    fd = g_open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        g_warning("GPU plugin: cannot open %s: %s\n", path, g_strerror(errno));
+        return NULL;
+    }
+    
+    /* A file of another size is from another layout; start it over */
+    if (fstat(fd, &st) < 0 || (gsize) st.st_size != size) {
+        if (ftruncate(fd, 0) < 0 || ftruncate(fd, (off_t) size) < 0) {
+            g_warning("GPU plugin: cannot size %s: %s\n", path, g_strerror(errno));
+            close(fd);
+            return NULL;
+        }
+    }
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        g_warning("GPU plugin: cannot map %s: %s\n", path, g_strerror(errno));
+        return NULL;
+    }
+    
+    if (memcmp(map, &header, sizeof(header)) != 0) {
+        memset(map, 0, size);
+        memcpy(map, &header, sizeof(header));
+    }
+    
+    history = g_new0(GpuHistory, 1);
+    history->map = map;
+    history->size = size;
+    offset = sizeof(header);
+    for (gint i = 0; i < GPU_HISTORY_TIERS; ++i) {
+        history->tiers[i] = (GpuHistoryPoint *) ((guint8 *) map + offset);
+        offset += tier_points[i] * sizeof(GpuHistoryPoint);
+    }
+    
+    return history;
+}
+
+void
+gpu_history_close(GpuHistory *history)
+{
+    if (!history) {
+        return;
+    }
+    munmap(history->map, history->size);
+    g_free(history);
+}
+
+/* Fold the second into the point holding it in each tier, so the
+ * coarser tiers are kept up to date as it goes rather than rebuilt */
+void
+gpu_history_insert(GpuHistory *history, gint64 time, const guint8 *values)
+{
+    GpuHistoryPoint *point;
+    guint32 period;
+    
+    for (gint t = 0; t < GPU_HISTORY_TIERS; ++t) {
+        period = (guint32) (time / tier_resolution[t]);
+        point = &history->tiers[t][period % tier_points[t]];
+        
+        if (point->period != period || point->count == 0) {
+            memset(point, 0, sizeof(*point));
+            point->period = period;
+            memset(point->min, 0xff, sizeof(point->min));
+        }
+        for (gint s = 0; s < GPU_HISTORY_SERIES; ++s) {
+            point->min[s] = MIN(point->min[s], values[s]);
+            point->max[s] = MAX(point->max[s], values[s]);
+            point->sum[s] += values[s];
+        }
+        point->count++;
+    }
+}
+
+void
+gpu_history_read(GpuHistory *history, gint tier, gint64 time, gint n,
+                 GpuHistoryPoint *points)
+{
+    guint32 last = (guint32) (time / tier_resolution[tier]);
+    guint32 period;
+    GpuHistoryPoint *point;
+    
+    for (gint i = 0; i < n; ++i) {
+        period = last - (guint32) (n - 1 - i);
+        point = &history->tiers[tier][period % tier_points[tier]];
+        
+        if (point->period == period && point->count > 0) {
+            points[i] = *point;
+        }
+        else {
+            memset(&points[i], 0, sizeof(points[i]));
+            points[i].period = period;
+        }
+    }
+}
+
+guint
+gpu_history_resolution(gint tier)
+{
+    return tier_resolution[tier];
+}
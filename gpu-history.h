@@ -0,0 +1,88 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Persistent chart history
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#ifndef GPU_HISTORY_H
+#define GPU_HISTORY_H
+
+#include <glib.h>
+
+/* Resolutions a history keeps, finest first */
+enum {
+    GPU_HISTORY_SECONDS,
+    GPU_HISTORY_MINUTES,
+    GPU_HISTORY_HOURS,
+    GPU_HISTORY_TIERS
+};
+
+/* Values recorded each second, as percentages */
+enum {
+    GPU_HISTORY_UTILIZATION,       /* Mean utilization over the second */
+    GPU_HISTORY_PEAK,              /* Peak utilization over the second */
+    GPU_HISTORY_MEMORY,            /* Memory used */
+    GPU_HISTORY_SERIES
+};
+
+/* One point of a tier: the seconds that fell into it reduced to the
+ * minimum, maximum and sum of each series.  This is the on-disk layout,
+ * so it is fixed width. */
+typedef struct {
+    guint32      period;           /* Time divided by the tier resolution */
+    guint32      count;            /* Seconds recorded, 0 for no data */
+    guint32      sum[GPU_HISTORY_SERIES];
+    guint8       min[GPU_HISTORY_SERIES];
+    guint8       max[GPU_HISTORY_SERIES];
+    guint8       pad[2];
+} GpuHistoryPoint;
+
+typedef struct _GpuHistory GpuHistory;
+
+/* Map the history file at path, creating it or starting it over if it
+ * does not match the current layout.  NULL if it cannot be mapped. */
+GpuHistory *gpu_history_open(const gchar *path);
+
+void gpu_history_close(GpuHistory *history);
+
+/* Record the GPU_HISTORY_SERIES values of the second at time (seconds
+ * since the epoch) in every tier */
+void gpu_history_insert(GpuHistory *history, gint64 time, const guint8 *values);
+
+/* Copy the n points of a tier ending with the one holding time, oldest
+ * first.  Points outside the tier or never recorded have count 0. */
+void gpu_history_read(GpuHistory *history, gint tier, gint64 time, gint n,
+                      GpuHistoryPoint *points);
+
+/* Seconds per point of a tier */
+guint gpu_history_resolution(gint tier);
+
+#endif /* GPU_HISTORY_H */
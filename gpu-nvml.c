@@ -0,0 +1,150 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - NVML sampling backend
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#include "gpu-backend.h"
+
+#include <gmodule.h>
+
+#define GPU_NVML_LIBRARY "libnvidia-ml.so.1"
+
+/* Where a backend entry comes from in the driver library.  The nvml.h
+ * macros map names such as nvmlInit to the versions the plugin was
+ * built against (nvmlInit_v2), so the names are stringified after
+ * expansion. */
+typedef struct {
+    glong        offset;           /* Of the entry in GpuBackend */
+    const gchar  *symbol;          /* Function in the library */
+    gboolean     optional;         /* Missing from older drivers */
+} GpuNvmlSymbol;
+
+#define NVML_REQUIRED(entry, func) \
+    { G_STRUCT_OFFSET(GpuBackend, entry), G_STRINGIFY(func), FALSE }
+#define NVML_OPTIONAL(entry, func) \
+    { G_STRUCT_OFFSET(GpuBackend, entry), G_STRINGIFY(func), TRUE }
+
+static const GpuNvmlSymbol nvml_symbols[] = {
+    NVML_REQUIRED(Init,                          nvmlInit),
+    NVML_REQUIRED(Shutdown,                      nvmlShutdown),
+    NVML_REQUIRED(ErrorString,                   nvmlErrorString),
+    
+    NVML_REQUIRED(DeviceGetCount,                nvmlDeviceGetCount),
+    NVML_REQUIRED(DeviceGetHandleByIndex,        nvmlDeviceGetHandleByIndex),
+    NVML_REQUIRED(DeviceGetHandleByUUID,         nvmlDeviceGetHandleByUUID),
+    NVML_REQUIRED(DeviceGetName,                 nvmlDeviceGetName),
+    NVML_REQUIRED(DeviceGetUUID,                 nvmlDeviceGetUUID),
+    NVML_REQUIRED(DeviceGetPciInfo,              nvmlDeviceGetPciInfo),
+    NVML_REQUIRED(DeviceGetTemperatureThreshold, nvmlDeviceGetTemperatureThreshold),
+    
+    NVML_REQUIRED(DeviceGetUtilizationRates,     nvmlDeviceGetUtilizationRates),
+    NVML_REQUIRED(DeviceGetMemoryInfo,           nvmlDeviceGetMemoryInfo),
+    NVML_REQUIRED(DeviceGetTemperature,          nvmlDeviceGetTemperature),
+    NVML_REQUIRED(DeviceGetPowerUsage,           nvmlDeviceGetPowerUsage),
+    NVML_OPTIONAL(DeviceGetCurrentClocksThrottleReasons, nvmlDeviceGetCurrentClocksThrottleReasons),
+    NVML_OPTIONAL(DeviceGetFieldValues,          nvmlDeviceGetFieldValues),
+    NVML_OPTIONAL(DeviceGetSamples,              nvmlDeviceGetSamples),
+    
+    NVML_OPTIONAL(DeviceGetComputeRunningProcesses,  nvmlDeviceGetComputeRunningProcesses),
+    NVML_OPTIONAL(DeviceGetGraphicsRunningProcesses, nvmlDeviceGetGraphicsRunningProcesses),
+    NVML_OPTIONAL(DeviceGetProcessUtilization,   nvmlDeviceGetProcessUtilization),
+    
+    NVML_OPTIONAL(EventSetCreate,                nvmlEventSetCreate),
+    NVML_OPTIONAL(DeviceGetSupportedEventTypes,  nvmlDeviceGetSupportedEventTypes),
+    NVML_OPTIONAL(DeviceRegisterEvents,          nvmlDeviceRegisterEvents),
+    NVML_OPTIONAL(EventSetWait,                  nvmlEventSetWait),
+    NVML_OPTIONAL(EventSetFree,                  nvmlEventSetFree),
+    
+    NVML_OPTIONAL(DeviceGetMigMode,              nvmlDeviceGetMigMode),
+    NVML_OPTIONAL(DeviceGetMaxMigDeviceCount,    nvmlDeviceGetMaxMigDeviceCount),
+    NVML_OPTIONAL(DeviceGetMigDeviceHandleByIndex, nvmlDeviceGetMigDeviceHandleByIndex),
+    NVML_OPTIONAL(DeviceGetGpuInstanceId,        nvmlDeviceGetGpuInstanceId),
+    
+    NVML_OPTIONAL(GpmQueryDeviceSupport,         nvmlGpmQueryDeviceSupport),
+    NVML_OPTIONAL(GpmSampleAlloc,                nvmlGpmSampleAlloc),
+    NVML_OPTIONAL(GpmSampleFree,                 nvmlGpmSampleFree),
+    NVML_OPTIONAL(GpmMigSampleGet,               nvmlGpmMigSampleGet),
+    NVML_OPTIONAL(GpmMetricsGet,                 nvmlGpmMetricsGet),
+};
+
+/* Stands in for the calls an older driver lacks.  The plugin copes with
+ * NOT_SUPPORTED from every one of them, and the arguments are never
+ * looked at, so one function serves all their signatures. */
+static nvmlReturn_t
+nvml_not_supported(void)
+{
+    return NVML_ERROR_NOT_SUPPORTED;
+}
+
+/* Sampling backend that calls straight into the NVIDIA driver.  The
+ * library is loaded on first use, so the plugin loads on nodes without
+ * the driver, and it stays loaded for the life of the process. */
+const GpuBackend *
+gpu_backend_nvml(void)
+{
+    static GpuBackend backend = { .name = "nvml" };
+    static GModule *library = NULL;
+    gpointer func;
+    
+    if (library) {
+        return &backend;
+    }
+    
+    library = g_module_open(GPU_NVML_LIBRARY, G_MODULE_BIND_LAZY | G_MODULE_BIND_LOCAL);
+    if (!library) {
+        g_warning("GPU plugin: cannot load %s: %s\n", GPU_NVML_LIBRARY, g_module_error());
+        return NULL;
+    }
+    
+    for (guint i = 0; i < G_N_ELEMENTS(nvml_symbols); ++i) {
+        if (!g_module_symbol(library, nvml_symbols[i].symbol, &func)) {
+            if (!nvml_symbols[i].optional) {
+                g_warning("GPU plugin: %s has no %s, the driver is too old\n",
+                          GPU_NVML_LIBRARY, nvml_symbols[i].symbol);
+                g_module_close(library);
+                library = NULL;
+                return NULL;
+            }
+            g_debug("GPU plugin: %s not in %s\n", nvml_symbols[i].symbol, GPU_NVML_LIBRARY);
+            func = (gpointer) nvml_not_supported;
+        }
+        G_STRUCT_MEMBER(gpointer, &backend, nvml_symbols[i].offset) = func;
+    }
+    
+    /* Drivers from 12.2 on call the throttle reasons clock event reasons
+     * and deprecate the old call; the bits are the same */
+    if (g_module_symbol(library, "nvmlDeviceGetCurrentClocksEventReasons", &func)) {
+        backend.DeviceGetCurrentClocksThrottleReasons = func;
+    }
+    
+    return &backend;
+}
@@ -36,6 +36,12 @@
 
 #include <nvml.h>
 
+#include "gpu-sampler.h"
+#include "gpu-history.h"
+#include "gpu-stats.h"
+#include "gpu-exporter.h"
+#include "gpu-remote.h"
+
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -47,14 +53,86 @@
 #define STYLE_NAME "gpu"
 #define MONITOR_PLUGIN_NAME "gpu"
 #define GPU_TICKS_PER_SECOND 100
+#define GPU_MAX_FORMAT_VARS 72        /* Room for format substitution variables */
+#define GPU_GRID_ROW_HEIGHT 4         /* Default height of a heat map row */
+#define GPU_GRID_LEVELS 16            /* Colors in the heat map palette */
+#define GPU_REMOTE_LOG_S 60           /* How often gkrellmd's bytes per GPU are logged */
+#define GPU_ALERT_SHELL "/bin/sh"     /* Runs the alert commands */
 
-/* Plugin data structure for each GPU detected */
+/* One step of a compiled format: literal text or a variable */
+typedef struct {
+    gint         var;              /* Index into format_vars, -1 for literal text */
+    gchar        *text;            /* Literal text */
+    gint         len;              /* Length of the literal text */
+} GpuFormatToken;
+
+/* A format string compiled into tokens */
 typedef struct {
-    gchar        *name;            /* GPU name like "gpu0", "gpu1" etc. */
-    gchar        *label;           /* Display label like "GPU0", "GPU1" */
-    gint         instance;         /* GPU device index */
+    GpuFormatToken *tokens;
+    gint         n_tokens;
+    guint        serial;           /* Unique per compiled format */
+} GpuFormat;
+
+/* Values of one GPU that are read or written every tick.  These are kept
+ * packed together in gpu_hot, away from the GTK pointers in GpuPlugin. */
+typedef struct {
+    gulong       utilization;      /* Current GPU utilization */
+    gulong       total_memory;     /* Total memory available */
+    gulong       used_memory;      /* Currently used memory */
+    gfloat       temperature;      /* Current temperature */
+    gfloat       power;            /* Current power draw in W */
+    gulong       column_mean;      /* Mean utilization over the last chart column */
+    gulong       column_peak;      /* Peak utilization over the last chart column */
+    GpuReduction reduction;        /* Composite reductions, the GPU's own value otherwise */
+    
+    /* What is currently drawn, so unchanged layers can be skipped */
+    glong        drawn_krell;      /* Last krell value, -1 to force an update */
+    guint        drawn_alerts;     /* Alerts shown on the decal */
+    gboolean     panel_dirty;      /* Panel layers need to be redrawn */
+} GpuHot;
+
+/* Plugin data structure for each GPU detected */
+typedef struct _GpuPlugin {
+    gchar        *name;            /* GPU name like "gpu0", "gpu1" etc., the device's */
+    gchar        *label;           /* Display label like "GPU0", "GPU1", the device's */
+    gint         instance;         /* GPU device index, the parent's for a MIG device */
+    gint         slot;             /* Index into gpus, gpu_hot and the sample buffers */
     gboolean     enabled;          /* If monitoring is enabled */
     gboolean     is_composite;     /* If this is the composite GPU (average of all GPUs) */
+    GpuHot       *hot;             /* Per-tick values, &gpu_hot[slot] */
+    GpuDevice    *dev;             /* The sampler's device in the same slot */
+    
+    /* MIG hierarchy: MIG devices follow their GPU in gpus */
+    struct _GpuPlugin *parent;     /* GPU of a MIG device, NULL otherwise */
+    
+    /* Process list as last fetched from the sampler */
+    GpuProcess   procs[GPU_TOP_PROCESSES];
+    gint         n_procs;
+    gint         procs_total;
+    guint        procs_serial;     /* Serial of the fetched list */
+    gboolean     tooltip_dirty;    /* Panel tooltip needs to be rebuilt */
+    
+    /* Interconnect traffic of the last chart column in KiB/s */
+    gulong       link_rates[GPU_LINK_COUNTERS];
+    
+    /* Events of the last chart column and the chart marks drawn for them */
+    guint        column_events;    /* GPU_MARK_* events in the last column */
+    guint        xid_count;        /* Critical XID errors since start */
+    gulong       last_xid;         /* Most recent XID, 0 if none */
+    guchar       *marks;           /* GPU_MARK_* per chart column, a ring */
+    gint         n_marks;          /* Columns in marks, the chart width */
+    gint         mark_head;        /* Next column to write */
+    gint         n_marked;         /* Columns with a mark */
+    
+    /* Persistent history and the coarser chart column being filled */
+    GpuHistory   *history;         /* History file, NULL if it could not be opened */
+    guint32      history_period;   /* Period of the column being filled */
+    guint        period_events;    /* GPU_MARK_* events in that period */
+    GpuStats     *stats;           /* Rolling statistics of the last seconds */
+    
+    gchar        *metric_labels;   /* OpenMetrics labels identifying the GPU */
+    
+    guint64      remote_bytes;     /* Update bytes received from gkrellmd */
     
     GtkWidget    *vbox;
     GkrellmPanel *panel;           /* Panel to display in */
@@ -62,32 +140,109 @@ typedef struct {
     GkrellmChartconfig *cconfig;   /* Chart configuration */
     GkrellmChartdata *util_cd;     /* Chart data for utilization */
     GkrellmChartdata *mem_cd;      /* Chart data for fractional memory usage */
+    GkrellmChartdata *peak_cd;     /* Chart data for peak utilization */
+    GkrellmChartdata *min_cd;      /* Composite chart data for the least busy GPU */
+    GkrellmChartdata *max_cd;      /* Composite chart data for the busiest GPU */
+    GkrellmChartdata *p90_cd;      /* Composite chart data for the 90th percentile */
+    GkrellmChartdata *busy_cd;     /* Composite chart data for the percent of busy GPUs */
     GkrellmKrell  *krell;          /* Krell for GPU utilization */
+    GkrellmChart *link_chart;      /* Chart for PCIe and NVLink traffic */
+    GkrellmChartconfig *link_cconfig; /* Interconnect chart configuration */
     
     gboolean     show_temperature; /* If temperature should be shown */
     gpointer     sensor_temp;      /* Temperature sensor */
     GkrellmDecal *sensor_decal;    /* Temperature decal */
+    gchar        drawn_decal[64];  /* Last temperature decal text */
+    GpuHealth    health;           /* Health published by the sampler */
+    GpuHealth    drawn_health;     /* Health shown on the decal */
     
-    GkrellmAlert *alert;           /* Alert for high utilization */
+    guint        alerts;           /* GPU_ALERT_* bits raised */
+    guint        alerts_queued;    /* GPU_ALERT_* bits waiting for their command */
+    guint        alert_events;     /* GPU_MARK_ALERT until the column is taken */
     
-    GkrellmLauncher launch;        /* Launch command */
-    
-    gulong       utilization;      /* Current GPU utilization */
-    gulong       total_memory;     /* Total memory available */
-    gulong       used_memory;      /* Currently used memory */
+    /* Clock throttling as last fetched and the time spent in each kind */
+    guint        throttle_reasons; /* nvmlClocksThrottleReason* bits */
+    guint        throttle;         /* GPU_THROTTLE_* categories they fall in */
+    guint        throttle_seconds[N_GPU_THROTTLE];
     
-    gfloat       temperature;      /* Current temperature */
+    GkrellmLauncher launch;        /* Launch command */
     
     gboolean     extra_info;       /* Show extra info on chart */
+    
+    /* Cached chart label text */
+    gchar        format_text[128]; /* Last formatted chart label */
+    guint        format_serial;    /* Compiled format the text was built from */
+    gint64       format_values[GPU_MAX_FORMAT_VARS]; /* Values the text was built from */
 } GpuPlugin;
 
 /* Plugin global variables */
-static GList *gpu_list = NULL;          /* List of GpuPlugin instances */
+static GpuPlugin *gpus = NULL;          /* GPU entries, the composite first if any */
+static GpuHot *gpu_hot = NULL;          /* Per-tick values, indexed like gpus */
+static gint n_slots = 0;                /* Number of entries in gpus */
+static GHashTable *gpu_by_name = NULL;  /* Config name -> GpuPlugin */
+static GHashTable *gpu_by_widget = NULL;/* Chart/panel drawing area -> GpuPlugin */
 static GpuPlugin *composite_gpu = NULL; /* Composite GPU (average of all) */
 static gint n_gpus = 0;                 /* Number of GPUs detected */
 
+/* Composite utilization reductions, indexed by GPU_REDUCE_* */
+static const gchar *reduction_names[N_GPU_REDUCTIONS] = {
+    "mean", "weighted", "min", "max", "p90"
+};
+static const gchar *reduction_labels[N_GPU_REDUCTIONS] = {
+    N_("Mean"),
+    N_("Mean weighted by used memory"),
+    N_("Least busy GPU"),
+    N_("Busiest GPU"),
+    N_("90th percentile")
+};
+
+static GdkGC *mark_gc = NULL;           /* Draws the event marks on the charts */
+static gint history_tier = GPU_HISTORY_SECONDS; /* Time per chart column, a GPU_HISTORY_* tier */
+static const gchar *history_tier_names[GPU_HISTORY_TIERS] = {
+    "seconds", "minutes", "hours"
+};
+static const gchar *history_tier_labels[GPU_HISTORY_TIERS] = {
+    N_("A second per column"),
+    N_("A minute per column"),
+    N_("An hour per column")
+};
+static gchar *exporter_address = NULL;  /* Where metrics are served, NULL or "" for nowhere */
+static GpuExporter *exporter = NULL;
+static GString *metrics_text = NULL;    /* Metrics being formatted, reused every second */
+static GtkWidget *exporter_entry;       /* Entry for the exporter address */
+
+/* Time from plugin load until the GPUs are ready in microseconds, 0
+ * before; exported for tests/bench */
+gint gpu_startup_us = 0;
+
+/* NVML is initialized and the GPUs found on an init thread, so a slow
+ * driver does not hold up GKrellM.  Until the UI thread takes the GPUs
+ * over, a single panel says so and per-GPU settings are held back. */
+static GThread *init_thread = NULL;
+static gint init_state = GPU_INIT_RUNNING; /* Set by the init thread (atomic) */
+static gint64 init_started = 0;         /* When the plugin was loaded */
+static gboolean init_finished = FALSE;  /* If finish_gpu_init took the GPUs over */
+static gboolean gpus_ready = FALSE;     /* If the UI thread has taken over the GPUs */
+static GPtrArray *pending_config = NULL; /* Per-GPU config lines read before that */
+static GkrellmPanel *init_panel = NULL; /* Shown in place of the GPUs until then */
+static GkrellmDecal *init_decal = NULL;
+
+/* In client mode the GPUs are those of gkrellmd, as its setup describes */
+static gint remote_version = 0;
+static gint remote_slots = 0;
+static gint remote_gpus = 0;
+static GpuSharedDevice *remote_devices = NULL;
+static gint remote_log_seconds = 0;
+
+/* Alert commands.  Each runs at most once per alert_interval seconds,
+ * for all the GPUs that raised its alert since it last ran. */
+static gchar *alert_commands[N_GPU_ALERTS];
+static GPtrArray *alert_pending[N_GPU_ALERTS]; /* GpuPlugin waiting for the command */
+static gint64 alert_next_run[N_GPU_ALERTS];     /* Monotonic time it may run again */
+static gint alert_interval = 60;
+static GtkWidget *alert_command_entries[N_GPU_ALERTS];
+
 static GkrellmMonitor *monitor;         /* Our plugin monitor */
-static GkrellmAlert *gpu_alert = NULL;  /* Alert template */
 
 static gint style_id;                   /* Our style ID */
 static GtkWidget *gpu_vbox;             /* Box holding the widget */
@@ -98,404 +253,2204 @@ static gboolean config_tracking = FALSE;
 static gchar *text_format;       /* Default text format */
 static gchar *text_format_locale;/* Localized text format */
 
+static GpuFormat *chart_format = NULL;  /* Compiled text_format_locale */
+static GHashTable *command_formats = NULL; /* Compiled alert commands by string */
+static guint format_serial = 0;
+
+/* Compact display: one heat map chart with a row per GPU and a column
+ * per second, scrolled in place so each second costs one new column */
+typedef struct {
+    GkrellmChart *chart;
+    GkrellmChartconfig *cconfig;
+    GkrellmPanel *panel;
+    GkrellmKrell *krell;
+    GpuPlugin    *top;             /* Entry shown by the krell, the composite if any */
+    GpuPlugin    **rows;           /* Enabled GPUs, one per row */
+    gint         n_rows;
+    
+    guchar       *history;         /* Utilization, width columns of n_rows */
+    gint         width;            /* Columns in history */
+    gint         head;             /* Next column to write */
+    
+    GdkPixmap    *pixmap;          /* Heat map as drawn, width x height */
+    gint         height;           /* Height of pixmap */
+    GdkGC        *gc;
+    GdkColor     palette[GPU_GRID_LEVELS];
+    GpuPlugin    *detail;          /* Row whose text is shown, NULL for none */
+    glong        drawn_krell;      /* Last krell value, -1 to force an update */
+} GpuGrid;
+
+static gboolean grid_display = FALSE;   /* Show the heat map instead of the charts */
+static GpuGrid grid;
+
 /* Forward declarations */
 static void cleanup_plugin(void);
 static void draw_sensor_decals(GpuPlugin *gpu);
 static void refresh_gpu_chart(GpuPlugin *gpu);
-static void format_gpu_data(GpuPlugin *gpu, gchar *src_string, gchar *buf, gint size);
-static void cb_command_process(GkrellmAlert *alert, gchar *src, gchar *dst, gint len, GpuPlugin *gpu);
-static void cb_alert_trigger(GkrellmAlert *alert, gpointer data);
-static void cd_set_alert(GtkWidget *button, gpointer data);
-static void create_alert(void);
+static void refresh_link_chart(GpuPlugin *gpu);
+static void format_free(GpuFormat *fmt);
+static gboolean format_gpu_data(GpuPlugin *gpu, gchar *src_string, gchar *buf, gint size);
 static gboolean fix_panel(GpuPlugin *gpu);
 static void create_gpu_plugin(GtkWidget *vbox, gint first_create);
+static void create_gpu_charts(GtkWidget *vbox);
+static void create_link_chart(GtkWidget *vbox, GpuPlugin *gpu);
 static void update_gpu_plugin(void);
 static void create_gpu_config(GtkWidget *vbox);
 static void apply_gpu_config(void);
 static void save_gpu_config(FILE *f);
 static void load_gpu_config(gchar *arg);
 
-/* Initialize the NVML library and detect GPUs */
-static gboolean
-setup_gpu_interface(void)
+/* Find a GPU entry by its config name */
+static GpuPlugin *
+lookup_gpu(const gchar *name)
 {
-    nvmlReturn_t result = nvmlInit();
-    if (result != NVML_SUCCESS) {
-        g_warning("Failed to initialize NVML: %s\n", nvmlErrorString(result));
-        return FALSE;
-    }
-    
-    /* Get the device count */
-    unsigned int deviceCount = 0;
-    result = nvmlDeviceGetCount(&deviceCount);
-    if (result != NVML_SUCCESS) {
-        g_warning("Failed to get device count: %s\n", nvmlErrorString(result));
-        nvmlShutdown();
-        return FALSE;
+    return gpu_by_name ? g_hash_table_lookup(gpu_by_name, name) : NULL;
+}
+
+/* Mark the alerts a GPU just raised on its chart and queue their
+ * commands, once per GPU until they run */
+static void
+queue_alert_commands(GpuPlugin *gpu, guint raised)
+{
+    if (!raised) {
+        return;
     }
-    
-    n_gpus = deviceCount;
-    
-    /* If multiple GPUs, create a composite entry */
-    if (n_gpus > 1) {
-        composite_gpu = g_new0(GpuPlugin, 1);
-        composite_gpu->name = g_strdup("gpu");
-        composite_gpu->label = g_strdup("GPU");
-        composite_gpu->is_composite = TRUE;
-        composite_gpu->instance = -1;
-        composite_gpu->enabled = TRUE;
-        gpu_list = g_list_append(gpu_list, composite_gpu);
+    gpu->alert_events |= GPU_MARK_ALERT;
+    if (!gpu->enabled) {
+        return;
     }
-    
-    /* Create entries for each GPU */
-    for (gint i = 0; i < n_gpus; i++) {
-        GpuPlugin *gpu = g_new0(GpuPlugin, 1);
-        gpu->instance = i;
-        gpu->name = g_strdup_printf("gpu%d", i);
-        gpu->label = g_strdup_printf("GPU%d", i);
-        gpu->enabled = TRUE;
-        gpu_list = g_list_append(gpu_list, gpu);
+    for (gint a = 0; a < N_GPU_ALERTS; ++a) {
+        if (!(raised & (1u << a)) || (gpu->alerts_queued & (1u << a))
+            || !alert_commands[a] || !*alert_commands[a]) {
+            continue;
+        }
+        if (!alert_pending[a]) {
+            alert_pending[a] = g_ptr_array_new();
+        }
+        g_ptr_array_add(alert_pending[a], gpu);
+        gpu->alerts_queued |= 1u << a;
     }
-    
-    return TRUE;
 }
 
-/* Read data from all GPUs using NVML */
+/* Run the alert commands that are due.  The command's variables are
+ * those of the first GPU that raised the alert; GKRELLM_GPU_ALERTED
+ * names all of them, as a burst on many GPUs runs the command once.
+ * Process names are chosen by any user of the GPU, so every value is
+ * quoted for the shell and also passed in the environment, and a
+ * command that does not fit is not run at all. */
 static void
-read_gpu_data(void)
+run_alert_commands(void)
 {
-    GList *list;
+    gint64 now = g_get_monotonic_time();
     GpuPlugin *gpu;
-    nvmlReturn_t result;
-    nvmlDevice_t device;
-    nvmlUtilization_t utilization;
-    
-    /* Reset composite GPU stats */
-    if (composite_gpu) {
-        composite_gpu->utilization = 0;
-        composite_gpu->total_memory = 0;
-        composite_gpu->used_memory = 0;
-        composite_gpu->temperature = 0.0;
-    }
+    GString *names;
+    GError *error = NULL;
+    gchar buf[1024];
+    gchar *argv[4];
+    gchar **envp;
+    gboolean fits;
     
-    /* Loop over all GPUs found */
-    for (list = gpu_list; list; list = list->next) {
-        gpu = (GpuPlugin *) list->data;
-        
-        /* Skip composite GPU */
-        if (gpu->instance < 0) {
+    for (gint a = 0; a < N_GPU_ALERTS; ++a) {
+        if (!alert_pending[a] || alert_pending[a]->len == 0 || now < alert_next_run[a]) {
             continue;
         }
-            
-        /* Get the device handle */
-        result = nvmlDeviceGetHandleByIndex(gpu->instance, &device);
-        if (result != NVML_SUCCESS) {
+        
+        names = g_string_new(NULL);
+        for (guint i = 0; i < alert_pending[a]->len; ++i) {
+            gpu = g_ptr_array_index(alert_pending[a], i);
+            g_string_append_printf(names, "%s%s", i > 0 ? " " : "", gpu->name);
+            gpu->alerts_queued &= ~(1u << a);
+        }
+        gpu = g_ptr_array_index(alert_pending[a], 0);
+        fits = format_gpu_data(gpu, alert_commands[a], buf, sizeof(buf));
+        g_ptr_array_set_size(alert_pending[a], 0);
+        alert_next_run[a] = now + (gint64) alert_interval * G_USEC_PER_SEC;
+        if (!fits) {
+            g_warning("GPU plugin: the %s alert command is too long once its variables are filled in, not run\n",
+                      gpu_alert_rules[a].name);
+            g_string_free(names, TRUE);
             continue;
         }
         
-        /* Get utilization rates - this is in percent (0-100) */
-        result = nvmlDeviceGetUtilizationRates(device, &utilization);
-        if (result == NVML_SUCCESS) {
-            gpu->utilization = utilization.gpu;
+        argv[0] = GPU_ALERT_SHELL;
+        argv[1] = "-c";
+        argv[2] = buf;
+        argv[3] = NULL;
+        envp = g_get_environ();
+        envp = g_environ_setenv(envp, "GKRELLM_GPU_ALERTED", names->str, TRUE);
+        envp = g_environ_setenv(envp, "GKRELLM_GPU_ALERT", gpu_alert_rules[a].name, TRUE);
+        envp = g_environ_setenv(envp, "GKRELLM_GPU_NAME", gpu->name, TRUE);
+        envp = g_environ_setenv(envp, "GKRELLM_GPU_LABEL", gpu->label, TRUE);
+        envp = g_environ_setenv(envp, "GKRELLM_GPU_PROCESS",
+                                gpu->n_procs > 0 ? gpu->procs[0].comm : "", TRUE);
+        if (!g_spawn_async(NULL, argv, envp, 0, NULL, NULL, NULL, &error)) {
+            g_warning("GPU plugin: cannot run the %s alert command: %s\n",
+                      gpu_alert_rules[a].name, error->message);
+            g_clear_error(&error);
+        }
+        g_strfreev(envp);
+        g_string_free(names, TRUE);
+    }
+}
+
+/* Copy the latest published samples into the GpuPlugin instances.  With
+ * take_column the chart column stats are taken as well and the sampler
+ * starts a new column. */
+static void
+fetch_gpu_samples(gboolean take_column)
+{
+    gint i;
+    GpuPlugin *gpu;
+    const GpuSample *samples, *sample;
+    
+    samples = gpu_sampler_lock();
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
+        sample = &samples[gpu->slot];
+        
+        gpu->hot->utilization = sample->utilization;
+        gpu->hot->total_memory = sample->total_memory;
+        gpu->hot->used_memory = sample->used_memory;
+        gpu->hot->temperature = sample->temperature;
+        gpu->hot->power = sample->power;
+        if (gpu->is_composite) {
+            gpu->hot->reduction = sample->reduction;
+        }
+        else {
+            /* A single GPU reduces to its own utilization */
+            for (gint r = 0; r < N_GPU_REDUCTIONS; ++r) {
+                gpu->hot->reduction.value[r] = sample->utilization;
+            }
+            gpu->hot->reduction.busy = sample->utilization > GPU_IDLE_UTILIZATION;
+            gpu->hot->reduction.n = 1;
         }
         
-        /* Get memory info */
-        nvmlMemory_t memory;
-        result = nvmlDeviceGetMemoryInfo(device, &memory);
-        if (result == NVML_SUCCESS) {
-            gpu->total_memory = memory.total;
-            gpu->used_memory = memory.used;
+        if (sample->health != gpu->health) {
+            gpu->health = sample->health;
+            gpu->tooltip_dirty = TRUE;
+        }
+        if (sample->throttle_reasons != gpu->throttle_reasons) {
+            gpu->throttle_reasons = sample->throttle_reasons;
+            gpu->throttle = gpu_throttle_decode(gpu->throttle_reasons);
+            gpu->tooltip_dirty = TRUE;
+        }
+        if (sample->alerts != gpu->alerts) {
+            queue_alert_commands(gpu, sample->alerts & ~gpu->alerts);
+            gpu->alerts = sample->alerts;
+            gpu->tooltip_dirty = TRUE;
         }
         
-        /* Get temperature if needed */
-        if (gpu->show_temperature && gpu->sensor_decal) {
-            unsigned int temp;
-            result = nvmlDeviceGetTemperature(device, NVML_TEMPERATURE_GPU, &temp);
-            if (result == NVML_SUCCESS && gpu->sensor_temp) {
-                /* Store temperature for display */
-                gpu->temperature = (gfloat)temp;
-            }
+        /* The process list only changes every few seconds */
+        if (sample->procs_serial != gpu->procs_serial) {
+            memcpy(gpu->procs, sample->procs, sizeof(gpu->procs));
+            gpu->n_procs = sample->n_procs;
+            gpu->procs_total = sample->procs_total;
+            gpu->procs_serial = sample->procs_serial;
+            gpu->tooltip_dirty = TRUE;
         }
         
-        /* Update composite GPU */
-        if (composite_gpu) {
-            composite_gpu->utilization += gpu->utilization;
-            composite_gpu->total_memory += gpu->total_memory;
-            composite_gpu->used_memory += gpu->used_memory;
-            if (gpu->temperature > composite_gpu->temperature) {
-                composite_gpu->temperature = gpu->temperature;
+        if (take_column) {
+            memcpy(gpu->link_rates, sample->link_rates, sizeof(gpu->link_rates));
+            gpu->column_events = sample->column_events | gpu->alert_events;
+            gpu->alert_events = 0;
+            gpu->xid_count = sample->xid_count;
+            gpu->last_xid = sample->last_xid;
+            if (sample->column_count > 0) {
+                gpu->hot->column_mean = (gulong) round(sample->column_sum / sample->column_count);
+                gpu->hot->column_peak = sample->column_peak;
+            }
+            else {
+                gpu->hot->column_mean = gpu->hot->column_peak = gpu->hot->utilization;
             }
         }
     }
+    gpu_sampler_unlock(take_column);
+}
+
+static gint
+compare_members(gconstpointer a, gconstpointer b)
+{
+    return strcmp(*(const gchar **) a, *(const gchar **) b);
+}
+
+/* Name the composite's history by the UUIDs of the GPUs it is made of,
+ * so composites of different hosts sharing a home directory, or of a
+ * host whose GPUs changed, keep their own */
+static gchar *
+composite_history_file(void)
+{
+    GPtrArray *members = g_ptr_array_new();
+    GString *key = g_string_new(NULL);
+    GpuDevice *dev;
+    gchar *digest, *file;
     
-    /* Average the utilization values for composite GPU */
-    if (composite_gpu && n_gpus > 1) {
-        composite_gpu->utilization /= n_gpus;
+    for (gint i = 0; i < n_slots; ++i) {
+        dev = gpus[i].dev;
+        if (!dev->is_composite && !dev->parent) {
+            g_ptr_array_add(members, *dev->uuid ? dev->uuid : dev->name);
+        }
     }
+    g_ptr_array_sort(members, compare_members);
+    for (guint i = 0; i < members->len; ++i) {
+        g_string_append_printf(key, "%s\n", (gchar *) g_ptr_array_index(members, i));
+    }
+    
+    digest = g_compute_checksum_for_string(G_CHECKSUM_SHA256, key->str, key->len);
+    file = g_strdup_printf("gpu-composite-%.16s.history", digest);
+    g_free(digest);
+    g_string_free(key, TRUE);
+    g_ptr_array_free(members, TRUE);
+    return file;
 }
 
-/* Clean up NVML when plugin is unloaded */
+/* Map the history file of each GPU, named by UUID so it follows the
+ * GPU across reboots and slot changes */
 static void
-cleanup_plugin(void)
+open_gpu_histories(void)
 {
-    GList *list;
     GpuPlugin *gpu;
+    gchar *dir, *file, *path;
     
-    /* Free all GPU data structures */
-    for (list = gpu_list; list; list = list->next) {
-        gpu = (GpuPlugin *)list->data;
-        
-        g_free(gpu->name);
-        g_free(gpu->label);
-        
-        if (gpu->launch.command) {
-            g_free(gpu->launch.command);
+    dir = g_build_filename(gkrellm_homedir(), GKRELLM_DATA_DIR, NULL);
+    if (g_mkdir_with_parents(dir, 0755) < 0) {
+        g_warning("GPU plugin: cannot create %s, charts keep no history\n", dir);
+        g_free(dir);
+        return;
+    }
+    
+    for (gint i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
+        if (gpu->is_composite) {
+            file = composite_history_file();
         }
-        if (gpu->launch.tooltip_comment) {
-            g_free(gpu->launch.tooltip_comment);
+        else {
+            file = g_strdup_printf("gpu-%s.history", *gpu->dev->uuid ? gpu->dev->uuid : gpu->name);
         }
-            
-        g_free(gpu);
+        path = g_build_filename(dir, file, NULL);
+        gpu->history = gpu_history_open(path);
+        g_free(path);
+        g_free(file);
     }
-    
-    /* Close out the GPU list and composite object */
-    g_list_free(gpu_list);
-    gpu_list = NULL;
-    composite_gpu = NULL;
-    
-    /* Free text format */
-    if (text_format_locale && text_format_locale != text_format)
-        g_free(text_format_locale);
-    if (text_format)
-        g_free(text_format);
-        
-    /* Shutdown NVML */
-    nvmlShutdown();
+    g_free(dir);
 }
 
-/* Draw sensor (temperature) decals */
+/* Append a label value escaped as OpenMetrics requires */
 static void
-draw_sensor_decals(GpuPlugin *gpu)
+append_label_value(GString *s, const gchar *value)
 {
-    GkrellmPanel *p = gpu->panel;
-    gchar buf[64];
+    for (; *value; ++value) {
+        if (*value == '\\' || *value == '"') {
+            g_string_append_c(s, '\\');
+            g_string_append_c(s, *value);
+        }
+        else if (*value == '\n') {
+            g_string_append(s, "\\n");
+        }
+        else {
+            g_string_append_c(s, *value);
+        }
+    }
+}
+
+/* Labels are built once, before the sampler owns the device properties */
+static void
+build_metric_labels(void)
+{
+    GpuPlugin *gpu;
+    GString *s;
     
-    if (gpu->show_temperature && gpu->sensor_decal) {
-        /* Format temperature as a string */
-        g_snprintf(buf, sizeof(buf), "%.1f C", gpu->temperature);
-        
-        /* Draw the temperature text on the decal */
-        gkrellm_draw_decal_text(p, gpu->sensor_decal, buf, 0);
+    for (gint i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
+        s = g_string_new("gpu=\"");
+        append_label_value(s, gpu->name);
+        g_string_append(s, "\",uuid=\"");
+        append_label_value(s, gpu->dev->uuid);
+        g_string_append(s, "\",name=\"");
+        append_label_value(s, gpu->dev->device_name);
+        g_string_append_c(s, '"');
+        gpu->metric_labels = g_string_free(s, FALSE);
     }
 }
 
-/* Format GPU data for display */
+/* (Re)start serving metrics at exporter_address */
 static void
-format_gpu_data(GpuPlugin *gpu, gchar *src_string, gchar *buf, gint size)
+start_exporter(void)
 {
-    gchar c, *s;
-    gint len, utilization = 0, mem_used = 0, mem_total = 0, mem_used_frac = 0, t;
+    gpu_exporter_free(exporter);
+    exporter = NULL;
+    if (exporter_address && *exporter_address) {
+        exporter = gpu_exporter_new(exporter_address);
+    }
+}
 
-    if (!buf || size < 1)
-        return;
-    --size;
-    *buf = '\0';
-    if (!src_string)
-        return;
+static gpointer
+init_thread_main(gpointer data)
+{
+    g_atomic_int_set(&init_state, gpu_sampler_init() ? GPU_INIT_DONE : GPU_INIT_FAILED);
+    return NULL;
+}
+
+/* Build the GPU entries over the devices the sampler found */
+static void
+setup_gpu_entries(void)
+{
+    GpuPlugin *gpu;
+    GpuDevice *dev;
     
-    utilization = gpu->utilization;
-    mem_used = gpu->used_memory / 1024;
-    mem_total = gpu->total_memory / 1024;
-    mem_used_frac = round(100 * (gfloat) mem_used / mem_total);
+    n_slots = gpu_sampler_slots();
+    n_gpus = gpu_sampler_gpus();
+    gpus = g_new0(GpuPlugin, n_slots);
+    gpu_hot = g_new0(GpuHot, n_slots);
+    gpu_by_name = g_hash_table_new(g_str_hash, g_str_equal);
+    gpu_by_widget = g_hash_table_new(g_direct_hash, g_direct_equal);
     
-    for (s = src_string; *s != '\0' && size > 0; ++s) {
-        len = 1;
-        if (*s == '$' && *(s + 1) != '\0') {
-            c = *(s + 1);
-            t = -1;
-            
-            if (c == 'u') {
-                t = utilization;
-                if (t < 0)
-                    t = 0;
-                if (t > 100)
-                    t = 100;
-            }
-            else if (c == 'm') {
-                t = mem_used_frac;
-                if (t < 0)
-                    t = 0;
-                if (t > 100)
-                    t = 100;
-            }
-            else if (c == 'T')
-                t = mem_total;
-            else if (c == 'U')
-                t = mem_used;
-            else if (c == 'L')
-                len = snprintf(buf, size, "%s", gpu->label);
-            else if (c == 'N')
-                len = snprintf(buf, size, "%d", gpu->instance);
-            else if (c == 'H')
-                len = snprintf(buf, size, "%s", gkrellm_get_hostname());
-            else {
-                *buf = *s;
-                if (size > 1) {
-                    *(buf + 1) = *(s + 1);
-                    ++len;
-                }
-            }
-            
-            if (t >= 0) {
-                if (c == 'T' || c == 'U') {
-                    if (t > 50*1024*1024)
-                        len = snprintf(buf, size, "%.0fG", (gfloat) t / (1024*1024));
-                    else if (t > 1024*1024)
-                        len = snprintf(buf, size, "%.1fG", (gfloat) t / (1024*1024));
-                    else if (t > 50*1024)
-                        len = snprintf(buf, size, "%.0fM", (gfloat) t / (1024));
-                    else
-                        len = snprintf(buf, size, "%.1fM", (gfloat) t / (1024));
-                }
-                else
-                    len = snprintf(buf, size, "%d%%", t);
-            }
-            ++s;
-        }
-        else {
-            *buf = *s;
+    for (gint slot = 0; slot < n_slots; slot++) {
+        gpu = &gpus[slot];
+        dev = gpu_sampler_device(slot);
+        gpu->dev = dev;
+        gpu->slot = slot;
+        gpu->hot = &gpu_hot[slot];
+        gpu->enabled = TRUE;
+        gpu->name = dev->name;
+        gpu->label = dev->label;
+        gpu->instance = dev->instance;
+        gpu->is_composite = dev->is_composite;
+        gpu->parent = dev->parent ? &gpus[dev->parent->slot] : NULL;
+        gpu->stats = gpu_stats_new();
+        if (gpu->is_composite) {
+            composite_gpu = gpu;
         }
-        
-        size -= len;
-        buf += len;
+        g_hash_table_insert(gpu_by_name, gpu->name, gpu);
     }
-    
-    *buf = '\0';
 }
 
-/* Refresh chart UI */
+/* Collect gkrellmd's setup lines: the version, the device count, then
+ * a line per device */
 static void
-refresh_gpu_chart(GpuPlugin *gpu)
+cb_remote_setup(gchar *line)
 {
-    GkrellmChart *cp = gpu->chart;
+    GpuSharedDevice device;
+    gint slot;
+    
+    if (sscanf(line, "version %d", &remote_version) == 1) {
+        return;
+    }
+    if (sscanf(line, "gpus %d %d", &remote_slots, &remote_gpus) == 2) {
+        g_free(remote_devices);
+        remote_devices = NULL;
+        if (remote_slots <= 0 || remote_slots > GPU_REMOTE_MAX_SLOTS
+            || remote_gpus < 0 || remote_gpus > remote_slots) {
+            g_warning("GPU plugin: gkrellmd describes %d devices, ignored\n", remote_slots);
+            remote_slots = remote_gpus = 0;
+            return;
+        }
+        remote_devices = g_new0(GpuSharedDevice, remote_slots);
+        return;
+    }
+    slot = gpu_remote_parse_device(line, &device);
+    if (remote_devices && slot >= 0 && slot < remote_slots) {
+        remote_devices[slot] = device;
+    }
+}
 
-    gkrellm_draw_chartdata(cp);
-    if (gpu->extra_info) {
-        gchar buf[128];
-        format_gpu_data(gpu, text_format_locale, buf, sizeof(buf));
-        gkrellm_draw_chart_text(cp, style_id, buf);
+/* Set the sampler up over the GPUs gkrellmd described */
+static gboolean
+setup_remote_gpus(void)
+{
+    gboolean ok = (remote_version == GPU_REMOTE_VERSION
+                   && remote_devices && remote_slots > 0);
+    
+    for (gint slot = 0; ok && slot < remote_slots; slot++) {
+        ok = (*remote_devices[slot].name != '\0');
     }
-    gkrellm_draw_chart_to_screen(cp);
+    if (ok) {
+        ok = gpu_sampler_init_remote(remote_devices, remote_slots);
+    }
+    else {
+        g_warning("GPU plugin: gkrellmd serves no GPUs\n");
+    }
+    g_free(remote_devices);
+    remote_devices = NULL;
+    return ok;
 }
 
-/* Process alert command variables */
+/* Apply a line of gkrellmd's update to the remote samples */
 static void
-cb_command_process(GkrellmAlert *alert, gchar *src, gchar *dst, gint len, 
-                   GpuPlugin *gpu)
+cb_remote_data(gchar *line)
 {
-    format_gpu_data(gpu, src, dst, len);
+    GpuSharedSample *samples = gpu_sampler_remote_samples();
+    gint count = gpu_sampler_slots();
+    gint slot;
+    
+    if (!samples) {
+        return;
+    }
+    if (!strncmp(line, "reset", 5)) {
+        memset(samples, 0, count * sizeof(GpuSharedSample));
+    }
+    else {
+        slot = gpu_remote_apply_delta(line, samples, count);
+        if (slot < 0) {
+            return;
+        }
+        if (gpus) {
+            gpus[slot].remote_bytes += strlen(line);
+        }
+    }
+    gpu_sampler_remote_update();
 }
 
-/* Handle alert triggering */
+/* Log what gkrellmd's updates cost per GPU, once a minute */
 static void
-cb_alert_trigger(GkrellmAlert *alert, gpointer data)
+log_remote_bandwidth(void)
 {
-    GpuPlugin *gpu = (GpuPlugin *)data;
-    GkrellmAlertdecal *ad;
-    GkrellmDecal *d;
-
-    if (alert && gpu && gpu->panel) {
-        ad = &alert->ad;
-        d = gpu->sensor_decal;
-        if (d) {
-            ad->x = d->x - 1;
-            ad->y = d->y - 1;
-            ad->w = d->w + 2;
-            ad->h = d->h + 2;
-            gkrellm_render_default_alert_decal(alert);
-        }
-        alert->panel = gpu->panel;
+    GpuPlugin *gpu;
+    
+    if (++remote_log_seconds < GPU_REMOTE_LOG_S) {
+        return;
+    }
+    remote_log_seconds = 0;
+    for (gint slot = 0; slot < n_slots; slot++) {
+        gpu = &gpus[slot];
+        g_debug("GPU plugin: %s updates from gkrellmd take %.1f bytes/s\n",
+                gpu->name, (gdouble) gpu->remote_bytes / GPU_REMOTE_LOG_S);
+        gpu->remote_bytes = 0;
     }
 }
 
-/* Fix panel when sensor display changes */
-static gboolean
-fix_panel(GpuPlugin *gpu)
+/* Take over the GPUs once the init thread has found them: apply the
+ * settings read in the meantime, start sampling and build the charts */
+static void
+finish_gpu_init(void)
 {
-    GkrellmPanel *p = gpu->panel;
-    GkrellmDecal *ds;
-    gboolean result = FALSE;
+    gint state = g_atomic_int_get(&init_state);
     
-    ds = gpu->sensor_decal;
-    if (!ds) {
-        return FALSE;
+    if (init_finished || state == GPU_INIT_RUNNING) {
+        return;
+    }
+    if (init_thread) {
+        g_thread_join(init_thread);
+        init_thread = NULL;
     }
+    init_finished = TRUE;
     
-    gpu->show_temperature = TRUE;
+    if (init_panel) {
+        gkrellm_panel_destroy(init_panel);
+        init_panel = NULL;
+        init_decal = NULL;
+    }
+    if (state == GPU_INIT_FAILED) {
+        /* The pending settings are kept, to be saved as they were */
+        g_warning("GPU plugin: failed to initialize NVML\n");
+        return;
+    }
     
-    if (!gkrellm_demo_mode()) {
-        gkrellm_sensor_alert_connect(gpu->sensor_temp, 
-                                   (void (*)(GkrellmAlert *, gpointer))cb_alert_trigger, 
-                                   gpu);
+    setup_gpu_entries();
+    gpus_ready = TRUE;
+    for (guint i = 0; i < pending_config->len; ++i) {
+        load_gpu_config(g_ptr_array_index(pending_config, i));
     }
+    g_ptr_array_set_size(pending_config, 0);
+    
+    open_gpu_histories();
+    build_metric_labels();
+    gpu_sampler_start();
+    start_exporter();
+    
+    gpu_startup_us = (gint) (g_get_monotonic_time() - init_started);
+    g_debug("GPU plugin: %d GPUs ready %.1f ms after loading\n",
+            n_gpus, gpu_startup_us / 1000.0);
+    gkrellm_build();
+}
 
-    if (gpu->sensor_temp || gkrellm_demo_mode()) {
-        gpu->show_temperature = TRUE;
+/* Clean up NVML when plugin is unloaded */
+static void
+cleanup_plugin(void)
+{
+    gint i;
+    GpuPlugin *gpu;
+    
+    /* Stop sampling before tearing anything down, and let a running init
+     * finish so everything it set up is torn down too */
+    if (init_thread) {
+        g_thread_join(init_thread);
+        init_thread = NULL;
+    }
+    gpu_sampler_stop();
+    gpu_exporter_free(exporter);
+    exporter = NULL;
+    if (metrics_text) {
+        g_string_free(metrics_text, TRUE);
+        metrics_text = NULL;
     }
     
-    if (gpu->show_temperature) {
-        if (!gkrellm_is_decal_visible(ds)) {
-            gkrellm_make_decal_visible(p, ds);
+    /* Free all GPU data structures */
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
+        
+        if (gpu->launch.command) {
+            g_free(gpu->launch.command);
         }
-        result = TRUE;
+        if (gpu->launch.tooltip_comment) {
+            g_free(gpu->launch.tooltip_comment);
+        }
+        g_free(gpu->marks);
+        gpu_history_close(gpu->history);
+        gpu_stats_free(gpu->stats);
+        g_free(gpu->metric_labels);
     }
     
-    gkrellm_draw_panel_label(p);
-    draw_sensor_decals(gpu);
-    gkrellm_draw_panel_layers(p);
+    /* Close out the GPU array, its lookup tables and the composite */
+    if (gpu_by_name) {
+        g_hash_table_destroy(gpu_by_name);
+        gpu_by_name = NULL;
+    }
+    if (gpu_by_widget) {
+        g_hash_table_destroy(gpu_by_widget);
+        gpu_by_widget = NULL;
+    }
+    g_free(gpus);
+    g_free(gpu_hot);
+    gpus = NULL;
+    gpu_hot = NULL;
+    n_slots = 0;
+    composite_gpu = NULL;
     
-    return result;
-}
-
-static gint
+    /* Heat map state */
+    g_free(grid.rows);
+    g_free(grid.history);
+    if (grid.pixmap) {
+        g_object_unref(grid.pixmap);
+    }
+    if (grid.gc) {
+        g_object_unref(grid.gc);
+    }
+    memset(&grid, 0, sizeof(grid));
+    if (mark_gc) {
+        g_object_unref(mark_gc);
+        mark_gc = NULL;
+    }
+    n_slots = 0;
+    
+    /* Free text format */
+    if (text_format_locale && text_format_locale != text_format)
+        g_free(text_format_locale);
+    if (text_format)
+        g_free(text_format);
+    format_free(chart_format);
+    chart_format = NULL;
+    g_free(exporter_address);
+    exporter_address = NULL;
+    if (command_formats) {
+        g_hash_table_destroy(command_formats);
+        command_formats = NULL;
+    }
+    for (gint a = 0; a < N_GPU_ALERTS; ++a) {
+        g_free(alert_commands[a]);
+        alert_commands[a] = NULL;
+        if (alert_pending[a]) {
+            g_ptr_array_free(alert_pending[a], TRUE);
+            alert_pending[a] = NULL;
+        }
+        alert_next_run[a] = 0;
+    }
+    
+    if (pending_config) {
+        g_ptr_array_free(pending_config, TRUE);
+        pending_config = NULL;
+    }
+    gpus_ready = FALSE;
+    init_finished = FALSE;
+    remote_log_seconds = 0;
+        
+    /* Release the devices and shut NVML down if it was started here */
+    gpu_sampler_shutdown();
+}
+
+/* Draw sensor (temperature) decals if their text changed */
+static void
+draw_sensor_decals(GpuPlugin *gpu)
+{
+    GkrellmPanel *p = gpu->panel;
+    gchar buf[64];
+    
+    gpu->drawn_health = gpu->health;
+    gpu->hot->drawn_alerts = gpu->alerts;
+    if (gpu->show_temperature && gpu->sensor_decal) {
+        /* Format temperature as a string, or say why there is none */
+        if (gpu->health == GPU_HEALTH_LOST) {
+            g_strlcpy(buf, _("lost"), sizeof(buf));
+        }
+        else if (gpu->health == GPU_HEALTH_STALE) {
+            g_strlcpy(buf, _("stale"), sizeof(buf));
+        }
+        else {
+            g_snprintf(buf, sizeof(buf), "%.1f C%s", gpu->hot->temperature,
+                       gpu->alerts ? " !" : "");
+        }
+        if (!strcmp(buf, gpu->drawn_decal)) {
+            return;
+        }
+        
+        /* Draw the temperature text on the decal */
+        gkrellm_draw_decal_text(p, gpu->sensor_decal, buf, 0);
+        g_strlcpy(gpu->drawn_decal, buf, sizeof(gpu->drawn_decal));
+        gpu->hot->panel_dirty = TRUE;
+    }
+}
+
+/* Render a memory size given in kB */
+static gint
+render_memory_size(gint64 t, gchar *buf, gint size)
+{
+    if (t > 50*1024*1024)
+        return snprintf(buf, size, "%.0fG", (gfloat) t / (1024*1024));
+    else if (t > 1024*1024)
+        return snprintf(buf, size, "%.1fG", (gfloat) t / (1024*1024));
+    else if (t > 50*1024)
+        return snprintf(buf, size, "%.0fM", (gfloat) t / (1024));
+    else
+        return snprintf(buf, size, "%.1fM", (gfloat) t / (1024));
+}
+
+/* Render a percentage, clamped to 0-100 */
+static gint
+render_percent(gint64 t, gchar *buf, gint size)
+{
+    return snprintf(buf, size, "%d%%", (gint) CLAMP(t, 0, 100));
+}
+
+/* Render a rate in KiB/s */
+static gint
+render_rate(gint64 t, gchar *buf, gint size)
+{
+    gint n = render_memory_size(t, buf, size);
+    
+    return n + snprintf(buf + MIN(n, size), size - MIN(n, size), "/s");
+}
+
+/* Render a time in seconds, to the largest two units */
+static gint
+render_duration(gint64 t, gchar *buf, gint size)
+{
+    if (t >= 3600)
+        return snprintf(buf, size, "%dh%02dm", (gint) (t / 3600), (gint) (t / 60 % 60));
+    else if (t >= 60)
+        return snprintf(buf, size, "%dm%02ds", (gint) (t / 60), (gint) (t % 60));
+    else
+        return snprintf(buf, size, "%ds", (gint) t);
+}
+
+/* Traffic over all NVLinks of a GPU in KiB/s, both directions */
+static gulong
+nvlink_rate(GpuPlugin *gpu)
+{
+    gulong sum = 0;
+    
+    for (gint c = 2; c < 2 + 2 * gpu->dev->n_nvlinks; ++c) {
+        sum += gpu->link_rates[c];
+    }
+    return sum;
+}
+
+static gint64
+fmt_value_utilization(GpuPlugin *gpu)
+{
+    return gpu->hot->utilization;
+}
+
+static gint64
+fmt_value_memory_percent(GpuPlugin *gpu)
+{
+    if (gpu->hot->total_memory / 1024 == 0)
+        return 0;
+    return (gint64) round(100 * (gfloat) (gpu->hot->used_memory / 1024) / (gpu->hot->total_memory / 1024));
+}
+
+static gint64
+fmt_value_memory_used(GpuPlugin *gpu)
+{
+    return gpu->hot->used_memory / 1024;
+}
+
+static gint64
+fmt_value_memory_total(GpuPlugin *gpu)
+{
+    return gpu->hot->total_memory / 1024;
+}
+
+static gint64
+fmt_value_power(GpuPlugin *gpu)
+{
+    return (gint64) round(gpu->hot->power);
+}
+
+static gint
+fmt_render_power(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return snprintf(buf, size, "%dW", (gint) value);
+}
+
+static gint64
+fmt_value_temperature(GpuPlugin *gpu)
+{
+    return (gint64) round(gpu->hot->temperature * 10);
+}
+
+static gint
+fmt_render_temperature(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return snprintf(buf, size, "%.1fC", (gfloat) value / 10);
+}
+
+static gint64
+fmt_value_label(GpuPlugin *gpu)
+{
+    return (gint64) (gsize) gpu->label;
+}
+
+static gint
+fmt_render_label(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return snprintf(buf, size, "%s", gpu->label);
+}
+
+static gint64
+fmt_value_hostname(GpuPlugin *gpu)
+{
+    return (gint64) (gsize) gkrellm_get_hostname();
+}
+
+static gint
+fmt_render_hostname(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return snprintf(buf, size, "%s", gkrellm_get_hostname());
+}
+
+static gint64
+fmt_value_number(GpuPlugin *gpu)
+{
+    return gpu->instance;
+}
+
+static gint
+fmt_render_number(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return snprintf(buf, size, "%d", (gint) value);
+}
+
+/* Composite reductions; for a single GPU these are its utilization */
+static gint64
+fmt_value_mean(GpuPlugin *gpu)
+{
+    return gpu->hot->reduction.value[GPU_REDUCE_MEAN];
+}
+
+static gint64
+fmt_value_weighted(GpuPlugin *gpu)
+{
+    return gpu->hot->reduction.value[GPU_REDUCE_WEIGHTED];
+}
+
+static gint64
+fmt_value_min(GpuPlugin *gpu)
+{
+    return gpu->hot->reduction.value[GPU_REDUCE_MIN];
+}
+
+static gint64
+fmt_value_max(GpuPlugin *gpu)
+{
+    return gpu->hot->reduction.value[GPU_REDUCE_MAX];
+}
+
+static gint64
+fmt_value_p90(GpuPlugin *gpu)
+{
+    return gpu->hot->reduction.value[GPU_REDUCE_P90];
+}
+
+static gint64
+fmt_value_busy(GpuPlugin *gpu)
+{
+    return gpu->hot->reduction.busy;
+}
+
+static gint64
+fmt_value_reduced(GpuPlugin *gpu)
+{
+    return gpu->hot->reduction.n;
+}
+
+/* The busiest process on the GPU */
+static gint64
+fmt_value_process(GpuPlugin *gpu)
+{
+    if (gpu->n_procs == 0)
+        return 0;
+    return ((gint64) gpu->procs[0].pid << 32) | g_str_hash(gpu->procs[0].comm);
+}
+
+static gint
+fmt_render_process(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return snprintf(buf, size, "%s", gpu->n_procs > 0 ? gpu->procs[0].comm : "-");
+}
+
+static gint64
+fmt_value_process_memory(GpuPlugin *gpu)
+{
+    return gpu->n_procs > 0 ? gpu->procs[0].used_memory / 1024 : 0;
+}
+
+static gint64
+fmt_value_process_sm(GpuPlugin *gpu)
+{
+    return gpu->n_procs > 0 ? gpu->procs[0].sm_util : 0;
+}
+
+static gint64
+fmt_value_process_count(GpuPlugin *gpu)
+{
+    return gpu->procs_total;
+}
+
+static gint64
+fmt_value_pcie_tx(GpuPlugin *gpu)
+{
+    return gpu->link_rates[0];
+}
+
+static gint64
+fmt_value_pcie_rx(GpuPlugin *gpu)
+{
+    return gpu->link_rates[1];
+}
+
+static gint64
+fmt_value_nvlink(GpuPlugin *gpu)
+{
+    return nvlink_rate(gpu);
+}
+
+static gint64
+fmt_value_xid_count(GpuPlugin *gpu)
+{
+    return gpu->xid_count;
+}
+
+static gint64
+fmt_value_last_xid(GpuPlugin *gpu)
+{
+    return gpu->last_xid;
+}
+
+static gint
+fmt_render_xid(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    if (value == 0)
+        return snprintf(buf, size, "-");
+    return snprintf(buf, size, "%" G_GINT64_FORMAT, value);
+}
+
+/* The raised alerts by config name, comma separated */
+static gint64
+fmt_value_alerts(GpuPlugin *gpu)
+{
+    return gpu->alerts;
+}
+
+static gint
+fmt_render_alerts(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    gint len = 0;
+    
+    if (value == 0)
+        return snprintf(buf, size, "-");
+    for (gint a = 0; a < N_GPU_ALERTS && len < size; ++a) {
+        if (value & (1u << a)) {
+            len += snprintf(buf + len, size - len, "%s%s", len > 0 ? "," : "",
+                            gpu_alert_rules[a].name);
+        }
+    }
+    return len;
+}
+
+/* The kinds of clock throttling held now, comma separated */
+static gint64
+fmt_value_throttle(GpuPlugin *gpu)
+{
+    return gpu->throttle;
+}
+
+static gint
+fmt_render_throttle(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    gint len = 0;
+    
+    if (value == 0)
+        return snprintf(buf, size, "-");
+    for (gint c = 0; c < N_GPU_THROTTLE && len < size; ++c) {
+        if (value & (1u << c)) {
+            len += snprintf(buf + len, size - len, "%s%s", len > 0 ? "," : "",
+                            gpu_throttle_categories[c].name);
+        }
+    }
+    return len;
+}
+
+/* Seconds the clocks were held down since start, by anything that is
+ * marked on the chart */
+static gint64
+fmt_value_throttle_time(GpuPlugin *gpu)
+{
+    gint64 seconds = 0;
+    
+    for (gint c = 0; c < N_GPU_THROTTLE; ++c) {
+        if (gpu_throttle_categories[c].mark) {
+            seconds += gpu->throttle_seconds[c];
+        }
+    }
+    return seconds;
+}
+
+static gint
+fmt_render_duration(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return render_duration(value, buf, size);
+}
+
+static gint
+fmt_render_rate(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return render_rate(value, buf, size);
+}
+
+static gint
+fmt_render_percent(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return render_percent(value, buf, size);
+}
+
+static gint
+fmt_render_memory(GpuPlugin *gpu, gint64 value, gchar *buf, gint size)
+{
+    return render_memory_size(value, buf, size);
+}
+
+/* Substitution variables for chart labels and alert commands.  value()
+ * returns what the output depends on, so cached text is only rebuilt
+ * when it changes; render() turns that value into text. */
+typedef struct {
+    gchar        code;             /* Character following the $ */
+    gint64       (*value)(GpuPlugin *gpu);
+    gint         (*render)(GpuPlugin *gpu, gint64 value, gchar *buf, gint size);
+} GpuFormatVar;
+
+static GpuFormatVar format_vars[] = {
+    { 'u', fmt_value_utilization,    fmt_render_percent },
+    { 'm', fmt_value_memory_percent, fmt_render_percent },
+    { 'U', fmt_value_memory_used,    fmt_render_memory },
+    { 'T', fmt_value_memory_total,   fmt_render_memory },
+    { 'W', fmt_value_power,          fmt_render_power },
+    { 't', fmt_value_temperature,    fmt_render_temperature },
+    { 'L', fmt_value_label,          fmt_render_label },
+    { 'H', fmt_value_hostname,       fmt_render_hostname },
+    { 'N', fmt_value_number,         fmt_render_number },
+    { 'a', fmt_value_mean,           fmt_render_percent },
+    { 'w', fmt_value_weighted,       fmt_render_percent },
+    { 'n', fmt_value_min,            fmt_render_percent },
+    { 'x', fmt_value_max,            fmt_render_percent },
+    { 'p', fmt_value_p90,            fmt_render_percent },
+    { 'b', fmt_value_busy,           fmt_render_number },
+    { 'g', fmt_value_reduced,        fmt_render_number },
+    { 'P', fmt_value_process,        fmt_render_process },
+    { 'M', fmt_value_process_memory, fmt_render_memory },
+    { 'S', fmt_value_process_sm,     fmt_render_percent },
+    { 'c', fmt_value_process_count,  fmt_render_number },
+    { 'X', fmt_value_pcie_tx,        fmt_render_rate },
+    { 'R', fmt_value_pcie_rx,        fmt_render_rate },
+    { 'V', fmt_value_nvlink,         fmt_render_rate },
+    { 'E', fmt_value_xid_count,      fmt_render_number },
+    { 'Z', fmt_value_last_xid,       fmt_render_xid },
+    { 'A', fmt_value_alerts,         fmt_render_alerts },
+    { 'K', fmt_value_throttle,       fmt_render_throttle },
+    { 'k', fmt_value_throttle_time,  fmt_render_duration },
+};
+#define N_FORMAT_VARS ((gint) G_N_ELEMENTS(format_vars))
+
+/* Rolling statistics are written $[SERIES:KIND:MINUTES], as in
+ * $[u:mean:15].  They follow format_vars in the variable numbering, a
+ * variable for each series, kind and window. */
+static const gchar stats_series_codes[GPU_STATS_SERIES] = { 'u', 'm', 't' };
+static const gchar *stats_kind_names[GPU_STATS_KINDS] = { "mean", "sd", "p95", "max" };
+#define N_STATS_VARS (GPU_STATS_SERIES * GPU_STATS_KINDS * GPU_STATS_WINDOWS)
+G_STATIC_ASSERT(G_N_ELEMENTS(format_vars) + N_STATS_VARS <= GPU_MAX_FORMAT_VARS);
+
+/* Find the substitution variable for a $ code */
+static gint
+format_var_lookup(gchar c)
+{
+    for (gint i = 0; i < N_FORMAT_VARS; ++i) {
+        if (format_vars[i].code == c)
+            return i;
+    }
+    return -1;
+}
+
+/* Find the statistics variable at s, "[SERIES:KIND:MINUTES]", and point
+ * end at its closing bracket */
+static gint
+stats_var_lookup(const gchar *s, const gchar **end)
+{
+    gchar series, kind[8];
+    guint minutes;
+    gint n = 0, var = 0;
+    
+    if (sscanf(s, "[%c:%7[a-z0-9]:%u]%n", &series, kind, &minutes, &n) != 3 || n == 0)
+        return -1;
+    
+    while (var < GPU_STATS_SERIES && stats_series_codes[var] != series)
+        ++var;
+    if (var == GPU_STATS_SERIES)
+        return -1;
+    for (gint k = 0; k < GPU_STATS_KINDS; ++k) {
+        if (strcmp(kind, stats_kind_names[k]) != 0)
+            continue;
+        for (gint w = 0; w < GPU_STATS_WINDOWS; ++w) {
+            if (minutes * 60 == gpu_stats_window_seconds(w)) {
+                *end = s + n - 1;
+                return N_FORMAT_VARS + (var * GPU_STATS_KINDS + k) * GPU_STATS_WINDOWS + w;
+            }
+        }
+    }
+    return -1;
+}
+
+/* The value of a statistics variable in tenths, -1 without readings */
+static gint64
+stats_var_value(GpuPlugin *gpu, gint var)
+{
+    gint i = var - N_FORMAT_VARS;
+    gdouble value = gpu_stats_get(gpu->stats, i / (GPU_STATS_KINDS * GPU_STATS_WINDOWS),
+                                  i % GPU_STATS_WINDOWS,
+                                  (i / GPU_STATS_WINDOWS) % GPU_STATS_KINDS);
+    
+    return value < 0 ? -1 : (gint64) round(value * 10);
+}
+
+static gint
+stats_var_render(GpuPlugin *gpu, gint var, gint64 value, gchar *buf, gint size)
+{
+    gint i = var - N_FORMAT_VARS;
+    gint kind = (i / GPU_STATS_WINDOWS) % GPU_STATS_KINDS;
+    const gchar *unit = (i / (GPU_STATS_KINDS * GPU_STATS_WINDOWS) == GPU_STATS_TEMPERATURE)
+                        ? "C" : "%";
+    
+    if (value < 0)
+        return snprintf(buf, size, "-");
+    if (kind == GPU_STATS_MEAN || kind == GPU_STATS_STDDEV)
+        return snprintf(buf, size, "%.1f%s", (gfloat) value / 10, unit);
+    return snprintf(buf, size, "%d%s", (gint) (value / 10), unit);
+}
+
+/* Value and text of any substitution variable */
+static gint64
+format_var_value(GpuPlugin *gpu, gint var)
+{
+    if (var >= N_FORMAT_VARS)
+        return stats_var_value(gpu, var);
+    return format_vars[var].value(gpu);
+}
+
+static gint
+format_var_render(GpuPlugin *gpu, gint var, gint64 value, gchar *buf, gint size)
+{
+    if (var >= N_FORMAT_VARS)
+        return stats_var_render(gpu, var, value, buf, size);
+    return format_vars[var].render(gpu, value, buf, size);
+}
+
+static void
+format_free(GpuFormat *fmt)
+{
+    if (!fmt)
+        return;
+    for (gint i = 0; i < fmt->n_tokens; ++i)
+        g_free(fmt->tokens[i].text);
+    g_free(fmt->tokens);
+    g_free(fmt);
+}
+
+/* Compile a format string.  Runs of literal text and unknown $ codes are
+ * merged into single literal tokens. */
+static GpuFormat *
+format_compile(const gchar *src_string)
+{
+    GpuFormat *fmt;
+    GArray *tokens;
+    GString *literal;
+    GpuFormatToken token;
+    const gchar *s, *end;
+    gint var;
+
+    fmt = g_new0(GpuFormat, 1);
+    fmt->serial = ++format_serial;
+    if (!src_string)
+        return fmt;
+
+    tokens = g_array_new(FALSE, TRUE, sizeof(GpuFormatToken));
+    literal = g_string_new(NULL);
+
+    for (s = src_string; *s != '\0'; ++s) {
+        if (*s != '$' || *(s + 1) == '\0') {
+            g_string_append_c(literal, *s);
+            continue;
+        }
+
+        ++s;
+        if (*s == '[') {
+            var = stats_var_lookup(s, &end);
+            if (var >= 0)
+                s = end;
+        }
+        else {
+            var = format_var_lookup(*s);
+        }
+        if (var < 0) {
+            /* Unknown variables are copied through as is */
+            g_string_append_c(literal, '$');
+            g_string_append_c(literal, *s);
+            continue;
+        }
+
+        if (literal->len > 0) {
+            token.var = -1;
+            token.len = literal->len;
+            token.text = g_strndup(literal->str, literal->len);
+            g_array_append_val(tokens, token);
+            g_string_truncate(literal, 0);
+        }
+        token.var = var;
+        token.text = NULL;
+        token.len = 0;
+        g_array_append_val(tokens, token);
+    }
+    if (literal->len > 0) {
+        token.var = -1;
+        token.len = literal->len;
+        token.text = g_strndup(literal->str, literal->len);
+        g_array_append_val(tokens, token);
+    }
+
+    fmt->n_tokens = tokens->len;
+    fmt->tokens = (GpuFormatToken *) g_array_free(tokens, FALSE);
+    g_string_free(literal, TRUE);
+
+    return fmt;
+}
+
+/* Run a compiled format for a GPU.  With quote every substituted value
+ * is quoted for /bin/sh.  FALSE if the text did not fit in buf. */
+static gboolean
+format_run(GpuFormat *fmt, GpuPlugin *gpu, gboolean quote, gchar *buf, gint size)
+{
+    GpuFormatToken *token;
+    gchar value[256], *quoted;
+    gboolean fits = TRUE;
+    gint len;
+
+    if (!buf || size < 1)
+        return FALSE;
+    *buf = '\0';
+    if (!fmt)
+        return TRUE;
+
+    for (gint i = 0; i < fmt->n_tokens; ++i) {
+        token = &fmt->tokens[i];
+        if (token->var < 0) {
+            len = MIN(token->len, size - 1);
+            if (len < token->len)
+                fits = FALSE;
+            memcpy(buf, token->text, len);
+            buf[len] = '\0';
+        }
+        else if (quote) {
+            len = format_var_render(gpu, token->var, format_var_value(gpu, token->var),
+                                    value, sizeof(value));
+            if (len >= (gint) sizeof(value))
+                fits = FALSE;
+            quoted = g_shell_quote(value);
+            len = snprintf(buf, size, "%s", quoted);
+            g_free(quoted);
+        }
+        else {
+            len = format_var_render(gpu, token->var, format_var_value(gpu, token->var),
+                                    buf, size);
+        }
+        if (len >= size) {
+            fits = FALSE;
+            len = size - 1;
+        }
+        len = MAX(len, 0);
+        size -= len;
+        buf += len;
+    }
+    return fits;
+}
+
+/* (Re)compile the chart label format after text_format_locale changed */
+static void
+compile_text_format(void)
+{
+    format_free(chart_format);
+    chart_format = format_compile(text_format_locale);
+}
+
+/* Format an alert command for a GPU, its values quoted for the shell.
+ * FALSE if it did not fit in buf. */
+static gboolean
+format_gpu_data(GpuPlugin *gpu, gchar *src_string, gchar *buf, gint size)
+{
+    GpuFormat *fmt;
+
+    if (!buf || size < 1)
+        return FALSE;
+    *buf = '\0';
+    if (!src_string)
+        return TRUE;
+
+    if (!command_formats) {
+        command_formats = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                (GDestroyNotify) format_free);
+    }
+    fmt = g_hash_table_lookup(command_formats, src_string);
+    if (!fmt) {
+        fmt = format_compile(src_string);
+        g_hash_table_insert(command_formats, g_strdup(src_string), fmt);
+    }
+
+    return format_run(fmt, gpu, TRUE, buf, size);
+}
+
+/* Format a string for the GPU in a slot as alert commands are;
+ * exported for tests/bench */
+void
+gpu_format_command(gint slot, gchar *src, gchar *buf, gint size)
+{
+    if (slot >= 0 && slot < n_slots) {
+        format_gpu_data(&gpus[slot], src, buf, size);
+    }
+    else if (buf && size > 0) {
+        *buf = '\0';
+    }
+}
+
+/* Return the chart label text for a GPU, only rebuilding it when one of
+ * the values it references changed */
+static const gchar *
+format_gpu_chart_text(GpuPlugin *gpu)
+{
+    GpuFormatToken *token;
+    gboolean stale;
+    gint64 value;
+
+    if (!chart_format)
+        compile_text_format();
+
+    stale = (gpu->format_serial != chart_format->serial);
+    for (gint i = 0; i < chart_format->n_tokens; ++i) {
+        token = &chart_format->tokens[i];
+        if (token->var < 0)
+            continue;
+        value = format_var_value(gpu, token->var);
+        if (value != gpu->format_values[token->var]) {
+            gpu->format_values[token->var] = value;
+            stale = TRUE;
+        }
+    }
+
+    if (stale) {
+        format_run(chart_format, gpu, FALSE, gpu->format_text, sizeof(gpu->format_text));
+        gpu->format_serial = chart_format->serial;
+    }
+
+    return gpu->format_text;
+}
+
+/* Remember the events of the column just stored, the newest mark being
+ * at the right edge of the chart like the data */
+static void
+push_chart_marks(GpuPlugin *gpu, guint events)
+{
+    GkrellmChart *cp = gpu->chart;
+    
+    if (cp->w <= 0) {
+        return;
+    }
+    if (cp->w != gpu->n_marks) {
+        /* Marks are rare, so they are simply dropped on a resize */
+        g_free(gpu->marks);
+        gpu->marks = g_new0(guchar, cp->w);
+        gpu->n_marks = cp->w;
+        gpu->mark_head = 0;
+        gpu->n_marked = 0;
+    }
+    
+    if (gpu->marks[gpu->mark_head]) {
+        gpu->n_marked--;
+    }
+    gpu->marks[gpu->mark_head] = (guchar) events;
+    if (events) {
+        gpu->n_marked++;
+    }
+    gpu->mark_head = (gpu->mark_head + 1) % gpu->n_marks;
+}
+
+/* Time per chart column of a GPU; without a history file only seconds
+ * can be charted */
+static gint
+chart_tier(GpuPlugin *gpu)
+{
+    return gpu->history ? history_tier : GPU_HISTORY_SECONDS;
+}
+
+/* Record the second just fetched.  A GPU that is down records nothing,
+ * so its outage reads as a gap rather than as idle time. */
+static void
+record_gpu_history(gint64 now)
+{
+    GpuPlugin *gpu;
+    guint8 values[GPU_HISTORY_SERIES];
+    
+    for (gint i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
+        if (!gpu->enabled || !gpu->history || gpu->health != GPU_HEALTH_OK) {
+            continue;
+        }
+        values[GPU_HISTORY_UTILIZATION] = (guint8) MIN(gpu->hot->column_mean, 100);
+        values[GPU_HISTORY_PEAK] = (guint8) MIN(gpu->hot->column_peak, 100);
+        values[GPU_HISTORY_MEMORY] = (guint8) CLAMP(fmt_value_memory_percent(gpu), 0, 100);
+        gpu_history_insert(gpu->history, now, values);
+    }
+}
+
+/* Record the second just fetched in the rolling statistics.  A value
+ * not read, like the temperature of a GPU that is down, counts as no
+ * reading rather than as 0. */
+static void
+record_gpu_stats(void)
+{
+    GpuPlugin *gpu;
+    guint8 values[GPU_STATS_SERIES];
+    gboolean up;
+    
+    for (gint i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
+        up = (gpu->health == GPU_HEALTH_OK);
+        values[GPU_STATS_UTILIZATION] = up ? (guint8) MIN(gpu->hot->column_mean, 100)
+                                           : GPU_STATS_NONE;
+        values[GPU_STATS_MEMORY] = up && gpu->hot->total_memory > 0
+                                   ? (guint8) CLAMP(fmt_value_memory_percent(gpu), 0, 100)
+                                   : GPU_STATS_NONE;
+        values[GPU_STATS_TEMPERATURE] = up && gpu->hot->temperature > 0
+                                        ? (guint8) MIN(round(gpu->hot->temperature),
+                                                       GPU_STATS_MAX_VALUE)
+                                        : GPU_STATS_NONE;
+        gpu_stats_push(gpu->stats, values);
+    }
+}
+
+/* Count the second just fetched against each kind of clock throttling
+ * held.  The tooltip lists the times, so it is rebuilt while a GPU is
+ * throttled; being idle or at set clocks is not throttling. */
+static void
+count_throttle_time(void)
+{
+    GpuPlugin *gpu;
+    
+    for (gint i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
+        if (gpu->health != GPU_HEALTH_OK || !gpu->throttle) {
+            continue;
+        }
+        for (gint c = 0; c < N_GPU_THROTTLE; ++c) {
+            if (gpu->throttle & (1u << c)) {
+                gpu->throttle_seconds[c]++;
+                if (gpu_throttle_categories[c].mark) {
+                    gpu->tooltip_dirty = TRUE;
+                }
+            }
+        }
+    }
+}
+
+/* Values served by the exporter, in base units */
+static gdouble
+metric_up(GpuPlugin *gpu)
+{
+    return gpu->health == GPU_HEALTH_OK;
+}
+
+static gdouble
+metric_utilization(GpuPlugin *gpu)
+{
+    return gpu->hot->utilization / 100.0;
+}
+
+static gdouble
+metric_memory_used(GpuPlugin *gpu)
+{
+    return gpu->hot->used_memory;
+}
+
+static gdouble
+metric_memory_total(GpuPlugin *gpu)
+{
+    return gpu->hot->total_memory;
+}
+
+static gdouble
+metric_temperature(GpuPlugin *gpu)
+{
+    return gpu->hot->temperature;
+}
+
+static gdouble
+metric_power(GpuPlugin *gpu)
+{
+    return gpu->hot->power;
+}
+
+static gdouble
+metric_processes(GpuPlugin *gpu)
+{
+    return gpu->procs_total;
+}
+
+static gdouble
+metric_pcie_tx(GpuPlugin *gpu)
+{
+    return gpu->link_rates[0] * 1024.0;
+}
+
+static gdouble
+metric_pcie_rx(GpuPlugin *gpu)
+{
+    return gpu->link_rates[1] * 1024.0;
+}
+
+static gdouble
+metric_nvlink(GpuPlugin *gpu)
+{
+    return nvlink_rate(gpu) * 1024.0;
+}
+
+static gdouble
+metric_xid_errors(GpuPlugin *gpu)
+{
+    return gpu->xid_count;
+}
+
+typedef struct {
+    const gchar  *name;            /* Metric family name */
+    const gchar  *type;            /* OpenMetrics type */
+    const gchar  *unit;            /* Unit the name ends in, NULL for none */
+    const gchar  *help;
+    gdouble      (*value)(GpuPlugin *gpu);
+} GpuMetricFamily;
+
+static const GpuMetricFamily metric_families[] = {
+    { "gkrellm_gpu_up", "gauge", NULL,
+      "Whether the GPU is answering NVML calls", metric_up },
+    { "gkrellm_gpu_utilization_ratio", "gauge", "ratio",
+      "Fraction of time a kernel was running", metric_utilization },
+    { "gkrellm_gpu_memory_used_bytes", "gauge", "bytes",
+      "Device memory in use", metric_memory_used },
+    { "gkrellm_gpu_memory_total_bytes", "gauge", "bytes",
+      "Device memory available", metric_memory_total },
+    { "gkrellm_gpu_temperature_celsius", "gauge", "celsius",
+      "GPU core temperature", metric_temperature },
+    { "gkrellm_gpu_power_watts", "gauge", "watts",
+      "Power draw", metric_power },
+    { "gkrellm_gpu_processes", "gauge", NULL,
+      "Processes using the GPU", metric_processes },
+    { "gkrellm_gpu_pcie_transmit_bytes_per_second", "gauge", NULL,
+      "PCIe transmit rate", metric_pcie_tx },
+    { "gkrellm_gpu_pcie_receive_bytes_per_second", "gauge", NULL,
+      "PCIe receive rate", metric_pcie_rx },
+    { "gkrellm_gpu_nvlink_bytes_per_second", "gauge", NULL,
+      "NVLink traffic over all links and directions", metric_nvlink },
+    { "gkrellm_gpu_xid_errors", "counter", NULL,
+      "Critical XID errors since GKrellM started", metric_xid_errors },
+};
+
+/* Format the values just fetched for the exporter, which serves the same
+ * text to every scrape until the next second.  A GPU that is down only
+ * reports gkrellm_gpu_up. */
+static void
+publish_metrics(void)
+{
+    const GpuMetricFamily *family;
+    GpuPlugin *gpu;
+    gboolean counter;
+    
+    if (!metrics_text) {
+        metrics_text = g_string_sized_new(4096);
+    }
+    g_string_truncate(metrics_text, 0);
+    
+    for (guint f = 0; f < G_N_ELEMENTS(metric_families); ++f) {
+        family = &metric_families[f];
+        counter = !strcmp(family->type, "counter");
+        g_string_append_printf(metrics_text, "# TYPE %s %s\n", family->name, family->type);
+        if (family->unit) {
+            g_string_append_printf(metrics_text, "# UNIT %s %s\n", family->name, family->unit);
+        }
+        g_string_append_printf(metrics_text, "# HELP %s %s.\n", family->name, family->help);
+        
+        for (gint i = 0; i < n_slots; ++i) {
+            gpu = &gpus[i];
+            if (!gpu->enabled || gpu->is_composite
+                || (gpu->health != GPU_HEALTH_OK && family->value != metric_up)) {
+                continue;
+            }
+            g_string_append_printf(metrics_text, "%s%s{%s} %.15g\n",
+                                   family->name, counter ? "_total" : "",
+                                   gpu->metric_labels, family->value(gpu));
+        }
+    }
+    g_string_append(metrics_text, "# EOF\n");
+    
+    gpu_exporter_publish(exporter, metrics_text->str, metrics_text->len);
+}
+
+/* Store a chart column from a history point: the means over the period,
+ * with the peak series keeping its highest second.  The composite's
+ * spread over the GPUs is not kept in the history and reads 0. */
+static void
+store_history_column(GpuPlugin *gpu, const GpuHistoryPoint *point)
+{
+    gulong util = 0, mem = 0, peak = 0;
+    
+    if (point->count > 0) {
+        util = point->sum[GPU_HISTORY_UTILIZATION] / point->count;
+        mem = point->sum[GPU_HISTORY_MEMORY] / point->count;
+        peak = point->max[GPU_HISTORY_PEAK];
+    }
+    if (gpu->is_composite) {
+        gkrellm_store_chartdata(gpu->chart, 0, util, mem, peak, 0, 0, 0, 0);
+    }
+    else {
+        gkrellm_store_chartdata(gpu->chart, 0, util, mem, peak);
+    }
+}
+
+/* At minutes or hours per column, a column is stored once its period is
+ * over, marked with every event seen during it */
+static void
+store_history_period(GpuPlugin *gpu, gint64 now)
+{
+    gint tier = chart_tier(gpu);
+    guint resolution = gpu_history_resolution(tier);
+    guint32 period = (guint32) (now / resolution);
+    GpuHistoryPoint point;
+    
+    if (period != gpu->history_period) {
+        gpu_history_read(gpu->history, tier,
+                         (gint64) gpu->history_period * resolution, 1, &point);
+        store_history_column(gpu, &point);
+        push_chart_marks(gpu, gpu->period_events);
+        gpu->history_period = period;
+        gpu->period_events = 0;
+    }
+    gpu->period_events |= gpu->column_events;
+}
+
+/* Fill a newly allocated or cleared chart from the history, so it does
+ * not start out empty.  Event marks are not kept in the history. */
+static void
+backfill_gpu_chart(GpuPlugin *gpu)
+{
+    GkrellmChart *cp = gpu->chart;
+    gint tier = chart_tier(gpu);
+    guint resolution = gpu_history_resolution(tier);
+    gint64 now = g_get_real_time() / G_USEC_PER_SEC;
+    GpuHistoryPoint *points;
+    
+    g_free(gpu->marks);
+    gpu->marks = NULL;
+    gpu->n_marks = 0;
+    gpu->mark_head = 0;
+    gpu->n_marked = 0;
+    gpu->history_period = (guint32) (now / resolution);
+    gpu->period_events = 0;
+    if (!gpu->history || cp->w <= 0) {
+        return;
+    }
+    
+    /* Up to the last complete period, the current one is stored as it ends */
+    points = g_new(GpuHistoryPoint, cp->w);
+    gpu_history_read(gpu->history, tier, now - resolution, cp->w, points);
+    for (gint i = 0; i < cp->w; ++i) {
+        store_history_column(gpu, &points[i]);
+    }
+    g_free(points);
+}
+
+/* Draw the event marks over the chart data: a red line for a critical
+ * XID error, a short yellow tick at the top for a clock or power state
+ * change, a colored tick below it for each kind of clock throttling and
+ * an orange tick at the bottom for a raised alert */
+static void
+draw_chart_marks(GpuPlugin *gpu)
+{
+    static const GdkColor xid_color = { 0, 0xffff, 0x2000, 0x2000 };
+    static const GdkColor change_color = { 0, 0xffff, 0xe000, 0x4000 };
+    static const GdkColor alert_color = { 0, 0xffff, 0x8000, 0x0000 };
+    static const GdkColor throttle_colors[] = {  /* From GPU_MARK_POWER_CAP up */
+        { 0, 0xa000, 0x6000, 0xffff },           /* Power cap, violet */
+        { 0, 0xffff, 0x4000, 0x8000 },           /* Thermal, pink */
+        { 0, 0x4000, 0xe000, 0xffff },           /* HW slowdown, cyan */
+        { 0, 0x4000, 0xffff, 0x4000 }            /* Sync boost, green */
+    };
+    GkrellmChart *cp = gpu->chart;
+    guchar mark;
+    
+    if (gpu->n_marked == 0 || gpu->n_marks != cp->w || !cp->pixmap) {
+        return;
+    }
+    if (!mark_gc) {
+        mark_gc = gdk_gc_new(cp->pixmap);
+    }
+    
+    for (gint i = 0; i < gpu->n_marks; ++i) {
+        mark = gpu->marks[(gpu->mark_head + i) % gpu->n_marks];
+        if (!mark) {
+            continue;
+        }
+        if (mark & (GPU_MARK_CLOCK | GPU_MARK_PSTATE)) {
+            gdk_gc_set_rgb_fg_color(mark_gc, &change_color);
+            gdk_draw_rectangle(cp->pixmap, mark_gc, TRUE, i, 0, 1, MIN(cp->h, 3));
+        }
+        for (gint k = 0; k < (gint) G_N_ELEMENTS(throttle_colors); ++k) {
+            if ((mark & (GPU_MARK_POWER_CAP << k)) && 3 + 2 * k < cp->h) {
+                gdk_gc_set_rgb_fg_color(mark_gc, &throttle_colors[k]);
+                gdk_draw_rectangle(cp->pixmap, mark_gc, TRUE, i, 3 + 2 * k, 1, 2);
+            }
+        }
+        if (mark & GPU_MARK_ALERT) {
+            gdk_gc_set_rgb_fg_color(mark_gc, &alert_color);
+            gdk_draw_rectangle(cp->pixmap, mark_gc, TRUE, i, MAX(cp->h - 3, 0),
+                               1, MIN(cp->h, 3));
+        }
+        if (mark & GPU_MARK_XID) {
+            gdk_gc_set_rgb_fg_color(mark_gc, &xid_color);
+            gdk_draw_rectangle(cp->pixmap, mark_gc, TRUE, i, 0, 1, cp->h);
+        }
+    }
+}
+
+/* Refresh chart UI */
+static void
+refresh_gpu_chart(GpuPlugin *gpu)
+{
+    GkrellmChart *cp = gpu->chart;
+
+    gkrellm_draw_chartdata(cp);
+    draw_chart_marks(gpu);
+    if (gpu->extra_info) {
+        gkrellm_draw_chart_text(cp, style_id, (gchar *) format_gpu_chart_text(gpu));
+    }
+    gkrellm_draw_chart_to_screen(cp);
+}
+
+/* List the busiest processes of a GPU in its panel tooltip, after the
+ * launcher's tooltip comment if there is one */
+static void
+update_process_tooltip(GpuPlugin *gpu)
+{
+    GString *text = g_string_new(NULL);
+    GpuProcess *proc;
+    gchar mem[32];
+    
+    if (gpu->launch.tooltip_comment && *gpu->launch.tooltip_comment) {
+        g_string_append_printf(text, "%s\n", gpu->launch.tooltip_comment);
+    }
+    if (gpu->health == GPU_HEALTH_LOST) {
+        g_string_append_printf(text, _("%s: lost, retrying"), gpu->label);
+    }
+    else if (gpu->health == GPU_HEALTH_STALE) {
+        g_string_append_printf(text, _("%s: not responding, retrying"), gpu->label);
+    }
+    else if (gpu->procs_total == 0) {
+        g_string_append_printf(text, _("%s: no processes"), gpu->label);
+    }
+    else {
+        g_string_append_printf(text, _("%s: %d processes"), gpu->label, gpu->procs_total);
+    }
+    if (gpu->throttle & ~(1u << GPU_THROTTLE_IDLE)) {
+        g_string_append(text, _("\nClocks held down by:"));
+        for (gint c = 0; c < N_GPU_THROTTLE; ++c) {
+            if (c != GPU_THROTTLE_IDLE && (gpu->throttle & (1u << c))) {
+                g_string_append_printf(text, " %s", _(gpu_throttle_categories[c].label));
+            }
+        }
+    }
+    for (gint c = 0, n = 0; c < N_GPU_THROTTLE; ++c) {
+        if (c == GPU_THROTTLE_IDLE || gpu->throttle_seconds[c] == 0) {
+            continue;
+        }
+        render_duration(gpu->throttle_seconds[c], mem, sizeof(mem));
+        g_string_append_printf(text, n++ ? ", %s %s" : _("\nThrottled for: %s %s"),
+                               _(gpu_throttle_categories[c].label), mem);
+    }
+    if (gpu->alerts) {
+        g_string_append(text, _("\nAlerts:"));
+        for (gint a = 0; a < N_GPU_ALERTS; ++a) {
+            if (gpu->alerts & (1u << a)) {
+                g_string_append_printf(text, " %s", _(gpu_alert_rules[a].label));
+            }
+        }
+    }
+    for (gint i = 0; i < gpu->n_procs; ++i) {
+        proc = &gpu->procs[i];
+        render_memory_size(proc->used_memory / 1024, mem, sizeof(mem));
+        g_string_append_printf(text, _("\n%s (%u)  %s  SM %u%%"),
+                               proc->comm, proc->pid, mem, proc->sm_util);
+    }
+    
+    gtk_widget_set_tooltip_text(gpu->panel->drawing_area, text->str);
+    g_string_free(text, TRUE);
+    gpu->tooltip_dirty = FALSE;
+}
+
+/* Refresh the interconnect chart, with the current rates as text */
+static void
+refresh_link_chart(GpuPlugin *gpu)
+{
+    GkrellmChart *cp = gpu->link_chart;
+    gchar tx[32], rx[32], nv[32], buf[128];
+    
+    gkrellm_draw_chartdata(cp);
+    if (gpu->extra_info) {
+        render_rate(gpu->link_rates[0], tx, sizeof(tx));
+        render_rate(gpu->link_rates[1], rx, sizeof(rx));
+        if (gpu->dev->n_nvlinks > 0) {
+            render_rate(nvlink_rate(gpu), nv, sizeof(nv));
+            snprintf(buf, sizeof(buf), _("PCIe %s / %s\nNVLink %s"), tx, rx, nv);
+        }
+        else {
+            snprintf(buf, sizeof(buf), _("PCIe %s / %s"), tx, rx);
+        }
+        gkrellm_draw_chart_text(cp, style_id, buf);
+    }
+    gkrellm_draw_chart_to_screen(cp);
+}
+
+/* Fix panel when sensor display changes */
+static gboolean
+fix_panel(GpuPlugin *gpu)
+{
+    GkrellmPanel *p = gpu->panel;
+    GkrellmDecal *ds;
+    gboolean result = FALSE;
+    
+    ds = gpu->sensor_decal;
+    if (!ds) {
+        return FALSE;
+    }
+    
+    gpu->show_temperature = TRUE;
+    
+    if (gpu->sensor_temp || gkrellm_demo_mode()) {
+        gpu->show_temperature = TRUE;
+    }
+    
+    g_atomic_int_set(&gpu->dev->want_temperature,
+                     gpu->show_temperature && gpu->sensor_temp != NULL);
+    
+    if (gpu->show_temperature) {
+        if (!gkrellm_is_decal_visible(ds)) {
+            gkrellm_make_decal_visible(p, ds);
+        }
+        result = TRUE;
+    }
+    
+    gkrellm_draw_panel_label(p);
+    gpu->drawn_decal[0] = '\0';
+    draw_sensor_decals(gpu);
+    gkrellm_draw_panel_layers(p);
+    gpu->hot->panel_dirty = FALSE;
+    
+    return result;
+}
+
+static gint
 gpu_chart_expose_event(GtkWidget *widget, GdkEventButton *ev)
 {
-    GList *list;
-    GpuPlugin *gpu;
-    for (list = gpu_list; list; list = list->next) {
-        gpu = (GpuPlugin *)list->data;
-        
-        if (widget == gpu->chart->drawing_area || widget == gpu->panel->drawing_area) {
-            if (ev->type == GDK_BUTTON_PRESS && ev->button == 1) {
-                gpu->extra_info = gpu->extra_info == TRUE ? FALSE : TRUE;
-                gkrellm_config_modified();
-                refresh_gpu_chart(gpu);
-                break;
+    GpuPlugin *gpu;
+    
+    gpu = g_hash_table_lookup(gpu_by_widget, widget);
+    if (!gpu) {
+        return FALSE;
+    }
+    
+    if (ev->type == GDK_BUTTON_PRESS && ev->button == 1) {
+        gpu->extra_info = gpu->extra_info == TRUE ? FALSE : TRUE;
+        gkrellm_config_modified();
+        refresh_gpu_chart(gpu);
+    }
+    else if ((ev->button == 1 && ev->type == GDK_2BUTTON_PRESS) \
+             || (ev->button == 3)) {
+        gkrellm_chartconfig_window_create(gpu->chart);
+    }
+    
+    return FALSE;
+}
+
+/* Color the heat map palette from dark blue through green and yellow
+ * to red; level 0 is the lowest non-idle load */
+static void
+grid_init_palette(void)
+{
+    gdouble t;
+    
+    for (gint i = 0; i < GPU_GRID_LEVELS; ++i) {
+        t = (i + 1.0) / GPU_GRID_LEVELS;
+        grid.palette[i].red   = (guint16) (65535 * CLAMP(1.5 - fabs(4 * t - 3), 0.0, 1.0));
+        grid.palette[i].green = (guint16) (65535 * CLAMP(1.5 - fabs(4 * t - 2), 0.0, 1.0));
+        grid.palette[i].blue  = (guint16) (65535 * CLAMP(1.5 - fabs(4 * t - 1), 0.0, 1.0));
+    }
+}
+
+/* Height of a heat map row in pixels */
+static gint
+grid_row_height(void)
+{
+    return grid.n_rows > 0 ? MAX(grid.chart->h / grid.n_rows, 1) : grid.chart->h;
+}
+
+/* Draw one history column at x.  Idle cells are left as background. */
+static void
+grid_draw_column(gint column, gint x)
+{
+    guchar *values = &grid.history[column * grid.n_rows];
+    gint row_h = grid_row_height();
+    gint level, drawn = -1;
+    
+    for (gint r = 0; r < grid.n_rows; ++r) {
+        if (values[r] == 0) {
+            continue;
+        }
+        level = MIN(values[r] * GPU_GRID_LEVELS / 101, GPU_GRID_LEVELS - 1);
+        if (level != drawn) {
+            gdk_gc_set_rgb_fg_color(grid.gc, &grid.palette[level]);
+            drawn = level;
+        }
+        gdk_draw_rectangle(grid.pixmap, grid.gc, TRUE, x, r * row_h, 1, row_h);
+    }
+}
+
+/* Make the history and the heat map pixmap match the chart size.
+ * Returns TRUE if the heat map has to be redrawn from the history. */
+static gboolean
+grid_sync_size(void)
+{
+    GkrellmChart *cp = grid.chart;
+    guchar *history;
+    gint keep, src;
+    
+    if (cp->w != grid.width) {
+        /* Keep the newest columns, right aligned with the oldest at 0 */
+        history = g_new0(guchar, cp->w * grid.n_rows);
+        keep = MIN(cp->w, grid.width);
+        for (gint i = 0; i < keep; ++i) {
+            src = (grid.head - keep + i + grid.width) % grid.width;
+            memcpy(&history[(cp->w - keep + i) * grid.n_rows],
+                   &grid.history[src * grid.n_rows], grid.n_rows);
+        }
+        g_free(grid.history);
+        grid.history = history;
+        grid.width = cp->w;
+        grid.head = 0;
+    }
+    else if (grid.pixmap && cp->h == grid.height) {
+        return FALSE;
+    }
+    
+    if (grid.pixmap) {
+        g_object_unref(grid.pixmap);
+    }
+    grid.pixmap = gdk_pixmap_new(cp->pixmap, cp->w, cp->h, -1);
+    grid.height = cp->h;
+    if (!grid.gc) {
+        grid.gc = gdk_gc_new(grid.pixmap);
+    }
+    
+    return TRUE;
+}
+
+/* Redraw the whole heat map from the history */
+static void
+grid_draw_all(void)
+{
+    GkrellmChart *cp = grid.chart;
+    
+    gdk_draw_drawable(grid.pixmap, grid.gc, cp->bg_pixmap, 0, 0, 0, 0, cp->w, cp->h);
+    for (gint i = 0; i < grid.width; ++i) {
+        grid_draw_column((grid.head + i) % grid.width, i);
+    }
+}
+
+/* Put the heat map and the text of the selected row on screen */
+static void
+grid_show(void)
+{
+    GkrellmChart *cp = grid.chart;
+    
+    if (!grid.pixmap) {
+        return;
+    }
+    
+    gdk_draw_drawable(cp->pixmap, grid.gc, grid.pixmap, 0, 0, 0, 0, cp->w, cp->h);
+    if (grid.detail) {
+        gkrellm_draw_chart_text(cp, style_id, (gchar *) format_gpu_chart_text(grid.detail));
+    }
+    gkrellm_draw_chart_to_screen(cp);
+}
+
+/* Chart draw function, a full redraw after a theme or size change */
+static void
+refresh_gpu_grid(gpointer data)
+{
+    if (!grid.chart || !grid.chart->pixmap || grid.chart->w <= 0) {
+        return;
+    }
+    
+    grid_sync_size();
+    grid_draw_all();
+    grid_show();
+}
+
+/* Add a column holding the chart column mean of every row.  Unless the
+ * chart changed size, the heat map is scrolled by one pixel and only the
+ * new column is drawn. */
+static void
+grid_push_column(void)
+{
+    GkrellmChart *cp = grid.chart;
+    guchar *values;
+    gboolean redraw;
+    gint column;
+    
+    if (!cp->pixmap || cp->w <= 0) {
+        return;
+    }
+    redraw = grid_sync_size();
+    
+    column = grid.head;
+    values = &grid.history[column * grid.n_rows];
+    for (gint r = 0; r < grid.n_rows; ++r) {
+        values[r] = (guchar) MIN(grid.rows[r]->hot->column_mean, 100);
+    }
+    grid.head = (grid.head + 1) % grid.width;
+    
+    if (redraw) {
+        grid_draw_all();
+    }
+    else {
+        gdk_draw_drawable(grid.pixmap, grid.gc, grid.pixmap, 1, 0, 0, 0, cp->w - 1, cp->h);
+        gdk_draw_drawable(grid.pixmap, grid.gc, cp->bg_pixmap,
+                          cp->w - 1, 0, cp->w - 1, 0, 1, cp->h);
+        grid_draw_column(column, cp->w - 1);
+    }
+    grid_show();
+}
+
+/* Clicking a row shows its chart text on the heat map, clicking it again
+ * hides it */
+static gint
+cb_grid_button_press(GtkWidget *widget, GdkEventButton *ev, gpointer data)
+{
+    gint row;
+    
+    if (ev->type == GDK_BUTTON_PRESS && ev->button == 1) {
+        row = (gint) ev->y / grid_row_height();
+        if (row >= 0 && row < grid.n_rows) {
+            grid.detail = grid.rows[row] == grid.detail ? NULL : grid.rows[row];
+            grid_show();
+        }
+    }
+    else if ((ev->button == 1 && ev->type == GDK_2BUTTON_PRESS) \
+             || (ev->button == 3)) {
+        gkrellm_chartconfig_window_create(grid.chart);
+    }
+    
+    return FALSE;
+}
+
+/* Create the heat map chart with a panel above it whose krell shows the
+ * composite utilization */
+static void
+create_gpu_grid(GtkWidget *vbox)
+{
+    GkrellmStyle *style;
+    GkrellmPanel *p;
+    GkrellmChart *cp;
+    gboolean new_chart = (grid.chart == NULL);
+    gint i, n = 0;
+    
+    if (new_chart) {
+        grid.chart = gkrellm_chart_new0();
+        grid.chart->panel = gkrellm_panel_new0();
+        grid.panel = grid.chart->panel;
+        grid_init_palette();
+    }
+    cp = grid.chart;
+    p = grid.panel;
+    
+    /* One row per enabled GPU, keeping the history if the rows stay */
+    for (i = 0; i < n_slots; ++i) {
+        if (gpus[i].enabled && !gpus[i].is_composite) {
+            n++;
+        }
+    }
+    if (n != grid.n_rows) {
+        g_free(grid.rows);
+        g_free(grid.history);
+        grid.rows = g_new0(GpuPlugin *, MAX(n, 1));
+        grid.history = NULL;
+        grid.width = 0;
+        grid.head = 0;
+        grid.n_rows = n;
+    }
+    for (i = 0, n = 0; i < n_slots; ++i) {
+        if (gpus[i].enabled && !gpus[i].is_composite) {
+            grid.rows[n++] = &gpus[i];
+        }
+    }
+    if (grid.detail && !grid.detail->enabled) {
+        grid.detail = NULL;
+    }
+    grid.top = composite_gpu ? composite_gpu : &gpus[0];
+    
+    /* Krell panel first so it sits on top of the heat map */
+    style = gkrellm_panel_style(style_id);
+    gkrellm_create_krell(p, gkrellm_krell_panel_piximage(style_id), style);
+    grid.krell = KRELL(p);
+    gkrellm_panel_configure(p, show_panel_labels ? grid.top->label : NULL, style);
+    if (p->label) {
+        p->label->position = GKRELLM_LABEL_CENTER;
+    }
+    gkrellm_panel_create(vbox, monitor, p);
+    gkrellm_set_krell_full_scale(grid.krell, 100, 1);
+    grid.drawn_krell = -1;
+    
+    gkrellm_set_chart_height_default(cp, MAX(grid.n_rows * GPU_GRID_ROW_HEIGHT, 20));
+    gkrellm_chart_create(vbox, monitor, cp, &grid.cconfig);
+    gkrellm_set_draw_chart_function(cp, refresh_gpu_grid, NULL);
+    
+    if (new_chart) {
+        g_signal_connect(G_OBJECT(cp->drawing_area), "button_press_event",
+                         G_CALLBACK(cb_grid_button_press), NULL);
+    }
+    
+    refresh_gpu_grid(NULL);
+}
+
+/* Update the heat map once per second and the krell on every tick */
+static void
+update_gpu_grid(void)
+{
+    gulong utilization = grid.top->hot->utilization;
+    
+    if (GK.second_tick) {
+        grid_push_column();
+    }
+    
+    if ((glong) utilization != grid.drawn_krell) {
+        gkrellm_update_krell(grid.panel, grid.krell, utilization);
+        gkrellm_draw_panel_layers(grid.panel);
+        grid.drawn_krell = utilization;
+    }
+}
+
+/* The panel shown while the GPUs are being looked for */
+static void
+create_init_panel(GtkWidget *vbox)
+{
+    GkrellmStyle *style;
+    
+    if (!init_thread) {
+        return;
+    }
+    if (!init_panel) {
+        init_panel = gkrellm_panel_new0();
+    }
+    
+    style = gkrellm_panel_style(style_id);
+    init_decal = gkrellm_create_decal_text(init_panel, _("initializing"),
+                                           gkrellm_panel_alt_textstyle(style_id),
+                                           style, -1, -1, -1);
+    gkrellm_panel_configure(init_panel, show_panel_labels ? "GPU" : NULL, style);
+    if (init_panel->label) {
+        init_panel->label->position = GKRELLM_LABEL_CENTER;
+    }
+    gkrellm_panel_create(vbox, monitor, init_panel);
+    gkrellm_draw_decal_text(init_panel, init_decal, _("initializing"), 0);
+    gkrellm_draw_panel_layers(init_panel);
+}
+
+/* Create the plugin UI */
+static void
+create_gpu_plugin(GtkWidget *vbox, gint first_create)
+{
+    gint i;
+    
+    if (first_create) {
+        gpu_vbox = vbox;
+    }
+    if (!gpus_ready) {
+        create_init_panel(vbox);
+        return;
+    }
+    
+    /* Only one of the two displays is shown, the other stays hidden */
+    if (grid_display) {
+        for (i = 0; i < n_slots; ++i) {
+            if (gpus[i].chart) {
+                gkrellm_chart_hide(gpus[i].chart, TRUE);
             }
-            else if ((ev->button == 1 && ev->type == GDK_2BUTTON_PRESS) \
-                     || (ev->button == 3)) {
-                gkrellm_chartconfig_window_create(gpu->chart);
-                break;
+            if (gpus[i].link_chart) {
+                gkrellm_chart_hide(gpus[i].link_chart, FALSE);
             }
         }
+        create_gpu_grid(vbox);
+        gkrellm_chart_show(grid.chart, TRUE);
+    }
+    else {
+        if (grid.chart) {
+            gkrellm_chart_hide(grid.chart, TRUE);
+        }
+        create_gpu_charts(vbox);
     }
-    
-    return FALSE;
 }
 
-/* Create the plugin UI */
+/* Create a chart and panel per enabled GPU */
 static void
-create_gpu_plugin(GtkWidget *vbox, gint first_create)
+create_gpu_charts(GtkWidget *vbox)
 {
-    GList *list;
+    gint i;
     GpuPlugin *gpu;
     GkrellmStyle *style;
     GkrellmPanel *p;
     GkrellmChart *cp;
+    gboolean new_chart;
     
     /* Create panel and chart for each GPU */
-    for (list = gpu_list; list; list = list->next) {
-        gpu = (GpuPlugin *)list->data;
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
         
         /* Skip creating UI for disabled GPUs */
         if (!gpu->enabled) {
@@ -503,7 +2458,8 @@ create_gpu_plugin(GtkWidget *vbox, gint first_create)
         }
         
         /* Create chart */
-        if( first_create ) {
+        new_chart = (gpu->chart == NULL);
+        if (new_chart) {
             gpu->vbox = gtk_vbox_new(FALSE, 0);
             gtk_container_add(GTK_CONTAINER(gpu_vbox), gpu->vbox);
             gtk_widget_show(gpu->vbox); 
@@ -524,12 +2480,37 @@ create_gpu_plugin(GtkWidget *vbox, gint first_create)
         gkrellm_set_draw_chart_function(cp, refresh_gpu_chart, gpu);
         gpu->util_cd = gkrellm_add_default_chartdata(cp, _("utilization"));
         gpu->mem_cd = gkrellm_add_default_chartdata(cp, _("memory"));
+        gpu->peak_cd = gkrellm_add_default_chartdata(cp, _("peak utilization"));
         
         gkrellm_monotonic_chartdata(gpu->util_cd, FALSE);
         gkrellm_monotonic_chartdata(gpu->mem_cd, FALSE);
+        gkrellm_monotonic_chartdata(gpu->peak_cd, FALSE);
         gkrellm_set_chartdata_draw_style_default(gpu->util_cd, CHARTDATA_LINE);
         gkrellm_set_chartdata_draw_style_default(gpu->mem_cd, CHARTDATA_LINE);
+        gkrellm_set_chartdata_draw_style_default(gpu->peak_cd, CHARTDATA_LINE);
         gkrellm_set_chartdata_flags(gpu->mem_cd, CHARTDATA_ALLOW_HIDE);
+        gkrellm_set_chartdata_flags(gpu->peak_cd, CHARTDATA_ALLOW_HIDE);
+        
+        /* The composite also charts the spread over the GPUs */
+        if (gpu->is_composite) {
+            gpu->min_cd = gkrellm_add_default_chartdata(cp, _("least busy GPU"));
+            gpu->max_cd = gkrellm_add_default_chartdata(cp, _("busiest GPU"));
+            gpu->p90_cd = gkrellm_add_default_chartdata(cp, _("90th percentile"));
+            gpu->busy_cd = gkrellm_add_default_chartdata(cp, _("busy GPUs"));
+            
+            gkrellm_monotonic_chartdata(gpu->min_cd, FALSE);
+            gkrellm_monotonic_chartdata(gpu->max_cd, FALSE);
+            gkrellm_monotonic_chartdata(gpu->p90_cd, FALSE);
+            gkrellm_monotonic_chartdata(gpu->busy_cd, FALSE);
+            gkrellm_set_chartdata_draw_style_default(gpu->min_cd, CHARTDATA_LINE);
+            gkrellm_set_chartdata_draw_style_default(gpu->max_cd, CHARTDATA_LINE);
+            gkrellm_set_chartdata_draw_style_default(gpu->p90_cd, CHARTDATA_LINE);
+            gkrellm_set_chartdata_draw_style_default(gpu->busy_cd, CHARTDATA_LINE);
+            gkrellm_set_chartdata_flags(gpu->min_cd, CHARTDATA_ALLOW_HIDE);
+            gkrellm_set_chartdata_flags(gpu->max_cd, CHARTDATA_ALLOW_HIDE);
+            gkrellm_set_chartdata_flags(gpu->p90_cd, CHARTDATA_ALLOW_HIDE);
+            gkrellm_set_chartdata_flags(gpu->busy_cd, CHARTDATA_ALLOW_HIDE);
+        }
          
         /* Disable auto grid resolution */
         gkrellm_chartconfig_grid_resolution_adjustment(gpu->cconfig,
@@ -562,9 +2543,17 @@ create_gpu_plugin(GtkWidget *vbox, gint first_create)
         
         /* Setup krell */
         gkrellm_set_krell_full_scale(gpu->krell, 100, 1);
+        gpu->hot->drawn_krell = -1;
+        gpu->hot->drawn_alerts = 0;
+        gpu->hot->panel_dirty = TRUE;
+        gpu->tooltip_dirty = TRUE;
+        
+        /* Map the drawing areas back to this GPU for the click handler */
+        g_hash_table_replace(gpu_by_widget, cp->drawing_area, gpu);
+        g_hash_table_replace(gpu_by_widget, p->drawing_area, gpu);
         
         /* Connect signals */
-        if (first_create) {
+        if (new_chart) {
             g_signal_connect(G_OBJECT(cp->drawing_area), "button_press_event",
                              G_CALLBACK(gpu_chart_expose_event), gpu);
             g_signal_connect(G_OBJECT(p->drawing_area), "button_press_event",
@@ -577,27 +2566,144 @@ create_gpu_plugin(GtkWidget *vbox, gint first_create)
         /* Setup launcher */
         gkrellm_setup_launcher(p, &gpu->launch, CHART_PANEL_TYPE, 4);
         
-        /* Allocate chart data */
+        /* Allocate chart data and fill it from the history */
         gkrellm_alloc_chartdata(cp);
+        backfill_gpu_chart(gpu);
+        gkrellm_chart_show(cp, TRUE);
+        
+        create_link_chart(vbox, gpu);
+    }
+}
+
+/* Open the chart config of the interconnect chart */
+static gint
+cb_link_chart_press(GtkWidget *widget, GdkEventButton *ev, gpointer data)
+{
+    GpuPlugin *gpu = (GpuPlugin *) data;
+    
+    if (ev->button == 1 && ev->type == GDK_BUTTON_PRESS) {
+        gpu->extra_info = !gpu->extra_info;
+        gkrellm_config_modified();
+        refresh_link_chart(gpu);
+    }
+    else if ((ev->button == 1 && ev->type == GDK_2BUTTON_PRESS) || ev->button == 3) {
+        gkrellm_chartconfig_window_create(gpu->link_chart);
+    }
+    
+    return FALSE;
+}
+
+/* Create the chart of PCIe and NVLink traffic below the panel of a GPU,
+ * or hide it when interconnect charts are off.  MIG devices share the
+ * links of their GPU and the composite only sums PCIe. */
+static void
+create_link_chart(GtkWidget *vbox, GpuPlugin *gpu)
+{
+    GkrellmChart *cp;
+    GkrellmChartdata *cd;
+    gchar buf[32];
+    gboolean new_chart;
+    
+    if (!g_atomic_int_get(&gpu_show_interconnect) || gpu->parent) {
+        if (gpu->link_chart) {
+            gkrellm_chart_hide(gpu->link_chart, FALSE);
+        }
+        return;
+    }
+    
+    new_chart = (gpu->link_chart == NULL);
+    if (new_chart) {
+        gpu->link_chart = gkrellm_chart_new0();
+    }
+    cp = gpu->link_chart;
+    
+    gkrellm_chart_create(vbox, monitor, cp, &gpu->link_cconfig);
+    gkrellm_set_draw_chart_function(cp, refresh_link_chart, gpu);
+    for (gint i = 0; i < 2 + gpu->dev->n_nvlinks; ++i) {
+        if (i < 2) {
+            g_strlcpy(buf, i == 0 ? _("PCIe TX") : _("PCIe RX"), sizeof(buf));
+        }
+        else {
+            snprintf(buf, sizeof(buf), _("NVLink %d"), i - 2);
+        }
+        cd = gkrellm_add_default_chartdata(cp, buf);
+        gkrellm_monotonic_chartdata(cd, FALSE);
+        gkrellm_set_chartdata_draw_style_default(cd, CHARTDATA_LINE);
+        gkrellm_set_chartdata_flags(cd, CHARTDATA_ALLOW_HIDE);
     }
+    
+    /* Traffic spans several orders of magnitude, so let the grid scale */
+    gkrellm_chartconfig_grid_resolution_adjustment(gpu->link_cconfig, TRUE,
+                                                   0, (gfloat) 10, (gfloat) 100000000,
+                                                   0, 0, 0, 0);
+    gkrellm_chartconfig_grid_resolution_label(gpu->link_cconfig, _("KiB per second"));
+    
+    if (new_chart) {
+        g_signal_connect(G_OBJECT(cp->drawing_area), "button_press_event",
+                         G_CALLBACK(cb_link_chart_press), gpu);
+    }
+    
+    gkrellm_alloc_chartdata(cp);
+    gkrellm_chart_show(cp, FALSE);
+}
+
+/* Store a column of interconnect traffic: PCIe TX and RX, then each
+ * NVLink with both directions added up */
+static void
+store_link_chart(GpuPlugin *gpu)
+{
+    gulong data[2 + GPU_MAX_NVLINKS];
+    
+    data[0] = gpu->link_rates[0];
+    data[1] = gpu->link_rates[1];
+    for (gint l = 0; l < gpu->dev->n_nvlinks; ++l) {
+        data[2 + l] = gpu->link_rates[2 + 2 * l] + gpu->link_rates[3 + 2 * l];
+    }
+    gkrellm_store_chartdatav(gpu->link_chart, data);
+    refresh_link_chart(gpu);
 }
 
 /* Update plugin data and UI */
 static void
 update_gpu_plugin(void)
 {
-    GList *list;
+    gint i;
     GpuPlugin *gpu;
     GkrellmPanel *p;
     GkrellmChart *cp;
     GkrellmKrell *krell;
     
-    /* Read GPU data */
-    read_gpu_data();
+    if (!gpus_ready) {
+        finish_gpu_init();
+        return;
+    }
+    
+    /* Pick up the latest samples published by the sampler thread */
+    fetch_gpu_samples(GK.second_tick);
+    if (GK.second_tick) {
+        gpu_sampler_poll();
+        if (gpu_sampler_role() == GPU_ROLE_REMOTE) {
+            log_remote_bandwidth();
+        }
+        run_alert_commands();
+        record_gpu_stats();
+        count_throttle_time();
+        record_gpu_history(g_get_real_time() / G_USEC_PER_SEC);
+        if (exporter) {
+            publish_metrics();
+        }
+    }
+    
+    if (grid_display) {
+        if (grid.chart) {
+            update_gpu_grid();
+        }
+        return;
+    }
     
     /* For each GPU, update UI */
-    for (list = gpu_list; list; list = list->next) {
-        gpu = (GpuPlugin *)list->data;
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
         
         if (!gpu->enabled) {
             continue;
@@ -611,67 +2717,58 @@ update_gpu_plugin(void)
         
         if (GK.second_tick) {
             /* Store chart data */
-            if (cp && gpu->util_cd && gpu->mem_cd) {
-                gkrellm_store_chartdata(cp, 0, gpu->utilization, (gint) round((gfloat) 100 * gpu->used_memory / gpu->total_memory));
+            if (cp && gpu->util_cd && gpu->mem_cd && gpu->peak_cd
+                && chart_tier(gpu) != GPU_HISTORY_SECONDS) {
+                store_history_period(gpu, g_get_real_time() / G_USEC_PER_SEC);
+                refresh_gpu_chart(gpu);
+            }
+            else if (cp && gpu->util_cd && gpu->mem_cd && gpu->peak_cd) {
+                GpuReduction *r = &gpu->hot->reduction;
+                gulong mem = (gulong) CLAMP(fmt_value_memory_percent(gpu), 0, 100);
+                
+                if (gpu->is_composite) {
+                    gkrellm_store_chartdata(cp, 0, gpu->hot->column_mean, mem,
+                                            gpu->hot->column_peak,
+                                            r->value[GPU_REDUCE_MIN],
+                                            r->value[GPU_REDUCE_MAX],
+                                            r->value[GPU_REDUCE_P90],
+                                            (gulong) (r->n > 0 ? 100 * r->busy / r->n : 0));
+                }
+                else {
+                    gkrellm_store_chartdata(cp, 0, gpu->hot->column_mean, mem,
+                                            gpu->hot->column_peak);
+                }
+                push_chart_marks(gpu, gpu->column_events);
                 
                 refresh_gpu_chart(gpu);
             }
-            
-            /* Check alerts */
-            if (gpu->alert && !gpu->is_composite) {
-                gkrellm_check_alert(gpu->alert, (gfloat)gpu->utilization);
+            if (gpu->link_chart && g_atomic_int_get(&gpu_show_interconnect) && !gpu->parent) {
+                store_link_chart(gpu);
             }
         }
         
-        if (GK.two_second_tick && gpu->show_temperature) {
+        if ((GK.two_second_tick || gpu->health != gpu->drawn_health
+             || gpu->alerts != gpu->hot->drawn_alerts)
+            && gpu->show_temperature) {
             draw_sensor_decals(gpu);
         }
+        if (gpu->tooltip_dirty) {
+            update_process_tooltip(gpu);
+        }
         
         /* Update krell */
         krell = gpu->krell;
-        gkrellm_update_krell(p, krell, gpu->utilization);
-        gkrellm_panel_label_on_top_of_decals(p, gkrellm_alert_decal_visible(gpu->alert));
-        gkrellm_draw_panel_layers(p);
-    }
-}
-
-/* Format callback for alert processing */
-static void 
-cb_alert_config(GkrellmAlert *alert, gpointer data)
-{
-    GList *list;
-    GpuPlugin *gpu;
-    
-    /* Duplicate the main alert for each GPU */
-    for (list = gpu_list; list; list = list->next) {
-        gpu = (GpuPlugin *)list->data;
-        gkrellm_alert_dup(&gpu->alert, gpu_alert);
-        gkrellm_alert_trigger_connect(gpu->alert, cb_alert_trigger, gpu);
-        gkrellm_alert_command_process_connect(gpu->alert, 
-            (void (*)(GkrellmAlert *, gchar *, gchar *, gint, void *))cb_command_process, gpu);
-    }
-}
-
-static void
-cb_set_alert(GtkWidget *button, gpointer data)
-{
-    if (!gpu_alert) {
-        create_alert();
+        if ((glong) gpu->hot->utilization != gpu->hot->drawn_krell) {
+            gkrellm_update_krell(p, krell, gpu->hot->utilization);
+            gpu->hot->drawn_krell = gpu->hot->utilization;
+            gpu->hot->panel_dirty = TRUE;
+        }
+        
+        if (gpu->hot->panel_dirty) {
+            gkrellm_draw_panel_layers(p);
+            gpu->hot->panel_dirty = FALSE;
+        }
     }
-    gkrellm_alert_config_window(&gpu_alert);
-}
-
-/* Create an alert for GPU utilization */
-static void
-create_alert(void)
-{
-    gpu_alert = gkrellm_alert_create(NULL, _("GPU"),
-                                     _("Temperature"),
-                                     TRUE, FALSE, TRUE,
-                                     100, 10, 1, 10, 0);
-    gkrellm_alert_delay_config(gpu_alert, 1, 60 * 60, 2);
-    gkrellm_alert_config_connect(gpu_alert, cb_alert_config, NULL);
-    /* This alert is a master to be dupped and is itself never checked */
 }
 
 /* Info text for config dialog */
@@ -684,14 +2781,68 @@ static gchar *gpu_info_text[] = {
     N_("\t$m    memory percent usage\n"),
     N_("\t$U    memory used size\n"),
     N_("\t$T    total memory size\n"),
+    N_("\t$W    power draw in watts\n"),
+    N_("\t$t    temperature\n"),
+    N_("\t$H    the hostname\n"),
+    "\n",
+    N_("For the composite GPU, $u is the selected reduction of the enabled\n"),
+    N_("GPUs and these give every reduction:\n"),
+    N_("\t$a    mean utilization\n"),
+    N_("\t$w    mean utilization weighted by used memory\n"),
+    N_("\t$n    utilization of the least busy GPU\n"),
+    N_("\t$x    utilization of the busiest GPU\n"),
+    N_("\t$p    90th percentile of the utilization\n"),
+    N_("\t$b    number of busy GPUs\n"),
+    N_("\t$g    number of GPUs in the composite\n"),
+    "\n",
+    N_("Processes, also listed in the tooltip of the GPU panel:\n"),
+    N_("\t$P    name of the process using the most GPU memory\n"),
+    N_("\t$M    GPU memory used by that process\n"),
+    N_("\t$S    SM utilization of that process\n"),
+    N_("\t$c    number of processes on the GPU\n"),
     "\n",
-    N_("Substitution variables may be used in alert commands.\n")
+    N_("With PCIe and NVLink charts on:\n"),
+    N_("\t$X    PCIe transmit rate\n"),
+    N_("\t$R    PCIe receive rate\n"),
+    N_("\t$V    NVLink rate over all links, both directions\n"),
+    "\n",
+    N_("With GPU events on:\n"),
+    N_("\t$E    number of critical XID errors\n"),
+    N_("\t$Z    the last XID error\n"),
+    "\n",
+    N_("Clock throttling:\n"),
+    N_("\t$K    what holds the clocks down now: power, thermal, hw (slowdown),\n"),
+    N_("\t      sync (boost), clocks (set by the user) or idle\n"),
+    N_("\t$k    time held down by power, thermal, hw or sync since start\n"),
+    "\n",
+    N_("Rolling statistics over the last 1, 5 or 15 minutes, written\n"),
+    N_("$[SERIES:KIND:MINUTES] as in $[u:mean:15]:\n"),
+    N_("\tSERIES  u utilization, m memory percent usage, t temperature\n"),
+    N_("\tKIND    mean, sd (standard deviation), p95 (95th percentile), max\n"),
+    "\n",
+    N_("With alerts on:\n"),
+    N_("\t$A    the alerts raised, comma separated\n"),
+    "\n",
+    N_("Substitution variables may be used in alert commands, where each\n"),
+    N_("value is quoted for the shell.\n"),
+    "\n",
+    N_("<h>Alerts\n"),
+    N_("An alert is raised once its value has been at or above the raise\n"),
+    N_("limit for the dwell time, and cleared once it has been below the\n"),
+    N_("clear limit as long.  The throttling alert is raised while power or\n"),
+    N_("heat hold the clocks down.  A raised alert marks the chart in orange\n"),
+    N_("and puts a ! after the temperature.\n"),
+    N_("Its command runs at most once per command interval, with the\n"),
+    N_("variables of the first GPU that raised it and the names of all of\n"),
+    N_("them in GKRELLM_GPU_ALERTED.  GKRELLM_GPU_ALERT, GKRELLM_GPU_NAME,\n"),
+    N_("GKRELLM_GPU_LABEL and GKRELLM_GPU_PROCESS hold the alert, the GPU\n"),
+    N_("and its first process.  A command too long once filled in is not run.\n")
 };
 
 static void
 cb_text_format(GtkWidget *widget, gpointer data)
 {
-    GList *list;
+    gint i;
     GpuPlugin *gpu;
     gchar *s;
     GtkWidget *entry;
@@ -699,9 +2850,130 @@ cb_text_format(GtkWidget *widget, gpointer data)
     entry = gtk_bin_get_child(GTK_BIN(text_format_combo_box));
     s = gkrellm_gtk_entry_get_text(&entry);
     gkrellm_locale_dup_string(&text_format, s, &text_format_locale);
+    compile_text_format();
+    
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
+        refresh_gpu_chart(gpu);
+    }
+}
+
+static void
+cb_sample_interval(GtkWidget *widget, gpointer data)
+{
+    GpuMetricSchedule *metric = (GpuMetricSchedule *)data;
+    
+    g_atomic_int_set(&metric->interval_ms,
+                     gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(widget)));
+    gkrellm_config_modified();
+}
+
+/* Switching displays rebuilds the monitors so the new one is laid out */
+static void
+cb_grid_display(GtkWidget *button, gpointer data)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    
+    if (active != grid_display) {
+        grid_display = active;
+        gkrellm_config_modified();
+        gkrellm_build();
+    }
+}
+
+static void
+cb_alert_enabled(GtkWidget *button, gpointer data)
+{
+    GpuAlertRule *rule = (GpuAlertRule *)data;
+    
+    g_atomic_int_set(&rule->enabled,
+                     gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button)));
+    gkrellm_config_modified();
+}
+
+/* Set one of the limits or the dwell time of an alert rule */
+static void
+cb_alert_setting(GtkWidget *widget, gpointer data)
+{
+    g_atomic_int_set((gint *) data,
+                     gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(widget)));
+    gkrellm_config_modified();
+}
+
+static void
+cb_alert_interval(GtkWidget *widget, gpointer data)
+{
+    alert_interval = gtk_spin_button_get_value_as_int(GTK_SPIN_BUTTON(widget));
+    gkrellm_config_modified();
+}
+
+static void
+cb_interconnect(GtkWidget *button, gpointer data)
+{
+    gboolean active = gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button));
+    
+    if (active != g_atomic_int_get(&gpu_show_interconnect)) {
+        g_atomic_int_set(&gpu_show_interconnect, active);
+        gkrellm_config_modified();
+        gkrellm_build();
+    }
+}
+
+static void
+cb_idle_backoff(GtkWidget *button, gpointer data)
+{
+    g_atomic_int_set(&gpu_idle_backoff,
+                     gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button)));
+    gkrellm_config_modified();
+}
+
+static void
+cb_use_events(GtkWidget *button, gpointer data)
+{
+    g_atomic_int_set(&gpu_use_events,
+                     gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button)));
+    gkrellm_config_modified();
+}
+
+static void
+cb_buffered_utilization(GtkWidget *button, gpointer data)
+{
+    g_atomic_int_set(&gpu_buffered_utilization,
+                     gtk_toggle_button_get_active(GTK_TOGGLE_BUTTON(button)));
+    gkrellm_config_modified();
+}
+
+static void
+cb_composite_reduction(GtkWidget *widget, gpointer data)
+{
+    gint active = gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
+    
+    if (active >= 0 && active < N_GPU_REDUCTIONS) {
+        g_atomic_int_set(&gpu_composite_reduction, active);
+        gkrellm_config_modified();
+    }
+}
+
+/* Changing the time per column redraws the charts from the history */
+static void
+cb_chart_history(GtkWidget *widget, gpointer data)
+{
+    gint active = gtk_combo_box_get_active(GTK_COMBO_BOX(widget));
+    GpuPlugin *gpu;
+    
+    if (active < 0 || active >= GPU_HISTORY_TIERS || active == history_tier) {
+        return;
+    }
+    history_tier = active;
+    gkrellm_config_modified();
     
-    for (list = gpu_list; list; list = list->next) {
-        gpu = (GpuPlugin *)list->data;
+    for (gint i = 0; i < n_slots && !grid_display; ++i) {
+        gpu = &gpus[i];
+        if (!gpu->enabled || !gpu->chart) {
+            continue;
+        }
+        gkrellm_reset_chart(gpu->chart);
+        backfill_gpu_chart(gpu);
         refresh_gpu_chart(gpu);
     }
 }
@@ -715,11 +2987,19 @@ create_gpu_config(GtkWidget *vbox)
     GtkWidget *hbox, *cvbox, *vbox1, *vbox2;
     GtkWidget *text;
     GtkWidget *table;
-    GList *list;
+    GtkWidget *spin;
+    GtkWidget *combo;
     GpuPlugin *gpu;
     gchar buf[128];
     gint i;
     
+    if (!gpus_ready) {
+        gtk_box_pack_start(GTK_BOX(vbox),
+                           gtk_label_new(_("Still looking for GPUs, open this page again in a moment.")),
+                           FALSE, FALSE, 0);
+        return;
+    }
+    
     tabs = gtk_notebook_new();
     gtk_notebook_set_tab_pos(GTK_NOTEBOOK(tabs), GTK_POS_TOP);
     gtk_box_pack_start(GTK_BOX(vbox), tabs, TRUE, TRUE, 0);
@@ -731,6 +3011,26 @@ create_gpu_config(GtkWidget *vbox)
     gkrellm_gtk_check_button_connected(cvbox, NULL, show_panel_labels,
             FALSE, FALSE, 0, NULL, NULL,
             _("Show labels in panels (no labels reduces vertical space)"));
+    gkrellm_gtk_check_button_connected(cvbox, NULL, grid_display,
+            FALSE, FALSE, 0, cb_grid_display, NULL,
+            _("Show all GPUs as rows of one heat map chart (click a row for details)"));
+    gkrellm_gtk_check_button_connected(cvbox, NULL, gpu_show_interconnect,
+            FALSE, FALSE, 0, cb_interconnect, NULL,
+            _("Chart PCIe and NVLink traffic below each GPU panel"));
+    
+    /* Chart time scale */
+    hbox = gtk_hbox_new(FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(cvbox), hbox, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(hbox), gtk_label_new(_("Utilization charts show ")),
+                       FALSE, FALSE, 0);
+    combo = gtk_combo_box_text_new();
+    gtk_box_pack_start(GTK_BOX(hbox), combo, FALSE, FALSE, 0);
+    for (i = 0; i < GPU_HISTORY_TIERS; ++i) {
+        gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo), _(history_tier_labels[i]));
+    }
+    gtk_combo_box_set_active(GTK_COMBO_BOX(combo), history_tier);
+    g_signal_connect(G_OBJECT(combo), "changed",
+                     G_CALLBACK(cb_chart_history), NULL);
             
     vbox1 = gkrellm_gtk_category_vbox(cvbox,
                 _("GPU Charts Select"),
@@ -740,8 +3040,8 @@ create_gpu_config(GtkWidget *vbox)
                     GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
                     
     /* Create checkboxes for each GPU */
-    for (i = 0, list = gpu_list; list; list = list->next, ++i) {
-        gpu = (GpuPlugin *)list->data;
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
         
         if (i == 0 && n_gpus > 1) {
             snprintf(buf, sizeof(buf), _("Composite GPU."));
@@ -780,17 +3080,65 @@ create_gpu_config(GtkWidget *vbox)
     g_signal_connect(G_OBJECT(text_format_combo_box), "changed",
                      G_CALLBACK(cb_text_format), NULL);
     
+    /* Sampling intervals */
+    vbox1 = gkrellm_gtk_category_vbox(cvbox,
+                                      _("Sampling Intervals (milliseconds)"),
+                                      4, 0, TRUE);
+    for (i = 0; i < N_GPU_METRICS; ++i) {
+        gkrellm_gtk_spin_button(vbox1, &spin,
+                                (gfloat) gpu_metric_schedule[i].interval_ms,
+                                100.0, 60000.0, 50.0, 1000.0, 0, 70,
+                                NULL, NULL, FALSE, _(gpu_metric_schedule[i].label));
+        g_signal_connect(G_OBJECT(spin), "value_changed",
+                         G_CALLBACK(cb_sample_interval), &gpu_metric_schedule[i]);
+    }
+    gkrellm_gtk_check_button_connected(vbox1, NULL, gpu_idle_backoff,
+            FALSE, FALSE, 0, cb_idle_backoff, NULL,
+            _("Sample less often while all GPUs are idle"));
+    gkrellm_gtk_check_button_connected(vbox1, NULL, gpu_buffered_utilization,
+            FALSE, FALSE, 0, cb_buffered_utilization, NULL,
+            _("Read utilization from the driver sample buffer (catches short bursts)"));
+    gkrellm_gtk_check_button_connected(vbox1, NULL, gpu_use_events,
+            FALSE, FALSE, 0, cb_use_events, NULL,
+            _("Sample at once on GPU events (XID errors and power state changes)"));
+    
+    /* Exporter */
+    vbox1 = gkrellm_gtk_category_vbox(cvbox,
+                                      _("Metrics Exporter"),
+                                      4, 0, TRUE);
+    exporter_entry = gtk_entry_new();
+    gtk_entry_set_text(GTK_ENTRY(exporter_entry), exporter_address ? exporter_address : "");
+    gtk_box_pack_start(GTK_BOX(vbox1), exporter_entry, FALSE, FALSE, 0);
+    gtk_box_pack_start(GTK_BOX(vbox1),
+                       gtk_label_new(_("OpenMetrics over HTTP at unix:PATH or a loopback [HOST:]PORT, empty for off")),
+                       FALSE, FALSE, 0);
+    
+    /* Composite reduction */
+    if (composite_gpu) {
+        vbox1 = gkrellm_gtk_category_vbox(cvbox,
+                                          _("Composite GPU Utilization"),
+                                          4, 0, TRUE);
+        combo = gtk_combo_box_text_new();
+        gtk_box_pack_start(GTK_BOX(vbox1), combo, FALSE, FALSE, 0);
+        for (i = 0; i < N_GPU_REDUCTIONS; ++i) {
+            gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo), _(reduction_labels[i]));
+        }
+        gtk_combo_box_set_active(GTK_COMBO_BOX(combo), gpu_composite_reduction);
+        g_signal_connect(G_OBJECT(combo), "changed",
+                         G_CALLBACK(cb_composite_reduction), NULL);
+    }
+    
     /* Launch commands */
     vbox1 = gkrellm_gtk_category_vbox(cvbox,
                                       _("Launch Commands"),
                                       4, 0, TRUE);
     vbox1 = gkrellm_gtk_scrolled_vbox(vbox1, NULL,
                                       GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
-    table = gkrellm_gtk_launcher_table_new(vbox1, g_list_length(gpu_list));
+    table = gkrellm_gtk_launcher_table_new(vbox1, n_slots);
     
     /* Setup launchers for each GPU */
-    for (i = 0, list = gpu_list; list; list = list->next, ++i) {
-        gpu = (GpuPlugin *)list->data;
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
         snprintf(buf, sizeof(buf), _("%s"), gpu->name);
         
         /* Add entries for launch command and tooltip */
@@ -809,11 +3157,48 @@ create_gpu_config(GtkWidget *vbox)
         }
     }
     
-    /* Alert button */
-    hbox = gtk_hbox_new(FALSE, 0);
-    gtk_box_pack_end(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
-    gkrellm_gtk_alert_button(hbox, NULL, FALSE, FALSE, 4, TRUE,
-                             cb_set_alert, NULL);
+    /* Alerts tab */
+    cvbox = gkrellm_gtk_framed_notebook_page(tabs, _("Alerts"));
+    cvbox = gkrellm_gtk_scrolled_vbox(cvbox, NULL,
+                                      GTK_POLICY_AUTOMATIC, GTK_POLICY_AUTOMATIC);
+    gkrellm_gtk_spin_button(cvbox, &spin, (gfloat) alert_interval,
+                            0.0, 86400.0, 10.0, 60.0, 0, 70,
+                            cb_alert_interval, NULL, FALSE,
+                            _("Seconds before a command runs again"));
+    for (i = 0; i < N_GPU_ALERTS; ++i) {
+        GpuAlertRule *rule = &gpu_alert_rules[i];
+        
+        vbox1 = gkrellm_gtk_category_vbox(cvbox, (gchar *) _(rule->label), 4, 0, TRUE);
+        gkrellm_gtk_check_button_connected(vbox1, NULL, rule->enabled,
+                FALSE, FALSE, 0, cb_alert_enabled, rule, _("Enabled"));
+        if (rule->unit) {
+            snprintf(buf, sizeof(buf), _("Raise at (%s)"), rule->unit);
+            gkrellm_gtk_spin_button(vbox1, &spin, (gfloat) rule->raise_at,
+                                    0.0, 1000.0, 1.0, 10.0, 0, 70,
+                                    NULL, NULL, FALSE, buf);
+            g_signal_connect(G_OBJECT(spin), "value_changed",
+                             G_CALLBACK(cb_alert_setting), &rule->raise_at);
+            snprintf(buf, sizeof(buf), _("Clear below (%s)"), rule->unit);
+            gkrellm_gtk_spin_button(vbox1, &spin, (gfloat) rule->clear_at,
+                                    0.0, 1000.0, 1.0, 10.0, 0, 70,
+                                    NULL, NULL, FALSE, buf);
+            g_signal_connect(G_OBJECT(spin), "value_changed",
+                             G_CALLBACK(cb_alert_setting), &rule->clear_at);
+        }
+        gkrellm_gtk_spin_button(vbox1, &spin, (gfloat) rule->dwell_s,
+                                0.0, 3600.0, 1.0, 10.0, 0, 70,
+                                NULL, NULL, FALSE, _("Dwell time (seconds)"));
+        g_signal_connect(G_OBJECT(spin), "value_changed",
+                         G_CALLBACK(cb_alert_setting), &rule->dwell_s);
+        
+        hbox = gtk_hbox_new(FALSE, 4);
+        gtk_box_pack_start(GTK_BOX(vbox1), hbox, FALSE, FALSE, 0);
+        gtk_box_pack_start(GTK_BOX(hbox), gtk_label_new(_("Command")), FALSE, FALSE, 0);
+        alert_command_entries[i] = gtk_entry_new();
+        gtk_entry_set_text(GTK_ENTRY(alert_command_entries[i]),
+                           alert_commands[i] ? alert_commands[i] : "");
+        gtk_box_pack_start(GTK_BOX(hbox), alert_command_entries[i], TRUE, TRUE, 0);
+    }
     
     /* Info tab */
     cvbox = gkrellm_gtk_framed_notebook_page(tabs, _("Info"));
@@ -830,10 +3215,45 @@ apply_gpu_config(void)
 {
     // Currently, there's no dynamic configuration to apply
     // This would normally handle changes from the config UI
-    GList *list;
+    gint i;
     GpuPlugin *gpu;
-    for (list = gpu_list; list; list = list->next) {
-        gpu = (GpuPlugin *)list->data;
+    
+    if (!gpus_ready) {
+        return;
+    }
+    if (exporter_entry) {
+        const gchar *address = gtk_entry_get_text(GTK_ENTRY(exporter_entry));
+        
+        if (g_strcmp0(address, exporter_address ? exporter_address : "") != 0) {
+            g_free(exporter_address);
+            exporter_address = g_strstrip(g_strdup(address));
+            start_exporter();
+            gkrellm_config_modified();
+        }
+    }
+    for (i = 0; i < N_GPU_ALERTS; ++i) {
+        const gchar *command;
+        
+        if (!alert_command_entries[i]) {
+            continue;
+        }
+        command = gtk_entry_get_text(GTK_ENTRY(alert_command_entries[i]));
+        if (g_strcmp0(command, alert_commands[i] ? alert_commands[i] : "") != 0) {
+            g_free(alert_commands[i]);
+            alert_commands[i] = g_strstrip(g_strdup(command));
+            gkrellm_config_modified();
+        }
+    }
+    if (grid_display) {
+        gkrellm_config_modified();
+        refresh_gpu_grid(NULL);
+        return;
+    }
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &gpus[i];
+        if (!gpu->chart) {
+            continue;
+        }
         
         gkrellm_config_modified();
         refresh_gpu_chart(gpu);
@@ -844,14 +3264,48 @@ apply_gpu_config(void)
 static void
 save_gpu_config(FILE *f)
 {
-    GList *list;
+    gint i;
     GpuPlugin *gpu;
     
     fprintf(f, "%s show_panel_labels %d\n", CONFIG_NAME, show_panel_labels);
     fprintf(f, "%s text_format %s\n", CONFIG_NAME, text_format);
+    fprintf(f, "%s grid_display %d\n", CONFIG_NAME, grid_display);
+    fprintf(f, "%s interconnect %d\n", CONFIG_NAME, gpu_show_interconnect);
+    fprintf(f, "%s events %d\n", CONFIG_NAME, gpu_use_events);
+    fprintf(f, "%s chart_history %s\n", CONFIG_NAME,
+            history_tier_names[history_tier]);
+    if (exporter_address && *exporter_address) {
+        fprintf(f, "%s exporter %s\n", CONFIG_NAME, exporter_address);
+    }
+    fprintf(f, "%s composite_reduction %s\n", CONFIG_NAME,
+            reduction_names[gpu_composite_reduction]);
+    fprintf(f, "%s idle_backoff %d\n", CONFIG_NAME, gpu_idle_backoff);
+    fprintf(f, "%s buffered_utilization %d\n", CONFIG_NAME, gpu_buffered_utilization);
+    for (gint i = 0; i < N_GPU_METRICS; ++i) {
+        fprintf(f, "%s interval %s %d\n", CONFIG_NAME,
+                gpu_metric_schedule[i].name, gpu_metric_schedule[i].interval_ms);
+    }
+    fprintf(f, "%s alert_interval %d\n", CONFIG_NAME, alert_interval);
+    for (gint i = 0; i < N_GPU_ALERTS; ++i) {
+        GpuAlertRule *rule = &gpu_alert_rules[i];
+        
+        fprintf(f, "%s alert %s %d %d %d %d\n", CONFIG_NAME, rule->name,
+                rule->enabled, rule->raise_at, rule->clear_at, rule->dwell_s);
+        if (alert_commands[i] && *alert_commands[i]) {
+            fprintf(f, "%s alert_command %s %s\n", CONFIG_NAME,
+                    rule->name, alert_commands[i]);
+        }
+    }
+    
+    /* Per-GPU settings not applied yet are saved as they were read */
+    if (!gpus_ready) {
+        for (guint j = 0; j < pending_config->len; ++j) {
+            fprintf(f, "%s %s\n", CONFIG_NAME, (gchar *) g_ptr_array_index(pending_config, j));
+        }
+    }
     
-    for (list = gpu_list; list; list = list->next) {
-        gpu = (GpuPlugin *)list->data;
+    for (i = 0; gpus_ready && i < n_slots; ++i) {
+        gpu = &gpus[i];
         fprintf(f, "%s enabled %s %d\n", CONFIG_NAME,
                     gpu->name, gpu->enabled);
                     
@@ -868,71 +3322,141 @@ save_gpu_config(FILE *f)
         fprintf(f, "%s extra_info %s %d\n", CONFIG_NAME,
                 gpu->name, gpu->extra_info);
     }
-    
-    /* Save alert config */
-    if (gpu_alert) {
-        gkrellm_save_alertconfig(f, gpu_alert, CONFIG_NAME, NULL);
-    }
 }
 
 /* Load plugin config from file */
 static void
 load_gpu_config(gchar *arg)
 {
-    GList *list;
     GpuPlugin *gpu;
     gchar config[32], item[512], gpu_name[32], command[512];
     gint n;
     
     n = sscanf(arg, "%31s %[^\n]", config, item);
+    
+    /* Per-GPU settings wait until the GPUs are found */
+    if (n == 2 && !gpus_ready
+        && (!strcmp(config, "enabled") || !strcmp(config, "extra_info")
+            || !strcmp(config, "launch") || !strcmp(config, "tooltip_comment"))) {
+        g_ptr_array_add(pending_config, g_strchomp(g_strdup(arg)));
+        return;
+    }
+    
     if (n == 2) {
         if (!strcmp(config, "show_panel_labels")) {
             sscanf(item, "%d\n", &show_panel_labels);
         }
         else if (!strcmp(config, "text_format")) {
             gkrellm_locale_dup_string(&text_format, item, &text_format_locale);
+            compile_text_format();
+        }
+        else if (!strcmp(config, "grid_display")) {
+            sscanf(item, "%d\n", &grid_display);
+        }
+        else if (!strcmp(config, "interconnect")) {
+            sscanf(item, "%d\n", &gpu_show_interconnect);
+        }
+        else if (!strcmp(config, "events")) {
+            sscanf(item, "%d\n", &gpu_use_events);
+        }
+        else if (!strcmp(config, "exporter")) {
+            g_free(exporter_address);
+            exporter_address = g_strdup(item);
+            if (gpus_ready) {
+                start_exporter();
+            }
+        }
+        else if (!strcmp(config, "chart_history")) {
+            for (gint i = 0; i < GPU_HISTORY_TIERS; ++i) {
+                if (!strcmp(item, history_tier_names[i])) {
+                    history_tier = i;
+                }
+            }
+        }
+        else if (!strcmp(config, "composite_reduction")) {
+            for (gint i = 0; i < N_GPU_REDUCTIONS; ++i) {
+                if (!strcmp(item, reduction_names[i])) {
+                    g_atomic_int_set(&gpu_composite_reduction, i);
+                }
+            }
+        }
+        else if (!strcmp(config, "idle_backoff")) {
+            sscanf(item, "%d\n", &n);
+            g_atomic_int_set(&gpu_idle_backoff, n);
+        }
+        else if (!strcmp(config, "buffered_utilization")) {
+            sscanf(item, "%d\n", &n);
+            g_atomic_int_set(&gpu_buffered_utilization, n);
+        }
+        else if (!strcmp(config, "interval")) {
+            gchar metric[32];
+            gint interval;
+            
+            if (sscanf(item, "%31s %d", metric, &interval) == 2 && interval >= 100) {
+                for (gint i = 0; i < N_GPU_METRICS; ++i) {
+                    if (!strcmp(gpu_metric_schedule[i].name, metric)) {
+                        g_atomic_int_set(&gpu_metric_schedule[i].interval_ms, interval);
+                    }
+                }
+            }
         }
         else if (!strcmp(config, "enabled")) {
             sscanf(item, "%31s %[^\n]", gpu_name, command);
-            for (list = gpu_list; list; list = list->next) {
-                gpu = (GpuPlugin *)list->data;
-                if (strcmp(gpu->name, gpu_name) == 0) {
-                    sscanf(command, "%d\n", &gpu->enabled);
+            gpu = lookup_gpu(gpu_name);
+            if (gpu) {
+                sscanf(command, "%d\n", &gpu->enabled);
+                g_atomic_int_set(&gpu->dev->enabled, gpu->enabled);
+            }
+        }
+        else if (!strcmp(config, "alert_interval")) {
+            sscanf(item, "%d\n", &alert_interval);
+        }
+        else if (!strcmp(config, "alert")) {
+            gchar name[32];
+            gint enabled, raise_at, clear_at, dwell_s;
+            
+            if (sscanf(item, "%31s %d %d %d %d", name, &enabled, &raise_at,
+                       &clear_at, &dwell_s) == 5) {
+                for (gint i = 0; i < N_GPU_ALERTS; ++i) {
+                    GpuAlertRule *rule = &gpu_alert_rules[i];
+                    
+                    if (!strcmp(rule->name, name)) {
+                        g_atomic_int_set(&rule->enabled, enabled);
+                        g_atomic_int_set(&rule->raise_at, raise_at);
+                        g_atomic_int_set(&rule->clear_at, clear_at);
+                        g_atomic_int_set(&rule->dwell_s, dwell_s);
+                    }
                 }
             }
         }
-        else if (!strcmp(config, GKRELLM_ALERTCONFIG_KEYWORD)) {
-            if (!gpu_alert) {
-                create_alert();
+        else if (!strcmp(config, "alert_command")) {
+            sscanf(item, "%31s %[^\n]", gpu_name, command);
+            for (gint i = 0; i < N_GPU_ALERTS; ++i) {
+                if (!strcmp(gpu_alert_rules[i].name, gpu_name)) {
+                    g_free(alert_commands[i]);
+                    alert_commands[i] = g_strdup(command);
+                }
             }
-            gkrellm_load_alertconfig(&gpu_alert, item);
-            cb_alert_config(gpu_alert, NULL);
         }
         else if (!strcmp(config, "extra_info")) {
             sscanf(item, "%31s %[^\n]", gpu_name, command);
-            for (list = gpu_list; list; list = list->next) {
-                gpu = (GpuPlugin *)list->data;
-                if (strcmp(gpu->name, gpu_name) == 0) {
-                    sscanf(command, "%d\n", &gpu->extra_info);
-                }
+            gpu = lookup_gpu(gpu_name);
+            if (gpu) {
+                sscanf(command, "%d\n", &gpu->extra_info);
             }
         }
         else if (!strcmp(config, "launch")) {
             sscanf(item, "%31s %[^\n]", gpu_name, command);
-            for (list = gpu_list; list; list = list->next) {
-                gpu = (GpuPlugin *)list->data;
-                if (strcmp(gpu->name, gpu_name) == 0) {
-                    gpu->launch.command = g_strdup(command);
-                }
+            gpu = lookup_gpu(gpu_name);
+            if (gpu) {
+                gpu->launch.command = g_strdup(command);
             }
         }
         else if (!strcmp(config, "tooltip_comment")) {
             sscanf(item, "%31s %[^\n]", gpu_name, command);
-            for (list = gpu_list; list; list = list->next) {
-                gpu = (GpuPlugin *)list->data;
-                if (strcmp(gpu->name, gpu_name) == 0) {
-                    gpu->launch.tooltip_comment = g_strdup(command);
-                }
+            gpu = lookup_gpu(gpu_name);
+            if (gpu) {
+                gpu->launch.tooltip_comment = g_strdup(command);
             }
         }
     }
@@ -948,8 +3472,11 @@ set_gpu_sensor(gpointer sr, gint type, gint n)
         return FALSE;
         
     /* Find the GPU for this sensor index */
-    gpu = g_list_nth_data(gpu_list, n);
-    if (!gpu || !gpu->enabled) {
+    if (n < 0 || n >= n_slots) {
+        return FALSE;
+    }
+    gpu = &gpus[n];
+    if (!gpu->enabled) {
         return FALSE;
     }
     
@@ -967,17 +3494,23 @@ set_gpu_sensor(gpointer sr, gint type, gint n)
 GkrellmMonitor *
 gkrellm_init_plugin(void)
 {
-    /* Initialize NVML and detect GPUs */
-    if (!setup_gpu_interface()) {
-        g_warning("GPU plugin: failed to initialize NVML");
-        return NULL;
+    /* Initialize NVML and detect GPUs in the background; sampling starts
+     * once the UI takes them over.  A client of gkrellmd shows its GPUs,
+     * which the setup it sent describes. */
+    init_started = g_get_monotonic_time();
+    pending_config = g_ptr_array_new_with_free_func(g_free);
+    if (gkrellm_client_mode()) {
+        gkrellm_client_plugin_get_setup(GPU_REMOTE_KEY, cb_remote_setup);
+        g_atomic_int_set(&init_state,
+                         setup_remote_gpus() ? GPU_INIT_DONE : GPU_INIT_FAILED);
+    }
+    else {
+        init_thread = g_thread_new("gkrellm-gpu-init", init_thread_main, NULL);
     }
     
     /* Set the default text format */
     gkrellm_locale_dup_string(&text_format, "$u", &text_format_locale);
-    
-    /* Create alert */
-    create_alert();
+    compile_text_format();
     
     /* Create our monitor */
     monitor = g_new0(GkrellmMonitor, 1);
@@ -999,5 +3532,9 @@ gkrellm_init_plugin(void)
     /* Register our style */
     style_id = gkrellm_add_chart_style(monitor, STYLE_NAME);
     
+    if (gkrellm_client_mode()) {
+        gkrellm_client_plugin_serve_data_connect(monitor, GPU_REMOTE_KEY, cb_remote_data);
+    }
+    
     return monitor;
 }
@@ -0,0 +1,334 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - gkrellmd update protocol encoding and parsing
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#include "gpu-remote.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* The scalar fields of a sample and their keys.  Numbers are sent in
+ * decimal, floats in the C locale with the digits to read back the same
+ * value, so a client ends up with exactly the server's samples. */
+
+typedef enum {
+    FIELD_UINT32,
+    FIELD_UINT64,
+    FIELD_FLOAT,
+    FIELD_DOUBLE
+} GpuRemoteType;
+
+typedef struct {
+    const gchar   *key;
+    gsize         offset;
+    GpuRemoteType type;
+} GpuRemoteField;
+
+#define FIELD(key, member, type) \
+    { key, G_STRUCT_OFFSET(GpuSharedSample, member), FIELD_##type }
+
+static const GpuRemoteField fields[] = {
+    FIELD("u", utilization, UINT32),
+    FIELD("h", health, UINT32),
+    FIELD("T", total_memory, UINT64),
+    FIELD("m", used_memory, UINT64),
+    FIELD("t", temperature, FLOAT),
+    FIELD("p", power, FLOAT),
+    FIELD("s", util_sum, DOUBLE),
+    FIELD("n", util_readings, UINT64),
+    FIELD("k", column_peak, UINT32),
+    FIELD("e", column_events, UINT32),
+    FIELD("r0", reduction[0], UINT32),
+    FIELD("r1", reduction[1], UINT32),
+    FIELD("r2", reduction[2], UINT32),
+    FIELD("r3", reduction[3], UINT32),
+    FIELD("r4", reduction[4], UINT32),
+    FIELD("b", busy, UINT32),
+    FIELD("N", n_reduced, UINT32),
+    FIELD("x", xid_count, UINT32),
+    FIELD("X", last_xid, UINT64),
+    FIELD("c", throttle_reasons, UINT32)
+};
+
+static const gsize field_sizes[] = {
+    sizeof(guint32), sizeof(guint64), sizeof(gfloat), sizeof(gdouble)
+};
+
+/* Append up to max bytes of s, escaping what would break a line apart */
+static void
+append_escaped(GString *out, const gchar *s, gsize max)
+{
+    guchar c;
+    
+    for (gsize i = 0; i < max && s[i]; ++i) {
+        c = (guchar) s[i];
+        if (c <= ' ' || c >= 0x7f || c == '%' || c == '=' || c == ',') {
+            g_string_append_printf(out, "%%%02X", c);
+        }
+        else {
+            g_string_append_c(out, c);
+        }
+    }
+}
+
+/* Undo append_escaped() into dest, always terminated */
+static void
+unescape(gchar *dest, gsize size, const gchar *s)
+{
+    gsize n = 0;
+    
+    while (*s && n + 1 < size) {
+        if (s[0] == '%' && g_ascii_isxdigit(s[1]) && g_ascii_isxdigit(s[2])) {
+            dest[n++] = (gchar) (g_ascii_xdigit_value(s[1]) << 4 | g_ascii_xdigit_value(s[2]));
+            s += 3;
+        }
+        else {
+            dest[n++] = *s++;
+        }
+    }
+    dest[n] = '\0';
+}
+
+gchar *
+gpu_remote_format_device(gint slot, const GpuSharedDevice *device)
+{
+    GString *out = g_string_new(NULL);
+    
+    g_string_append_printf(out, "device %d %d %d %d %d %d %d %" G_GUINT64_FORMAT " ",
+                           slot, device->instance, device->mig_index, device->parent,
+                           device->n_children, device->is_composite, device->n_nvlinks,
+                           device->device_memory);
+    append_escaped(out, device->name, sizeof(device->name));
+    g_string_append_c(out, ' ');
+    append_escaped(out, device->label, sizeof(device->label));
+    g_string_append_c(out, ' ');
+    append_escaped(out, device->uuid, sizeof(device->uuid));
+    g_string_append_c(out, ' ');
+    append_escaped(out, device->device_name, sizeof(device->device_name));
+    g_string_append_c(out, '\n');
+    return g_string_free(out, FALSE);
+}
+
+gint
+gpu_remote_parse_device(const gchar *line, GpuSharedDevice *device)
+{
+    gchar *copy, **tokens;
+    gint slot = -1;
+    
+    copy = g_strchomp(g_strdup(line));
+    tokens = g_strsplit(copy, " ", 13);
+    if (g_strv_length(tokens) == 13 && !strcmp(tokens[0], "device")) {
+        memset(device, 0, sizeof(*device));
+        slot = atoi(tokens[1]);
+        device->instance = atoi(tokens[2]);
+        device->mig_index = atoi(tokens[3]);
+        device->parent = atoi(tokens[4]);
+        device->n_children = atoi(tokens[5]);
+        device->is_composite = atoi(tokens[6]);
+        device->n_nvlinks = atoi(tokens[7]);
+        device->device_memory = g_ascii_strtoull(tokens[8], NULL, 10);
+        unescape(device->name, sizeof(device->name), tokens[9]);
+        unescape(device->label, sizeof(device->label), tokens[10]);
+        unescape(device->uuid, sizeof(device->uuid), tokens[11]);
+        unescape(device->device_name, sizeof(device->device_name), tokens[12]);
+        if (slot < 0 || !*device->name) {
+            slot = -1;
+        }
+    }
+    g_strfreev(tokens);
+    g_free(copy);
+    return slot;
+}
+
+static void
+append_field(GString *out, const GpuRemoteField *field, const GpuSharedSample *sample)
+{
+    const guint8 *value = (const guint8 *) sample + field->offset;
+    gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+    
+    g_string_append_printf(out, " %s=", field->key);
+    switch (field->type) {
+    case FIELD_UINT32:
+        g_string_append_printf(out, "%u", *(const guint32 *) value);
+        break;
+    case FIELD_UINT64:
+        g_string_append_printf(out, "%" G_GUINT64_FORMAT, *(const guint64 *) value);
+        break;
+    case FIELD_FLOAT:
+        g_string_append(out, g_ascii_formatd(buf, sizeof(buf), "%.9g",
+                                             *(const gfloat *) value));
+        break;
+    case FIELD_DOUBLE:
+        g_string_append(out, g_ascii_formatd(buf, sizeof(buf), "%.17g",
+                                             *(const gdouble *) value));
+        break;
+    }
+}
+
+static void
+parse_field(const GpuRemoteField *field, GpuSharedSample *sample, const gchar *text)
+{
+    guint8 *value = (guint8 *) sample + field->offset;
+    
+    switch (field->type) {
+    case FIELD_UINT32:
+        *(guint32 *) value = (guint32) g_ascii_strtoull(text, NULL, 10);
+        break;
+    case FIELD_UINT64:
+        *(guint64 *) value = g_ascii_strtoull(text, NULL, 10);
+        break;
+    case FIELD_FLOAT:
+        *(gfloat *) value = (gfloat) g_ascii_strtod(text, NULL);
+        break;
+    case FIELD_DOUBLE:
+        *(gdouble *) value = g_ascii_strtod(text, NULL);
+        break;
+    }
+}
+
+gsize
+gpu_remote_format_delta(GString *out, gint slot,
+                        const GpuSharedSample *prev, const GpuSharedSample *cur)
+{
+    const GpuRemoteField *field;
+    gsize start = out->len;
+    gsize empty;
+    gint n_procs;
+    
+    g_string_append_printf(out, "%d", slot);
+    empty = out->len;
+    
+    for (guint f = 0; f < G_N_ELEMENTS(fields); ++f) {
+        field = &fields[f];
+        if (memcmp((const guint8 *) prev + field->offset,
+                   (const guint8 *) cur + field->offset, field_sizes[field->type])) {
+            append_field(out, field, cur);
+        }
+    }
+    for (gint c = 0; c < GPU_SHARED_LINK_RATES; ++c) {
+        if (prev->link_rates[c] != cur->link_rates[c]) {
+            g_string_append_printf(out, " l%d=%" G_GUINT64_FORMAT, c, cur->link_rates[c]);
+        }
+    }
+    
+    /* The process list goes whole, and only when the sampler refreshed it */
+    if (prev->procs_serial != cur->procs_serial) {
+        n_procs = CLAMP(cur->n_procs, 0, GPU_SHARED_PROCESSES);
+        g_string_append_printf(out, " P=%d,%d,%u",
+                               n_procs, cur->procs_total, cur->procs_serial);
+        for (gint p = 0; p < n_procs; ++p) {
+            g_string_append_printf(out, " p%d=%u,%u,%" G_GUINT64_FORMAT ",", p,
+                                   cur->procs[p].pid, cur->procs[p].sm_util,
+                                   cur->procs[p].used_memory);
+            append_escaped(out, cur->procs[p].comm, sizeof(cur->procs[p].comm));
+        }
+    }
+    
+    if (out->len == empty) {
+        g_string_truncate(out, start);
+        return 0;
+    }
+    g_string_append_c(out, '\n');
+    return out->len - start;
+}
+
+static void
+apply_field(GpuSharedSample *sample, const gchar *key, const gchar *value)
+{
+    GpuSharedProcess *proc;
+    guint64 index;
+    gchar *end;
+    gint length = 0;
+    
+    /* Link rates and processes are numbered, which no field key is */
+    if ((key[0] == 'l' || key[0] == 'p') && g_ascii_isdigit(key[1])) {
+        index = g_ascii_strtoull(key + 1, &end, 10);
+        if (*end) {
+            return;
+        }
+        if (key[0] == 'l' && index < GPU_SHARED_LINK_RATES) {
+            sample->link_rates[index] = g_ascii_strtoull(value, NULL, 10);
+        }
+        else if (key[0] == 'p' && index < GPU_SHARED_PROCESSES) {
+            proc = &sample->procs[index];
+            if (sscanf(value, "%u,%u,%" G_GUINT64_FORMAT ",%n",
+                       &proc->pid, &proc->sm_util, &proc->used_memory, &length) == 3
+                && length > 0) {
+                unescape(proc->comm, sizeof(proc->comm), value + length);
+            }
+        }
+        return;
+    }
+    if (!strcmp(key, "P")) {
+        sscanf(value, "%d,%d,%u", &sample->n_procs, &sample->procs_total,
+               &sample->procs_serial);
+        sample->n_procs = CLAMP(sample->n_procs, 0, GPU_SHARED_PROCESSES);
+        return;
+    }
+    for (guint f = 0; f < G_N_ELEMENTS(fields); ++f) {
+        if (!strcmp(key, fields[f].key)) {
+            parse_field(&fields[f], sample, value);
+            return;
+        }
+    }
+}
+
+gint
+gpu_remote_apply_delta(const gchar *line, GpuSharedSample *samples, gint n_slots)
+{
+    gchar **tokens, *end, *value;
+    glong slot;
+    
+    tokens = g_strsplit_set(line, " \n", -1);
+    if (!tokens[0]) {
+        g_strfreev(tokens);
+        return -1;
+    }
+    slot = strtol(tokens[0], &end, 10);
+    if (end == tokens[0] || *end || slot < 0 || slot >= n_slots) {
+        g_strfreev(tokens);
+        return -1;
+    }
+    
+    /* Keys a newer server added are skipped */
+    for (gint i = 1; tokens[i]; ++i) {
+        value = strchr(tokens[i], '=');
+        if (value) {
+            *value++ = '\0';
+            apply_field(&samples[slot], tokens[i], value);
+        }
+    }
+    g_strfreev(tokens);
+    return (gint) slot;
+}
@@ -0,0 +1,71 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - gkrellmd update protocol
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#ifndef GPU_REMOTE_H
+#define GPU_REMOTE_H
+
+#include <glib.h>
+
+#include "gpu-shared.h"
+
+/* gkrellmd serves its GPUs to GKrellM clients as lines of text under
+ * GPU_REMOTE_KEY.  The setup is a "version" line, a "gpus <slots> <gpus>"
+ * line and a "device" line per slot.  Each update then has one line per
+ * device whose sample changed, its slot followed by the fields that
+ * changed as key=value pairs, so an idle GPU costs nothing; a client
+ * applies them to the samples it kept from the previous update.  A
+ * "reset" line tells a client to forget those, before the full state is
+ * sent to it as changes from zeroed samples.  The fields are those of
+ * GpuSharedSample, strings escaped as %XX so they hold no spaces. */
+
+#define GPU_REMOTE_KEY "gpu"
+#define GPU_REMOTE_VERSION 1
+#define GPU_REMOTE_MAX_SLOTS 1024      /* Most devices a client takes from a server */
+
+/* A "device" setup line, with its newline */
+gchar *gpu_remote_format_device(gint slot, const GpuSharedDevice *device);
+
+/* Parse a "device" setup line into device, the slot or -1 if it is not one */
+gint gpu_remote_parse_device(const gchar *line, GpuSharedDevice *device);
+
+/* Append the update line taking prev to cur, nothing if they match.
+ * Returns the number of bytes appended. */
+gsize gpu_remote_format_delta(GString *out, gint slot,
+                              const GpuSharedSample *prev, const GpuSharedSample *cur);
+
+/* Apply an update line to the samples of n_slots devices.  Returns the
+ * slot updated, or -1 if the line is not an update. */
+gint gpu_remote_apply_delta(const gchar *line, GpuSharedSample *samples, gint n_slots);
+
+#endif /* GPU_REMOTE_H */
@@ -0,0 +1,2548 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Sampling core
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#include "gpu-sampler.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#ifndef N_
+#define N_(String) (String)
+#endif
+
+#define GPU_IDLE_HOLDOFF_MS 30000     /* Idle time before sampling backs off */
+#define GPU_MAX_BACKOFF 8             /* Maximum interval multiplier when idle */
+#define GPU_COMM_CACHE_SIZE 64        /* Command names cached by PID */
+#define GPU_RETRY_MIN_MS 1000         /* First retry of a failing GPU */
+#define GPU_RETRY_MAX_MS 60000        /* Longest wait between retries */
+#define GPU_RESTART_MIN_MS 10000      /* All GPUs down this long restarts NVML */
+#define GPU_RESTART_MAX_MS 600000     /* Longest wait between NVML restarts */
+#define GPU_EVENT_SLICE_MS 200        /* Longest event wait, bounds how long stopping takes */
+#define GPU_SHARED_WAIT_MS 10000      /* Time a reader waits for the sampler to publish */
+#define GPU_SHARED_STALE_MS 5000      /* A shared snapshot this old is stale */
+#define GPU_SHARED_ENV "GKRELLM_GPU_SHARED" /* Set to 1 to share one sampler per host */
+
+/* NVML exposes utilization, used memory and GPU temperature only through
+ * their dedicated calls; power can also be read as a field value */
+#ifdef NVML_FI_DEV_POWER_INSTANT
+#define GPU_POWER_FIELD NVML_FI_DEV_POWER_INSTANT
+#else
+#define GPU_POWER_FIELD 0
+#endif
+
+/* Interconnect traffic is read as monotonic counters, all in the same
+ * field value call: PCIe TX and RX in bytes, then TX and RX of every
+ * NVLink in KiB with the link as the scope */
+#ifdef NVML_FI_DEV_PCIE_COUNT_TX_BYTES
+#define GPU_PCIE_TX_FIELD NVML_FI_DEV_PCIE_COUNT_TX_BYTES
+#define GPU_PCIE_RX_FIELD NVML_FI_DEV_PCIE_COUNT_RX_BYTES
+#else
+#define GPU_PCIE_TX_FIELD 0
+#define GPU_PCIE_RX_FIELD 0
+#endif
+#ifdef NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX
+#define GPU_NVLINK_TX_FIELD NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX
+#define GPU_NVLINK_RX_FIELD NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX
+#else
+#define GPU_NVLINK_TX_FIELD 0
+#define GPU_NVLINK_RX_FIELD 0
+#endif
+#define GPU_LINK_FIELD (GPU_PCIE_TX_FIELD ? GPU_PCIE_TX_FIELD : GPU_NVLINK_TX_FIELD)
+
+/* NVML events the sampler wakes up for */
+#define GPU_EVENT_TYPES (nvmlEventTypeXidCriticalError | nvmlEventTypeClock | nvmlEventTypePState)
+#define GPU_RESAMPLE_EVENTS (nvmlEventTypeXidCriticalError | nvmlEventTypePState)
+#define GPU_RESAMPLE_METRICS ((1 << GPU_METRIC_UTILIZATION) | (1 << GPU_METRIC_MEMORY) \
+                              | (1 << GPU_METRIC_TEMPERATURE) | (1 << GPU_METRIC_POWER) \
+                              | (1 << GPU_METRIC_THROTTLE))
+
+/* A MIG device found during enumeration */
+typedef struct {
+    gint         instance;         /* Device index of the parent GPU */
+    gint         mig_index;        /* MIG device index on the parent */
+} GpuMigRef;
+
+/* Utilization readings gathered by one sample pass, sampler thread only */
+typedef struct {
+    gdouble      sum;
+    guint        count;
+    gulong       peak;
+    guint        events;           /* GPU_MARK_* events */
+    guint        xids;             /* Critical XID errors */
+    gulong       last_xid;         /* Most recent XID */
+} GpuColumnPass;
+
+/* Command name of a PID, cached so /proc is only read for new PIDs */
+typedef struct {
+    guint        pid;
+    guint        seen;             /* Last process pass that listed the PID */
+    gchar        comm[GPU_COMM_LEN];
+    GList        link;             /* Position in comm_lru, data is the entry */
+} GpuCommEntry;
+
+static const GpuBackend *nvml = NULL;   /* Sampling backend, NVML or synthetic */
+static GpuDevice *devices = NULL;       /* Devices, the composite first if any */
+static gint n_slots = 0;                /* Number of entries in devices */
+static GpuDevice *composite_device = NULL; /* Composite GPU (average of all) */
+static gint n_gpus = 0;                 /* Number of GPUs detected */
+static gboolean nvml_started = FALSE;   /* If NVML was initialized here, to be shut down */
+
+/* Background sampler state.  The sampler thread fills the back buffer and
+ * publishes it by swapping it with the front buffer under sampler_lock;
+ * the GTK side only ever copies out of the front buffer. */
+static GThread *sampler_thread = NULL;
+static GMutex sampler_lock;
+static GCond sampler_cond;
+static gboolean sampler_running = FALSE;
+static GpuSample *sample_buffers[2] = { NULL, NULL };
+static gint sample_front = 0;
+
+/* Sampling shared between the GKrellM instances of a host.  The sampler
+ * publishes every pass into the shared segment; a reader has no sampler
+ * thread and no NVML, fills the front buffer from the segment on the UI
+ * thread and takes over when the sampler goes away.  Samples received
+ * from gkrellmd are taken in the same way as a shared snapshot. */
+static gint shared_role = GPU_ROLE_ALONE; /* (atomic) */
+static GpuShared *shared = NULL;
+static GpuSharedHeader *shared_header = NULL; /* Segment as mapped by the sampler */
+static GpuSharedSample *shared_scratch = NULL; /* Snapshot copied out by a reader */
+static guint32 shared_seq_seen = 0;     /* Sequence of the snapshot last merged */
+static guint32 remote_seq = 0;          /* Bumped on every remote update */
+static GThread *takeover_thread = NULL; /* Initializes NVML to take over sampling */
+static gint takeover_state = 0;         /* GPU_INIT_* of takeover_thread (atomic) */
+static gint64 takeover_at = 0;          /* Earliest next takeover attempt */
+static guint takeover_ms = 0;           /* Current wait between failed attempts */
+
+G_STATIC_ASSERT(N_GPU_REDUCTIONS == GPU_SHARED_REDUCTIONS);
+G_STATIC_ASSERT(GPU_TOP_PROCESSES == GPU_SHARED_PROCESSES);
+G_STATIC_ASSERT(GPU_COMM_LEN == GPU_SHARED_COMM_LEN);
+G_STATIC_ASSERT(GPU_LINK_COUNTERS == GPU_SHARED_LINK_RATES);
+
+/* Per-metric sampling cadence, decoupled from the GKrellM update rate */
+GpuMetricSchedule gpu_metric_schedule[N_GPU_METRICS] = {
+    { "utilization", N_("Utilization"),  250,  0, 0 },
+    { "memory",      N_("Memory"),       1000, 0, 0 },
+    { "temperature", N_("Temperature"),  2000, 0, 0 },
+    { "power",       N_("Power"),        1000, 0, GPU_POWER_FIELD },
+    { "processes",   N_("Processes"),    2000, 0, 0 },
+    { "interconnect", N_("PCIe/NVLink"), 1000, 0, GPU_LINK_FIELD },
+    { "throttle",    N_("Clock throttling"), 1000, 0, 0 },
+};
+
+/* Alert conditions, all off until configured */
+GpuAlertRule gpu_alert_rules[N_GPU_ALERTS] = {
+    { "utilization", N_("Utilization"),      "%", FALSE, 95,  80,  60 },
+    { "memory",      N_("Memory used"),      "%", FALSE, 95,  90,  10 },
+    { "temperature", N_("Temperature"),      "C", FALSE, 85,  80,  10 },
+    { "power",       N_("Power"),            "W", FALSE, 300, 250, 10 },
+    { "throttle",    N_("Clocks throttled"), NULL, FALSE, 1,  1,   10 },
+};
+
+const GpuThrottleCategory gpu_throttle_categories[N_GPU_THROTTLE] = {
+    { "power", N_("power cap"),
+      nvmlClocksThrottleReasonSwPowerCap, GPU_MARK_POWER_CAP },
+    { "thermal", N_("thermal"),
+      nvmlClocksThrottleReasonSwThermalSlowdown | nvmlClocksThrottleReasonHwThermalSlowdown,
+      GPU_MARK_THERMAL },
+    { "hw", N_("HW slowdown"),
+      nvmlClocksThrottleReasonHwSlowdown | nvmlClocksThrottleReasonHwPowerBrakeSlowdown,
+      GPU_MARK_HW_SLOWDOWN },
+    { "sync", N_("sync boost"),
+      nvmlClocksThrottleReasonSyncBoost, GPU_MARK_SYNC_BOOST },
+    { "clocks", N_("clock setting"),
+      nvmlClocksThrottleReasonApplicationsClocksSetting
+      | nvmlClocksThrottleReasonDisplayClockSetting, 0 },
+    { "idle", N_("idle"),
+      nvmlClocksThrottleReasonGpuIdle, 0 },
+};
+
+gint gpu_composite_reduction = GPU_REDUCE_MEAN;
+gint gpu_idle_backoff = TRUE;
+gint gpu_buffered_utilization = TRUE;
+gint gpu_show_interconnect = FALSE;
+gint gpu_use_events = TRUE;
+
+static guchar *reduce_util = NULL;      /* Packed GPU utilizations, sampler thread only */
+static gdouble *reduce_weight = NULL;   /* Packed GPU used memory, sampler thread only */
+
+static gint sample_backoff = 1;         /* Current interval multiplier, sampler thread only */
+static gint64 idle_since = 0;           /* When all GPUs went idle, sampler thread only */
+static gint64 resample_at = 0;          /* Earliest next resample on events, sampler thread only */
+
+static GHashTable *comm_cache = NULL;   /* PID -> GpuCommEntry, sampler thread only */
+static GQueue comm_lru = G_QUEUE_INIT;  /* Cached entries, most recently used first */
+static guint comm_pass = 0;             /* Process passes made, sampler thread only */
+static GArray *proc_scratch = NULL;     /* GpuProcess list being built, sampler thread only */
+
+static nvmlEventSet_t event_set = NULL; /* Events of all GPUs, waited on by the sampler */
+static gboolean event_set_failed = FALSE; /* Waiting failed, poll instead (sampler only) */
+static gint64 nvml_restart_at = 0;      /* Next NVML restart while all GPUs are down */
+static guint nvml_restart_ms = 0;       /* Current restart interval, 0 while any GPU is up */
+static GpuColumnPass *column_pass = NULL;
+static guint column_epoch = 0;          /* Bumped by the UI when it takes a column */
+static guint column_epoch_seen = 0;     /* Last epoch merged by the sampler */
+
+/* NVML call accounting for the sampling path */
+static guint nvml_calls_sample = 0;     /* Calls made by the current sample pass */
+static guint nvml_calls_sample_unbatched = 0; /* Calls the pass needs without batching */
+static guint nvml_calls_last = 0;       /* Calls made by the previous sample pass */
+
+gint gpu_nvml_calls_total = 0;
+
+static void create_event_set(void);
+
+/* Check whether an NVML error means the cached device handle went stale */
+static gboolean
+nvml_error_is_stale(nvmlReturn_t result)
+{
+    return result != NVML_SUCCESS
+           && result != NVML_ERROR_NOT_SUPPORTED
+           && result != NVML_ERROR_NO_PERMISSION;
+}
+
+/* Take a device out of sampling after an NVML error that made its handle
+ * stale.  It is resolved again at retry_at, backing off while it keeps
+ * failing. */
+static void
+device_failed(GpuDevice *gpu, nvmlReturn_t result)
+{
+    gpu->device_valid = FALSE;
+    gpu->last_error = result;
+    if (gpu->state == GPU_HEALTH_OK) {
+        g_warning("GPU plugin: %s failed: %s\n", gpu->label, nvml->ErrorString(result));
+        gpu->retry_ms = GPU_RETRY_MIN_MS;
+        gpu->retry_at = g_get_monotonic_time() + (gint64) GPU_RETRY_MIN_MS * 1000;
+    }
+    gpu->state = (result == NVML_ERROR_GPU_IS_LOST) ? GPU_HEALTH_LOST : GPU_HEALTH_STALE;
+}
+
+/* Convert a typed NVML value to a double */
+static gdouble
+nvml_value_as_double(nvmlValueType_t type, const nvmlValue_t *value)
+{
+    switch (type) {
+        case NVML_VALUE_TYPE_DOUBLE:
+            return value->dVal;
+        case NVML_VALUE_TYPE_UNSIGNED_INT:
+            return (gdouble) value->uiVal;
+        case NVML_VALUE_TYPE_UNSIGNED_LONG:
+            return (gdouble) value->ulVal;
+        case NVML_VALUE_TYPE_UNSIGNED_LONG_LONG:
+            return (gdouble) value->ullVal;
+        case NVML_VALUE_TYPE_SIGNED_LONG_LONG:
+            return (gdouble) value->sllVal;
+        case NVML_VALUE_TYPE_SIGNED_INT:
+            return (gdouble) value->siVal;
+        default:
+            return 0.0;
+    }
+}
+
+/* Resolve the device handle and the static properties of a GPU.  A MIG
+ * device is reached through its parent, which must be resolved first.
+ * A GPU seen before is found again by UUID, since the indices shift when
+ * a GPU drops off the bus. */
+static gboolean
+resolve_gpu_device(GpuDevice *gpu)
+{
+    GpuDevice *parent = gpu->parent;
+    nvmlReturn_t result;
+    nvmlPciInfo_t pci;
+    nvmlMemory_t memory;
+    nvmlGpmSupport_t gpm;
+    nvmlFieldValue_t field;
+    unsigned int temp, id;
+    
+    gpu->device_valid = FALSE;
+    
+    if (parent) {
+        if (!parent->device_valid) {
+            gpu->last_error = parent->last_error;
+            return FALSE;
+        }
+        result = nvml->DeviceGetMigDeviceHandleByIndex(parent->device, gpu->mig_index,
+                                                       &gpu->device);
+    }
+    else if (gpu->uuid[0]) {
+        result = nvml->DeviceGetHandleByUUID(gpu->uuid, &gpu->device);
+    }
+    else {
+        result = nvml->DeviceGetHandleByIndex(gpu->instance, &gpu->device);
+    }
+    if (result != NVML_SUCCESS) {
+        gpu->last_error = result;
+        return FALSE;
+    }
+    
+    if (nvml->DeviceGetName(gpu->device, gpu->device_name,
+                          sizeof(gpu->device_name)) != NVML_SUCCESS) {
+        gpu->device_name[0] = '\0';
+    }
+    if (!gpu->uuid[0] && nvml->DeviceGetUUID(gpu->device, gpu->uuid,
+                                             sizeof(gpu->uuid)) != NVML_SUCCESS) {
+        gpu->uuid[0] = '\0';
+    }
+    
+    /* Total memory does not change while the device is attached */
+    if (nvml->DeviceGetMemoryInfo(gpu->device, &memory) == NVML_SUCCESS) {
+        gpu->device_memory = memory.total;
+    }
+    
+    if (parent) {
+        /* GPM samples are taken by GPU instance id, which changes if the
+         * GPU is repartitioned */
+        if (nvml->DeviceGetGpuInstanceId(gpu->device, &id) != NVML_SUCCESS) {
+            return FALSE;
+        }
+        if (id != gpu->gpu_instance_id) {
+            gpu->gpu_instance_id = id;
+            gpu->gpm_primed = FALSE;
+        }
+        
+        /* A MIG device shares the bus and the sensors of its GPU */
+        g_strlcpy(gpu->pci_bus_id, parent->pci_bus_id, sizeof(gpu->pci_bus_id));
+        gpu->temp_slowdown = parent->temp_slowdown;
+        gpu->temp_shutdown = parent->temp_shutdown;
+        
+        gpu->device_valid = TRUE;
+        return TRUE;
+    }
+    
+    if (nvml->DeviceGetPciInfo(gpu->device, &pci) == NVML_SUCCESS) {
+        g_strlcpy(gpu->pci_bus_id, pci.busId, sizeof(gpu->pci_bus_id));
+    }
+    else {
+        gpu->pci_bus_id[0] = '\0';
+    }
+    
+    gpu->temp_slowdown = 0;
+    if (nvml->DeviceGetTemperatureThreshold(gpu->device,
+                                          NVML_TEMPERATURE_THRESHOLD_SLOWDOWN,
+                                          &temp) == NVML_SUCCESS) {
+        gpu->temp_slowdown = temp;
+    }
+    gpu->temp_shutdown = 0;
+    if (nvml->DeviceGetTemperatureThreshold(gpu->device,
+                                          NVML_TEMPERATURE_THRESHOLD_SHUTDOWN,
+                                          &temp) == NVML_SUCCESS) {
+        gpu->temp_shutdown = temp;
+    }
+    
+    /* Interconnect counters are per link */
+    gpu->n_nvlinks = 0;
+#ifdef NVML_FI_DEV_NVLINK_LINK_COUNT
+    memset(&field, 0, sizeof(field));
+    field.fieldId = NVML_FI_DEV_NVLINK_LINK_COUNT;
+    if (nvml->DeviceGetFieldValues(gpu->device, 1, &field) == NVML_SUCCESS
+        && field.nvmlReturn == NVML_SUCCESS) {
+        gpu->n_nvlinks = MIN((gint) nvml_value_as_double(field.valueType, &field.value),
+                             GPU_MAX_NVLINKS);
+    }
+#endif
+    
+    /* MIG devices can only report utilization through GPM */
+    gpu->gpm_supported = FALSE;
+    if (gpu->n_children > 0) {
+        memset(&gpm, 0, sizeof(gpm));
+        gpm.version = NVML_GPM_SUPPORT_VERSION;
+        if (nvml->GpmQueryDeviceSupport(gpu->device, &gpm) == NVML_SUCCESS) {
+            gpu->gpm_supported = gpm.isSupportedDevice;
+        }
+    }
+    
+    gpu->device_valid = TRUE;
+    return TRUE;
+}
+
+/* Collect the MIG devices of every GPU in MIG mode, in GPU order */
+static GArray *
+enumerate_mig_devices(void)
+{
+    GArray *migs = g_array_new(FALSE, FALSE, sizeof(GpuMigRef));
+    GpuMigRef ref;
+    nvmlDevice_t device, mig;
+    unsigned int current, pending, count, i;
+    
+    for (ref.instance = 0; ref.instance < n_gpus; ref.instance++) {
+        if (nvml->DeviceGetHandleByIndex(ref.instance, &device) != NVML_SUCCESS
+            || nvml->DeviceGetMigMode(device, &current, &pending) != NVML_SUCCESS
+            || current != NVML_DEVICE_MIG_ENABLE
+            || nvml->DeviceGetMaxMigDeviceCount(device, &count) != NVML_SUCCESS) {
+            continue;
+        }
+        
+        /* Unused MIG slots have no handle */
+        for (i = 0; i < count; ++i) {
+            if (nvml->DeviceGetMigDeviceHandleByIndex(device, i, &mig) == NVML_SUCCESS) {
+                ref.mig_index = i;
+                g_array_append_val(migs, ref);
+            }
+        }
+    }
+    
+    return migs;
+}
+
+/* Pick the sampling backend, the NVIDIA driver unless the environment
+ * asks for synthetic GPUs.  NULL if the driver library cannot be loaded. */
+static const GpuBackend *
+select_backend(void)
+{
+    const gchar *name = g_getenv(GPU_BACKEND_ENV);
+    
+    if (name && !strcmp(name, "synthetic")) {
+        return gpu_backend_synthetic(g_getenv(GPU_SYNTHETIC_ENV));
+    }
+    if (name && strcmp(name, "nvml")) {
+        g_warning("GPU plugin: unknown backend '%s', using NVML\n", name);
+    }
+    
+    return gpu_backend_nvml();
+}
+
+/* Allocate the device entries, to be filled in from NVML or from a
+ * description of the sampler's */
+static void
+allocate_devices(gint count)
+{
+    n_slots = count;
+    devices = g_new0(GpuDevice, n_slots);
+    
+    for (gint slot = 0; slot < n_slots; slot++) {
+        devices[slot].slot = slot;
+        devices[slot].enabled = TRUE;
+        devices[slot].mig_index = -1;
+    }
+}
+
+/* Only utilization (through GPM) and memory are per MIG instance */
+static void
+limit_mig_metrics(GpuDevice *gpu)
+{
+    gpu->metrics_unsupported = (1 << GPU_METRIC_TEMPERATURE) | (1 << GPU_METRIC_POWER)
+                               | (1 << GPU_METRIC_INTERCONNECT) | (1 << GPU_METRIC_THROTTLE);
+    gpu->fields_unsupported = ~0u;
+    gpu->samples_unsupported = TRUE;
+}
+
+/* Allocate the double-buffered sample storage and the sampler's scratch */
+static void
+allocate_sample_buffers(void)
+{
+    sample_buffers[0] = g_new0(GpuSample, n_slots);
+    sample_buffers[1] = g_new0(GpuSample, n_slots);
+    sample_front = 0;
+    column_pass = g_new0(GpuColumnPass, n_slots);
+    reduce_util = g_new0(guchar, MAX(n_gpus, 1));
+    reduce_weight = g_new0(gdouble, MAX(n_gpus, 1));
+    proc_scratch = g_array_new(FALSE, TRUE, sizeof(GpuProcess));
+    comm_cache = g_hash_table_new(g_direct_hash, g_direct_equal);
+    for (gint slot = 0; slot < n_slots; slot++) {
+        sample_buffers[0][slot].total_memory = devices[slot].device_memory;
+    }
+}
+
+/* Describe a device in the fixed-width shared layout */
+static void
+describe_device(const GpuDevice *gpu, GpuSharedDevice *device)
+{
+    memset(device, 0, sizeof(GpuSharedDevice));
+    g_strlcpy(device->name, gpu->name, sizeof(device->name));
+    g_strlcpy(device->label, gpu->label, sizeof(device->label));
+    g_strlcpy(device->uuid, gpu->uuid, sizeof(device->uuid));
+    g_strlcpy(device->device_name, gpu->device_name, sizeof(device->device_name));
+    device->instance = gpu->instance;
+    device->mig_index = gpu->mig_index;
+    device->parent = gpu->parent ? gpu->parent->slot : -1;
+    device->n_children = gpu->n_children;
+    device->is_composite = gpu->is_composite;
+    device->n_nvlinks = gpu->n_nvlinks;
+    device->device_memory = gpu->device_memory;
+}
+
+/* Describe the GPUs in the shared segment, sized for them, and start
+ * publishing; on failure sample alone */
+static void
+publish_shared_devices(void)
+{
+    shared_header = gpu_shared_create(shared, n_slots);
+    if (!shared_header) {
+        gpu_shared_close(shared);
+        shared = NULL;
+        g_atomic_int_set(&shared_role, GPU_ROLE_ALONE);
+        return;
+    }
+    
+    shared_header->n_gpus = n_gpus;
+    for (gint slot = 0; slot < n_slots; slot++) {
+        describe_device(&devices[slot], &gpu_shared_devices(shared_header)[slot]);
+    }
+    gpu_shared_write_end(shared_header);
+}
+
+/* Copy a string field of the shared layout, which another user may have
+ * left unterminated */
+static void
+copy_shared_string(gchar *dest, gsize dest_size, const gchar *src, gsize src_size)
+{
+    gsize len = strnlen(src, MIN(src_size, dest_size - 1));
+    
+    memcpy(dest, src, len);
+    dest[len] = '\0';
+}
+
+/* Set up the devices another sampler describes, to be filled in from its
+ * snapshots */
+static void
+setup_described_devices(const GpuSharedDevice *described, gint count, gint role)
+{
+    const GpuSharedDevice *device;
+    GpuDevice *gpu;
+    
+    /* The GPUs are counted rather than taken from the sampler, as the
+     * composite's buffers are sized by them */
+    n_gpus = 0;
+    for (gint slot = 0; slot < count; slot++) {
+        if (!described[slot].is_composite
+            && !(described[slot].parent >= 0 && described[slot].parent < slot)) {
+            n_gpus++;
+        }
+    }
+    
+    allocate_devices(count);
+    for (gint slot = 0; slot < n_slots; slot++) {
+        gpu = &devices[slot];
+        device = &described[slot];
+        gpu->name = g_strndup(device->name, sizeof(device->name));
+        gpu->label = g_strndup(device->label, sizeof(device->label));
+        copy_shared_string(gpu->uuid, sizeof(gpu->uuid), device->uuid, sizeof(device->uuid));
+        copy_shared_string(gpu->device_name, sizeof(gpu->device_name),
+                           device->device_name, sizeof(device->device_name));
+        gpu->instance = device->instance;
+        gpu->mig_index = device->mig_index;
+        /* Counts index the devices and the link arrays, so they are
+         * bounded as for a GPU found through NVML */
+        gpu->n_children = CLAMP(device->n_children, 0, n_slots - slot - 1);
+        gpu->n_nvlinks = CLAMP(device->n_nvlinks, 0, GPU_MAX_NVLINKS);
+        gpu->device_memory = device->device_memory;
+        gpu->is_composite = device->is_composite;
+        if (gpu->is_composite) {
+            composite_device = gpu;
+        }
+        if (device->parent >= 0 && device->parent < slot) {
+            gpu->parent = &devices[device->parent];
+            limit_mig_metrics(gpu);
+        }
+    }
+    
+    allocate_sample_buffers();
+    shared_scratch = g_new0(GpuSharedSample, n_slots);
+    g_atomic_int_set(&shared_role, role);
+}
+
+/* Set up the GPUs the sampler describes in the shared segment, waiting
+ * for it to publish if it is starting too */
+static gboolean
+setup_shared_reader(void)
+{
+    const GpuSharedHeader *header = NULL;
+    GpuSharedDevice *described = NULL;
+    gint count = 0;
+    guint32 seq;
+    
+    for (gint waited = 0; !described && waited < GPU_SHARED_WAIT_MS; waited += 100) {
+        header = gpu_shared_map(shared);
+        if (header) {
+            seq = gpu_shared_read_begin(header);
+            count = __atomic_load_n(&header->n_slots, __ATOMIC_RELAXED);
+            if (gpu_shared_covers(shared, count)) {
+                described = g_new(GpuSharedDevice, count);
+                memcpy(described, gpu_shared_devices(header), count * sizeof(GpuSharedDevice));
+                if (gpu_shared_read_retry(header, seq)) {
+                    g_free(described);
+                    described = NULL;
+                }
+            }
+        }
+        if (!described) {
+            g_usleep(100 * 1000);
+        }
+    }
+    if (!described) {
+        return FALSE;
+    }
+    
+    setup_described_devices(described, count, GPU_ROLE_READER);
+    g_free(described);
+    return TRUE;
+}
+
+/* Initialize the sampling backend and detect GPUs.  GKrellM runs this on
+ * its init thread, as NVML init can take seconds without persistence
+ * mode. */
+gboolean
+gpu_sampler_init(void)
+{
+    GpuDevice *parent = NULL;
+    GArray *migs;
+    gint64 t_start, t_loaded, t_init;
+    
+    t_start = g_get_monotonic_time();
+    
+    /* Read what another GKrellM samples rather than sampling too */
+    if (g_strcmp0(g_getenv(GPU_SHARED_ENV), "1") == 0) {
+        shared = gpu_shared_open();
+        if (shared && gpu_shared_orphaned(shared)) {
+            g_warning("GPU plugin: nobody samples into another user's " GPU_SHARED_NAME
+                      ", sampling alone\n");
+            gpu_shared_close(shared);
+            shared = NULL;
+        }
+        if (shared && !gpu_shared_elect(shared)) {
+            if (setup_shared_reader()) {
+                g_debug("GPU plugin: reading %d GPUs from " GPU_SHARED_NAME " after %.1f ms\n",
+                        n_gpus, (g_get_monotonic_time() - t_start) / 1000.0);
+                return TRUE;
+            }
+            g_warning("GPU plugin: nothing published in " GPU_SHARED_NAME ", sampling alone\n");
+            gpu_shared_close(shared);
+            shared = NULL;
+        }
+        g_atomic_int_set(&shared_role, shared ? GPU_ROLE_SAMPLER : GPU_ROLE_ALONE);
+    }
+    
+    nvml = select_backend();
+    if (!nvml) {
+        return FALSE;
+    }
+    t_loaded = g_get_monotonic_time();
+    
+    nvmlReturn_t result = nvml->Init();
+    t_init = g_get_monotonic_time();
+    if (result != NVML_SUCCESS) {
+        g_warning("Failed to initialize NVML: %s\n", nvml->ErrorString(result));
+        return FALSE;
+    }
+    
+    /* Get the device count */
+    unsigned int deviceCount = 0;
+    result = nvml->DeviceGetCount(&deviceCount);
+    if (result != NVML_SUCCESS) {
+        g_warning("Failed to get device count: %s\n", nvml->ErrorString(result));
+        nvml->Shutdown();
+        return FALSE;
+    }
+    nvml_started = TRUE;
+    
+    n_gpus = deviceCount;
+    
+    /* One entry per GPU and per MIG device, plus a composite entry if
+     * there are several GPUs */
+    migs = enumerate_mig_devices();
+    allocate_devices((n_gpus > 1 ? n_gpus + 1 : n_gpus) + migs->len);
+    
+    for (gint slot = 0, m = 0, instance = 0; slot < n_slots; slot++) {
+        GpuDevice *gpu = &devices[slot];
+        
+        if (n_gpus > 1 && slot == 0) {
+            composite_device = gpu;
+            gpu->name = g_strdup("gpu");
+            gpu->label = g_strdup("GPU");
+            gpu->is_composite = TRUE;
+            gpu->instance = -1;
+        }
+        else if (parent && m < (gint) migs->len
+                 && g_array_index(migs, GpuMigRef, m).instance == parent->instance) {
+            /* MIG devices follow their GPU */
+            gpu->parent = parent;
+            gpu->instance = parent->instance;
+            gpu->mig_index = g_array_index(migs, GpuMigRef, m++).mig_index;
+            gpu->name = g_strdup_printf("gpu%dmig%d", gpu->instance, gpu->mig_index);
+            gpu->label = g_strdup_printf("MIG%d.%d", gpu->instance, gpu->mig_index);
+            limit_mig_metrics(gpu);
+            
+            if (!resolve_gpu_device(gpu)) {
+                g_warning("Failed to get handle for MIG device %d on GPU %d\n",
+                          gpu->mig_index, gpu->instance);
+            }
+        }
+        else {
+            parent = gpu;
+            gpu->instance = instance++;
+            gpu->name = g_strdup_printf("gpu%d", gpu->instance);
+            gpu->label = g_strdup_printf("GPU%d", gpu->instance);
+            for (gint j = m; j < (gint) migs->len; ++j) {
+                if (g_array_index(migs, GpuMigRef, j).instance == gpu->instance) {
+                    gpu->n_children++;
+                }
+            }
+            
+            if (!resolve_gpu_device(gpu)) {
+                g_warning("Failed to get handle for GPU %d\n", gpu->instance);
+            }
+        }
+    }
+    g_array_free(migs, TRUE);
+    allocate_sample_buffers();
+    
+    create_event_set();
+    if (shared) {
+        publish_shared_devices();
+    }
+    
+    g_debug("GPU plugin: library %.1f ms, NVML init %.1f ms, %d GPUs %.1f ms\n",
+            (t_loaded - t_start) / 1000.0, (t_init - t_loaded) / 1000.0,
+            n_gpus, (g_get_monotonic_time() - t_init) / 1000.0);
+    
+    return TRUE;
+}
+
+/* Register a GPU with the event set for the events it supports */
+static gboolean
+register_gpu_events(GpuDevice *gpu)
+{
+    unsigned long long types;
+    
+    if (gpu->is_composite || gpu->parent || !gpu->device_valid
+        || nvml->DeviceGetSupportedEventTypes(gpu->device, &types) != NVML_SUCCESS) {
+        return FALSE;
+    }
+    types &= GPU_EVENT_TYPES;
+    return types && nvml->DeviceRegisterEvents(gpu->device, types, event_set) == NVML_SUCCESS;
+}
+
+/* Register the GPUs for the events the sampler wakes up for.  A single
+ * set holds every GPU, because the sampler can only wait on one. */
+static void
+create_event_set(void)
+{
+    gint registered = 0;
+    
+    if (nvml->EventSetCreate(&event_set) != NVML_SUCCESS) {
+        event_set = NULL;
+        return;
+    }
+    for (gint slot = 0; slot < n_slots; slot++) {
+        if (register_gpu_events(&devices[slot])) {
+            registered++;
+        }
+    }
+    
+    if (registered == 0) {
+        nvml->EventSetFree(event_set);
+        event_set = NULL;
+    }
+}
+
+
+/* Add a utilization reading to the current pass */
+static void
+column_pass_add(GpuDevice *gpu, gulong utilization)
+{
+    GpuColumnPass *pass = &column_pass[gpu->slot];
+    
+    pass->sum += utilization;
+    pass->count++;
+    if (utilization > pass->peak) {
+        pass->peak = utilization;
+    }
+}
+
+/* Store a metric value obtained through the field value API */
+static void
+store_field_value(GpuDevice *gpu, GpuSample *sample, gint metric, gdouble value)
+{
+    switch (metric) {
+        case GPU_METRIC_UTILIZATION:
+            sample->utilization = (gulong) value;
+            column_pass_add(gpu, sample->utilization);
+            break;
+        case GPU_METRIC_MEMORY:
+            sample->used_memory = (gulong) value;
+            break;
+        case GPU_METRIC_TEMPERATURE:
+            sample->temperature = (gfloat) value;
+            break;
+        case GPU_METRIC_POWER:
+            sample->power = (gfloat) (value / 1000.0);
+            break;
+    }
+}
+
+/* Field id and scope of interconnect counter c */
+static unsigned int
+link_counter_field(gint c, unsigned int *scope)
+{
+    if (c < 2) {
+        *scope = 0;
+        return c == 0 ? GPU_PCIE_TX_FIELD : GPU_PCIE_RX_FIELD;
+    }
+    *scope = (c - 2) / 2;
+    return (c & 1) ? GPU_NVLINK_RX_FIELD : GPU_NVLINK_TX_FIELD;
+}
+
+/* Turn a reading of interconnect counter c into a rate, from the change
+ * since the previous reading over the driver's timestamps.  The first
+ * reading, and one after the counter went backwards, only restart it. */
+static void
+store_link_counter(GpuDevice *gpu, GpuSample *sample, gint c, const nvmlFieldValue_t *fv)
+{
+    GpuCounter *counter = &gpu->link_counters[c];
+    unsigned long long value;
+    gint64 timestamp = fv->timestamp > 0 ? fv->timestamp : g_get_real_time();
+    gdouble kib;
+    
+    if (fv->valueType == NVML_VALUE_TYPE_UNSIGNED_LONG_LONG) {
+        value = fv->value.ullVal;
+    }
+    else {
+        value = (unsigned long long) nvml_value_as_double(fv->valueType, &fv->value);
+    }
+    
+    if (counter->timestamp > 0 && timestamp > counter->timestamp && value >= counter->value) {
+        /* PCIe counts bytes, NVLink KiB */
+        kib = (gdouble) (value - counter->value) / (c < 2 ? 1024 : 1);
+        sample->link_rates[c] = (gulong) round(kib * G_USEC_PER_SEC
+                                               / (timestamp - counter->timestamp));
+    }
+    counter->value = value;
+    counter->timestamp = timestamp;
+    gpu->links_live = TRUE;
+}
+
+/* Read every due metric that has an NVML field id with a single
+ * nvmlDeviceGetFieldValues call.  The interconnect adds one value per
+ * counter to the same call.  Returns the mask of metrics read. */
+static guint
+read_gpu_fields(GpuDevice *gpu, GpuSample *sample, guint due)
+{
+    nvmlFieldValue_t values[N_GPU_METRICS + GPU_LINK_COUNTERS];
+    gint metrics[N_GPU_METRICS + GPU_LINK_COUNTERS];
+    gint counters[N_GPU_METRICS + GPU_LINK_COUNTERS]; /* Interconnect counter, -1 if none */
+    nvmlReturn_t result;
+    unsigned int field, scope;
+    guint done = 0;
+    gint i, c, first, n = 0;
+    
+    for (i = 0; i < N_GPU_METRICS; ++i) {
+        if (!(due & (1 << i)) || gpu_metric_schedule[i].field_id == 0
+            || (gpu->fields_unsupported & (1 << i))) {
+            continue;
+        }
+        if (i == GPU_METRIC_INTERCONNECT) {
+            first = n;
+            for (c = 0; c < 2 + 2 * gpu->n_nvlinks; ++c) {
+                field = link_counter_field(c, &scope);
+                if (field == 0 || (gpu->links_unsupported & ((guint64) 1 << c))) {
+                    continue;
+                }
+                memset(&values[n], 0, sizeof(nvmlFieldValue_t));
+                values[n].fieldId = field;
+                values[n].scopeId = scope;
+                counters[n] = c;
+                metrics[n++] = i;
+            }
+            if (n == first) {
+                gpu->fields_unsupported |= 1 << i;
+            }
+            continue;
+        }
+        memset(&values[n], 0, sizeof(nvmlFieldValue_t));
+        values[n].fieldId = gpu_metric_schedule[i].field_id;
+        counters[n] = -1;
+        metrics[n++] = i;
+    }
+    if (n == 0) {
+        return 0;
+    }
+    
+    nvml_calls_sample++;
+    result = nvml->DeviceGetFieldValues(gpu->device, n, values);
+    if (result != NVML_SUCCESS) {
+        if (result == NVML_ERROR_NOT_SUPPORTED || result == NVML_ERROR_FUNCTION_NOT_FOUND) {
+            /* No field support at all, use the per-metric calls from now on */
+            for (i = 0; i < n; ++i) {
+                gpu->fields_unsupported |= 1 << metrics[i];
+            }
+        }
+        else if (nvml_error_is_stale(result)) {
+            device_failed(gpu, result);
+        }
+        return 0;
+    }
+    
+    for (i = 0; i < n; ++i) {
+        if (values[i].nvmlReturn == NVML_SUCCESS) {
+            if (counters[i] >= 0) {
+                store_link_counter(gpu, sample, counters[i], &values[i]);
+            }
+            else {
+                store_field_value(gpu, sample, metrics[i], nvml_value_as_double(values[i].valueType, &values[i].value));
+            }
+            done |= 1 << metrics[i];
+        }
+        else if (values[i].nvmlReturn == NVML_ERROR_NOT_SUPPORTED) {
+            if (counters[i] >= 0) {
+                gpu->links_unsupported |= (guint64) 1 << counters[i];
+            }
+            else {
+                gpu->fields_unsupported |= 1 << metrics[i];
+            }
+        }
+    }
+    
+    return done;
+}
+
+/* Drain the driver's utilization sample buffer for a GPU.  Returns FALSE
+ * when the device cannot provide buffered samples. */
+static gboolean
+read_gpu_util_samples(GpuDevice *gpu, GpuSample *sample)
+{
+    nvmlReturn_t result;
+    nvmlValueType_t type;
+    unsigned int count;
+    
+    if (gpu->samples_unsupported) {
+        return FALSE;
+    }
+    
+    /* Size the buffer once with a query call */
+    if (!gpu->util_samples) {
+        nvml_calls_sample++;
+        result = nvml->DeviceGetSamples(gpu->device, NVML_GPU_UTILIZATION_SAMPLES,
+                                      0, &type, &count, NULL);
+        if (result != NVML_SUCCESS || count == 0) {
+            gpu->samples_unsupported = (result == NVML_SUCCESS
+                                        || result == NVML_ERROR_NOT_SUPPORTED);
+            if (nvml_error_is_stale(result)) {
+                device_failed(gpu, result);
+            }
+            return FALSE;
+        }
+        gpu->util_samples = g_new0(nvmlSample_t, count);
+        gpu->n_util_samples = count;
+    }
+    
+    nvml_calls_sample++;
+    count = gpu->n_util_samples;
+    result = nvml->DeviceGetSamples(gpu->device, NVML_GPU_UTILIZATION_SAMPLES,
+                                  gpu->last_sample_ts, &type, &count,
+                                  gpu->util_samples);
+    if (result == NVML_ERROR_NOT_FOUND) {
+        /* Nothing new since the last call */
+        return TRUE;
+    }
+    if (result != NVML_SUCCESS) {
+        if (result == NVML_ERROR_NOT_SUPPORTED) {
+            gpu->samples_unsupported = TRUE;
+        }
+        else if (nvml_error_is_stale(result)) {
+            device_failed(gpu, result);
+        }
+        return FALSE;
+    }
+    
+    for (guint i = 0; i < count; ++i) {
+        nvmlSample_t *s = &gpu->util_samples[i];
+        gulong value = (gulong) nvml_value_as_double(type, &s->sampleValue);
+        
+        if (s->timeStamp <= gpu->last_sample_ts) {
+            continue;
+        }
+        column_pass_add(gpu, value);
+        
+        /* The newest sample is the current utilization */
+        gpu->last_sample_ts = s->timeStamp;
+        sample->utilization = value;
+    }
+    
+    return TRUE;
+}
+
+/* Read the utilization of a MIG device from the GPM samples taken by
+ * this pass and the previous one.  Returns FALSE when GPM cannot
+ * provide it. */
+static gboolean
+read_mig_utilization(GpuDevice *gpu, GpuSample *sample)
+{
+    nvmlGpmMetricsGet_t metrics;
+    nvmlReturn_t result;
+    gint current = gpu->gpm_current;
+    
+    if (!gpu->parent->gpm_supported) {
+        return FALSE;
+    }
+    for (gint i = 0; i < 2; ++i) {
+        if (!gpu->gpm_samples[i] && nvml->GpmSampleAlloc(&gpu->gpm_samples[i]) != NVML_SUCCESS) {
+            return FALSE;
+        }
+    }
+    
+    nvml_calls_sample++;
+    result = nvml->GpmMigSampleGet(gpu->parent->device, gpu->gpu_instance_id,
+                                   gpu->gpm_samples[current]);
+    if (result != NVML_SUCCESS) {
+        gpu->gpm_primed = FALSE;
+        if (nvml_error_is_stale(result)) {
+            device_failed(gpu, result);
+        }
+        return result != NVML_ERROR_NOT_SUPPORTED;
+    }
+    gpu->gpm_current = 1 - current;
+    
+    /* The first sample only starts the interval */
+    if (!gpu->gpm_primed) {
+        gpu->gpm_primed = TRUE;
+        return TRUE;
+    }
+    
+    memset(&metrics, 0, sizeof(metrics));
+    metrics.version = NVML_GPM_METRICS_GET_VERSION;
+    metrics.numMetrics = 1;
+    metrics.sample1 = gpu->gpm_samples[1 - current];
+    metrics.sample2 = gpu->gpm_samples[current];
+    metrics.metrics[0].metricId = NVML_GPM_METRIC_GRAPHICS_UTIL;
+    
+    nvml_calls_sample++;
+    result = nvml->GpmMetricsGet(&metrics);
+    if (result == NVML_SUCCESS && metrics.metrics[0].nvmlReturn == NVML_SUCCESS) {
+        sample->utilization = (gulong) round(metrics.metrics[0].value);
+        column_pass_add(gpu, sample->utilization);
+    }
+    
+    return TRUE;
+}
+
+/* Read the command name of a process */
+static gboolean
+read_proc_comm(guint pid, gchar *comm)
+{
+    gchar path[32];
+    FILE *f;
+    size_t n;
+    
+    g_snprintf(path, sizeof(path), "/proc/%u/comm", pid);
+    f = fopen(path, "r");
+    if (!f) {
+        return FALSE;
+    }
+    n = fread(comm, 1, GPU_COMM_LEN - 1, f);
+    fclose(f);
+    
+    /* The name ends with a newline */
+    while (n > 0 && comm[n - 1] == '\n') {
+        n--;
+    }
+    comm[n] = '\0';
+    
+    return n > 0;
+}
+
+/* Return the command name of a PID.  /proc is only read for a PID that
+ * is not cached, or that the previous process pass did not list: a PID
+ * listed all along cannot have been reused, while one that went away may
+ * now belong to another process and is read again.  A process outside
+ * our PID namespace is shown by its PID. */
+static const gchar *
+resolve_process_name(guint pid)
+{
+    GpuCommEntry *entry;
+    
+    entry = g_hash_table_lookup(comm_cache, GUINT_TO_POINTER(pid));
+    if (entry) {
+        g_queue_unlink(&comm_lru, &entry->link);
+        if (entry->seen + 1 >= comm_pass) {
+            entry->seen = comm_pass;
+            g_queue_push_head_link(&comm_lru, &entry->link);
+            return entry->comm;
+        }
+    }
+    else if (g_queue_get_length(&comm_lru) >= GPU_COMM_CACHE_SIZE) {
+        /* Recycle the least recently used entry */
+        entry = g_queue_peek_tail(&comm_lru);
+        g_queue_unlink(&comm_lru, &entry->link);
+        g_hash_table_remove(comm_cache, GUINT_TO_POINTER(entry->pid));
+    }
+    else {
+        entry = g_new0(GpuCommEntry, 1);
+        entry->link.data = entry;
+    }
+    
+    if (!read_proc_comm(pid, entry->comm)) {
+        g_snprintf(entry->comm, sizeof(entry->comm), "%u", pid);
+    }
+    entry->pid = pid;
+    entry->seen = comm_pass;
+    g_hash_table_replace(comm_cache, GUINT_TO_POINTER(pid), entry);
+    g_queue_push_head_link(&comm_lru, &entry->link);
+    
+    return entry->comm;
+}
+
+/* Find a process in proc_scratch, adding it if it is not there yet */
+static GpuProcess *
+scratch_process(guint pid)
+{
+    GpuProcess *proc;
+    
+    for (guint i = 0; i < proc_scratch->len; ++i) {
+        proc = &g_array_index(proc_scratch, GpuProcess, i);
+        if (proc->pid == pid) {
+            return proc;
+        }
+    }
+    g_array_set_size(proc_scratch, proc_scratch->len + 1);
+    proc = &g_array_index(proc_scratch, GpuProcess, proc_scratch->len - 1);
+    proc->pid = pid;
+    
+    return proc;
+}
+
+/* Add the processes from one of the running process calls to
+ * proc_scratch, growing the buffer when NVML says it is too small.  A
+ * process on both the compute and the graphics list is only added once. */
+static nvmlReturn_t
+read_running_processes(GpuDevice *gpu,
+                       nvmlReturn_t (*list)(nvmlDevice_t, unsigned int *, nvmlProcessInfo_t *))
+{
+    nvmlReturn_t result = NVML_SUCCESS;
+    nvmlProcessInfo_t *info;
+    GpuProcess *proc;
+    unsigned int count = 0;
+    gulong memory;
+    
+    for (gint attempt = 0; attempt < 2; ++attempt) {
+        count = gpu->n_proc_info;
+        nvml_calls_sample++;
+        result = list(gpu->device, &count, gpu->proc_info);
+        if (result != NVML_ERROR_INSUFFICIENT_SIZE) {
+            break;
+        }
+        /* Leave room for processes started in the meantime */
+        gpu->n_proc_info = count + 8;
+        gpu->proc_info = g_renew(nvmlProcessInfo_t, gpu->proc_info, gpu->n_proc_info);
+    }
+    if (result != NVML_SUCCESS) {
+        return result;
+    }
+    
+    for (guint i = 0; i < count; ++i) {
+        info = &gpu->proc_info[i];
+        memory = info->usedGpuMemory == (unsigned long long) NVML_VALUE_NOT_AVAILABLE
+                 ? 0 : info->usedGpuMemory;
+        proc = scratch_process(info->pid);
+        proc->used_memory = MAX(proc->used_memory, memory);
+    }
+    
+    return NVML_SUCCESS;
+}
+
+/* Set the SM utilization of the processes in proc_scratch to the highest
+ * sample since the previous call.  NOT_FOUND means no process used the
+ * SMs in between. */
+static nvmlReturn_t
+read_process_utilization(GpuDevice *gpu)
+{
+    nvmlReturn_t result = NVML_SUCCESS;
+    nvmlProcessUtilizationSample_t *s;
+    GpuProcess *proc;
+    unsigned long long newest = gpu->last_proc_util_ts;
+    unsigned int count = 0;
+    
+    for (gint attempt = 0; attempt < 2; ++attempt) {
+        count = gpu->n_proc_util;
+        nvml_calls_sample++;
+        result = nvml->DeviceGetProcessUtilization(gpu->device, gpu->proc_util, &count,
+                                                   gpu->last_proc_util_ts);
+        if (result != NVML_ERROR_INSUFFICIENT_SIZE) {
+            break;
+        }
+        gpu->n_proc_util = count + 8;
+        gpu->proc_util = g_renew(nvmlProcessUtilizationSample_t, gpu->proc_util,
+                                 gpu->n_proc_util);
+    }
+    if (result != NVML_SUCCESS) {
+        return result;
+    }
+    
+    for (guint i = 0; i < count; ++i) {
+        s = &gpu->proc_util[i];
+        if (s->timeStamp <= gpu->last_proc_util_ts) {
+            continue;
+        }
+        proc = scratch_process(s->pid);
+        proc->sm_util = MAX(proc->sm_util, MIN(s->smUtil, 100));
+        newest = MAX(newest, s->timeStamp);
+    }
+    gpu->last_proc_util_ts = newest;
+    
+    return NVML_SUCCESS;
+}
+
+/* Order processes by GPU memory, then SM utilization, busiest first */
+static gint
+compare_processes(gconstpointer a, gconstpointer b)
+{
+    const GpuProcess *pa = a, *pb = b;
+    
+    if (pa->used_memory != pb->used_memory) {
+        return pa->used_memory < pb->used_memory ? 1 : -1;
+    }
+    if (pa->sm_util != pb->sm_util) {
+        return pa->sm_util < pb->sm_util ? 1 : -1;
+    }
+    return (pa->pid > pb->pid) - (pa->pid < pb->pid);
+}
+
+/* Sort proc_scratch and publish its top processes in a sample, naming
+ * only those that are shown */
+static void
+publish_processes(GpuSample *sample)
+{
+    GpuProcess *proc;
+    
+    g_array_sort(proc_scratch, compare_processes);
+    sample->procs_total = proc_scratch->len;
+    sample->n_procs = MIN((gint) proc_scratch->len, GPU_TOP_PROCESSES);
+    for (gint i = 0; i < sample->n_procs; ++i) {
+        proc = &g_array_index(proc_scratch, GpuProcess, i);
+        if (proc->comm[0] == '\0') {
+            g_strlcpy(proc->comm, resolve_process_name(proc->pid), GPU_COMM_LEN);
+        }
+        sample->procs[i] = *proc;
+    }
+    sample->procs_serial++;
+}
+
+/* Read the processes running on a GPU with their memory and SM use */
+static void
+read_gpu_processes(GpuDevice *gpu, GpuSample *sample)
+{
+    nvmlReturn_t compute, graphics, util;
+    
+    g_array_set_size(proc_scratch, 0);
+    
+    compute = read_running_processes(gpu, nvml->DeviceGetComputeRunningProcesses);
+    if (nvml_error_is_stale(compute)) {
+        device_failed(gpu, compute);
+        return;
+    }
+    graphics = read_running_processes(gpu, nvml->DeviceGetGraphicsRunningProcesses);
+    if (compute == NVML_ERROR_NOT_SUPPORTED && graphics == NVML_ERROR_NOT_SUPPORTED) {
+        gpu->metrics_unsupported |= 1 << GPU_METRIC_PROCESSES;
+        return;
+    }
+    
+    /* Without per process utilization the list is by memory only */
+    util = read_process_utilization(gpu);
+    if (nvml_error_is_stale(graphics)
+        || (util != NVML_ERROR_NOT_FOUND && nvml_error_is_stale(util))) {
+        device_failed(gpu, nvml_error_is_stale(graphics) ? graphics : util);
+        return;
+    }
+    
+    publish_processes(sample);
+}
+
+/* Read a single metric with its dedicated NVML call */
+static void
+read_gpu_metric(GpuDevice *gpu, GpuSample *sample, gint metric)
+{
+    nvmlReturn_t result = NVML_SUCCESS;
+    nvmlUtilization_t utilization;
+    nvmlMemory_t memory;
+    unsigned int value;
+    unsigned long long reasons;
+    
+    /* MIG devices only report utilization through GPM */
+    if (metric == GPU_METRIC_UTILIZATION && gpu->parent) {
+        if (!read_mig_utilization(gpu, sample)) {
+            gpu->metrics_unsupported |= 1 << metric;
+        }
+        return;
+    }
+    
+    if (metric == GPU_METRIC_PROCESSES) {
+        read_gpu_processes(gpu, sample);
+        return;
+    }
+    
+    /* Interconnect counters are only available as field values */
+    if (metric == GPU_METRIC_INTERCONNECT) {
+        if (gpu->fields_unsupported & (1 << metric)) {
+            gpu->metrics_unsupported |= 1 << metric;
+        }
+        return;
+    }
+    
+    /* Prefer the driver's sample buffer so short bursts are seen */
+    if (metric == GPU_METRIC_UTILIZATION && g_atomic_int_get(&gpu_buffered_utilization)) {
+        if (read_gpu_util_samples(gpu, sample) || !gpu->device_valid) {
+            return;
+        }
+    }
+    
+    nvml_calls_sample++;
+    switch (metric) {
+        case GPU_METRIC_UTILIZATION:
+            /* Get utilization rates - this is in percent (0-100) */
+            result = nvml->DeviceGetUtilizationRates(gpu->device, &utilization);
+            if (result == NVML_SUCCESS) {
+                sample->utilization = utilization.gpu;
+                column_pass_add(gpu, utilization.gpu);
+            }
+            break;
+        case GPU_METRIC_MEMORY:
+            result = nvml->DeviceGetMemoryInfo(gpu->device, &memory);
+            if (result == NVML_SUCCESS) {
+                sample->used_memory = memory.used;
+            }
+            break;
+        case GPU_METRIC_TEMPERATURE:
+            result = nvml->DeviceGetTemperature(gpu->device, NVML_TEMPERATURE_GPU, &value);
+            if (result == NVML_SUCCESS) {
+                sample->temperature = (gfloat) value;
+            }
+            break;
+        case GPU_METRIC_POWER:
+            /* Power is reported in milliwatts */
+            result = nvml->DeviceGetPowerUsage(gpu->device, &value);
+            if (result == NVML_SUCCESS) {
+                sample->power = (gfloat) value / 1000.0;
+            }
+            break;
+        case GPU_METRIC_THROTTLE:
+            result = nvml->DeviceGetCurrentClocksThrottleReasons(gpu->device, &reasons);
+            if (result == NVML_SUCCESS) {
+                sample->throttle_reasons = (guint) reasons;
+            }
+            break;
+    }
+    
+    if (result == NVML_ERROR_NOT_SUPPORTED) {
+        /* Do not ask again, e.g. for the utilization of a GPU in MIG mode */
+        gpu->metrics_unsupported |= 1 << metric;
+    }
+    else if (nvml_error_is_stale(result)) {
+        device_failed(gpu, result);
+    }
+}
+
+/* A GPU in MIG mode has no utilization of its own, so use the mean of
+ * its MIG devices weighted by their memory, which follows the slice size */
+static void
+roll_up_mig_utilization(GpuDevice *gpu, GpuSample *samples)
+{
+    GpuDevice *child;
+    gdouble sum = 0.0, weight = 0.0, w;
+    
+    for (gint i = 1; i <= gpu->n_children; ++i) {
+        child = &devices[gpu->slot + i];
+        if (child->metrics_unsupported & (1 << GPU_METRIC_UTILIZATION)) {
+            continue;
+        }
+        w = child->device_memory > 0 ? (gdouble) child->device_memory : 1.0;
+        sum += samples[child->slot].utilization * w;
+        weight += w;
+    }
+    
+    if (weight > 0) {
+        samples[gpu->slot].utilization = (gulong) round(sum / weight);
+        column_pass_add(gpu, samples[gpu->slot].utilization);
+    }
+}
+
+/* Reduce the first n packed utilizations in reduce_util every way in a
+ * single pass.  The utilizations are whole percents, so a 101 bin
+ * histogram gives the 90th percentile without sorting. */
+static void
+reduce_utilization(gint n, GpuReduction *out)
+{
+    guint histogram[101];
+    gdouble sum = 0.0, weighted = 0.0, weight = 0.0;
+    guint u, lowest = 100, highest = 0, rank, seen = 0;
+    
+    memset(out, 0, sizeof(GpuReduction));
+    if (n == 0) {
+        return;
+    }
+    memset(histogram, 0, sizeof(histogram));
+    
+    for (gint i = 0; i < n; ++i) {
+        u = reduce_util[i];
+        sum += u;
+        weighted += u * reduce_weight[i];
+        weight += reduce_weight[i];
+        lowest = MIN(lowest, u);
+        highest = MAX(highest, u);
+        if (u > GPU_IDLE_UTILIZATION) {
+            out->busy++;
+        }
+        histogram[u]++;
+    }
+    
+    /* Nearest rank: the lowest value with 90% of the GPUs at or below it */
+    rank = (90 * n + 99) / 100;
+    for (u = 0; u < 100; ++u) {
+        seen += histogram[u];
+        if (seen >= rank) {
+            break;
+        }
+    }
+    
+    out->n = n;
+    out->value[GPU_REDUCE_MEAN] = (gulong) round(sum / n);
+    out->value[GPU_REDUCE_WEIGHTED] = weight > 0 ? (gulong) round(weighted / weight)
+                                                 : out->value[GPU_REDUCE_MEAN];
+    out->value[GPU_REDUCE_MIN] = lowest;
+    out->value[GPU_REDUCE_MAX] = highest;
+    out->value[GPU_REDUCE_P90] = u;
+}
+
+/* Resolve a device that is not valid, if its retry is due.  Each retry
+ * doubles the wait for the next one, up to GPU_RETRY_MAX_MS. */
+static gboolean
+recover_gpu_device(GpuDevice *gpu, gint64 now)
+{
+    if (gpu->state != GPU_HEALTH_OK) {
+        if (now < gpu->retry_at) {
+            return FALSE;
+        }
+        gpu->retry_ms = MIN(gpu->retry_ms * 2, GPU_RETRY_MAX_MS);
+        gpu->retry_at = now + (gint64) gpu->retry_ms * 1000;
+    }
+    if (!resolve_gpu_device(gpu)) {
+        device_failed(gpu, gpu->last_error);
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/* A device that was down made it through a pass: sample it normally
+ * again and have it wake the sampler on events */
+static void
+device_recovered(GpuDevice *gpu)
+{
+    g_message("GPU plugin: %s recovered\n", gpu->label);
+    gpu->state = GPU_HEALTH_OK;
+    gpu->retry_ms = 0;
+    gpu->gpm_primed = FALSE;
+    memset(gpu->link_counters, 0, sizeof(gpu->link_counters));
+    
+    if (gpu->parent) {
+        return;
+    }
+    if (event_set) {
+        register_gpu_events(gpu);
+    }
+    else {
+        create_event_set();
+    }
+}
+
+/* With every GPU down the driver itself may have gone away, say for a
+ * module reload, so NVML is restarted now and then.  Every handle, the
+ * event set included, dies with it. */
+static void
+restart_nvml(gint64 now)
+{
+    GpuDevice *gpu;
+    nvmlReturn_t result;
+    
+    for (gint slot = 0; slot < n_slots; slot++) {
+        gpu = &devices[slot];
+        if (!gpu->is_composite && !gpu->parent && gpu->state == GPU_HEALTH_OK) {
+            nvml_restart_ms = 0;
+            return;
+        }
+    }
+    if (nvml_restart_ms == 0) {
+        nvml_restart_ms = GPU_RESTART_MIN_MS;
+        nvml_restart_at = now + (gint64) nvml_restart_ms * 1000;
+        return;
+    }
+    if (now < nvml_restart_at) {
+        return;
+    }
+    nvml_restart_ms = MIN(nvml_restart_ms * 2, GPU_RESTART_MAX_MS);
+    nvml_restart_at = now + (gint64) nvml_restart_ms * 1000;
+    
+    g_message("GPU plugin: all GPUs are down, restarting NVML\n");
+    if (event_set) {
+        nvml->EventSetFree(event_set);
+        event_set = NULL;
+    }
+    event_set_failed = FALSE;
+    nvml->Shutdown();
+    result = nvml->Init();
+    if (result != NVML_SUCCESS) {
+        g_warning("GPU plugin: NVML restart failed: %s\n", nvml->ErrorString(result));
+        return;
+    }
+    
+    /* Resolve every device again in this pass */
+    for (gint slot = 0; slot < n_slots; slot++) {
+        devices[slot].device_valid = FALSE;
+        devices[slot].retry_at = now;
+    }
+}
+
+/* The value an alert rule looks at */
+static gdouble
+alert_value(const GpuSample *sample, gint alert)
+{
+    switch (alert) {
+        case GPU_ALERT_UTILIZATION:
+            return sample->utilization;
+        case GPU_ALERT_MEMORY:
+            return sample->total_memory > 0
+                   ? 100.0 * sample->used_memory / sample->total_memory : 0.0;
+        case GPU_ALERT_TEMPERATURE:
+            return sample->temperature;
+        case GPU_ALERT_POWER:
+            return sample->power;
+        case GPU_ALERT_THROTTLE:
+            return (sample->throttle_reasons & GPU_THROTTLE_LIMITING) ? 1.0 : 0.0;
+    }
+    return 0.0;
+}
+
+/* Raise or clear the alerts of a device on its latest sample.  The
+ * condition that changes an alert has to hold for the rule's dwell time,
+ * and an alert clears at a lower limit than it is raised at, so a value
+ * hovering around a limit does not make it flap.  A device that is down
+ * has its alerts cleared; its health says what is wrong. */
+static void
+evaluate_alerts(GpuDevice *gpu, GpuSample *sample, gint64 now)
+{
+    GpuAlertRule *rule;
+    gboolean raised, holds;
+    gdouble value;
+    gint raise_at;
+    
+    for (gint a = 0; a < N_GPU_ALERTS; ++a) {
+        rule = &gpu_alert_rules[a];
+        if (!g_atomic_int_get(&rule->enabled) || sample->health != GPU_HEALTH_OK) {
+            sample->alerts &= ~(1u << a);
+            gpu->alert_since[a] = 0;
+            continue;
+        }
+        
+        raised = (sample->alerts & (1u << a)) != 0;
+        value = alert_value(sample, a);
+        raise_at = g_atomic_int_get(&rule->raise_at);
+        holds = raised ? value < MIN(g_atomic_int_get(&rule->clear_at), raise_at)
+                       : value >= raise_at;
+        if (!holds) {
+            gpu->alert_since[a] = 0;
+            continue;
+        }
+        if (!gpu->alert_since[a]) {
+            gpu->alert_since[a] = now;
+        }
+        if (now - gpu->alert_since[a]
+            >= (gint64) g_atomic_int_get(&rule->dwell_s) * G_USEC_PER_SEC) {
+            sample->alerts ^= 1u << a;
+            gpu->alert_since[a] = 0;
+        }
+    }
+}
+
+/* Read the due metrics from all GPUs using NVML into the given sample
+ * buffer, and more from a GPU an event asked to resample.  This runs on
+ * the sampler thread and must not touch any GTK/GKrellM state. */
+static void
+read_gpu_data(GpuSample *samples, guint due)
+{
+    GpuDevice *gpu;
+    GpuSample *sample, *composite = NULL;
+    guint wanted, done, forced;
+    gint i, n_reduced = 0, total;
+    gint64 now = g_get_monotonic_time();
+    gboolean serving = g_atomic_int_get(&shared_role) == GPU_ROLE_SAMPLER;
+    
+    nvml_calls_sample = 0;
+    nvml_calls_sample_unbatched = 0;
+    
+    if (n_gpus > 0) {
+        restart_nvml(now);
+    }
+    
+    /* Reset composite GPU stats */
+    if (composite_device) {
+        composite = &samples[composite_device->slot];
+        composite->utilization = 0;
+        composite->total_memory = 0;
+        composite->used_memory = 0;
+        composite->temperature = 0.0;
+        composite->power = 0.0;
+        composite->throttle_reasons = 0;
+        composite->link_rates[0] = composite->link_rates[1] = 0;
+    }
+    if (due & (1 << GPU_METRIC_PROCESSES)) {
+        comm_pass++;
+    }
+    
+    /* Loop over all GPUs found */
+    for (gint slot = 0; slot < n_slots; slot++) {
+        gpu = &devices[slot];
+        
+        /* Skip composite GPU */
+        if (gpu->instance < 0) {
+            continue;
+        }
+        sample = &samples[gpu->slot];
+        forced = gpu->resample ? GPU_RESAMPLE_METRICS : 0;
+        gpu->resample = FALSE;
+            
+        /* Re-resolve the device handle only after an NVML error, and
+         * while it keeps failing only as often as its backoff allows.
+         * Meanwhile it reads as idle and empty. */
+        if (!gpu->device_valid && !recover_gpu_device(gpu, now)) {
+            sample->health = gpu->state;
+            sample->utilization = 0;
+            sample->used_memory = 0;
+            sample->power = 0.0;
+            sample->throttle_reasons = 0;
+            memset(sample->link_rates, 0, sizeof(sample->link_rates));
+            if (sample->procs_total > 0) {
+                sample->n_procs = sample->procs_total = 0;
+                sample->procs_serial++;
+            }
+            continue;
+        }
+        sample->total_memory = gpu->device_memory;
+        
+        /* Only read the temperature if it is displayed or alerted on,
+         * unless sampling for other instances too */
+        wanted = (due | forced) & ~gpu->metrics_unsupported;
+        if (!g_atomic_int_get(&gpu->want_temperature) && !serving
+            && !g_atomic_int_get(&gpu_alert_rules[GPU_ALERT_TEMPERATURE].enabled)) {
+            wanted &= ~(1 << GPU_METRIC_TEMPERATURE);
+        }
+        
+        /* Interconnect counters only while charted; restart the rates
+         * when they are charted again */
+        if (!g_atomic_int_get(&gpu_show_interconnect) && !serving) {
+            wanted &= ~(1 << GPU_METRIC_INTERCONNECT);
+            if (gpu->links_live) {
+                memset(gpu->link_counters, 0, sizeof(gpu->link_counters));
+                memset(sample->link_rates, 0, sizeof(sample->link_rates));
+                gpu->links_live = FALSE;
+            }
+        }
+        
+        /* Batch what we can, then fall back to one call per metric */
+        done = read_gpu_fields(gpu, sample, wanted);
+        for (i = 0; i < N_GPU_METRICS; ++i) {
+            if (!(wanted & (1 << i))) {
+                continue;
+            }
+            nvml_calls_sample_unbatched++;
+            if (!(done & (1 << i)) && gpu->device_valid) {
+                read_gpu_metric(gpu, sample, i);
+            }
+        }
+        
+        /* A MIG device runs at the temperature of its GPU */
+        if (gpu->parent) {
+            sample->temperature = samples[gpu->parent->slot].temperature;
+        }
+        
+        if (gpu->device_valid && gpu->state != GPU_HEALTH_OK) {
+            device_recovered(gpu);
+        }
+        sample->health = gpu->state;
+    }
+    
+    /* Fill in GPUs in MIG mode, then build the composite from the
+     * enabled GPUs, packing their utilization for the reductions */
+    for (gint slot = 0; slot < n_slots; slot++) {
+        gpu = &devices[slot];
+        if (gpu->is_composite || gpu->parent) {
+            continue;
+        }
+        sample = &samples[gpu->slot];
+        
+        if (gpu->n_children > 0 && (due & (1 << GPU_METRIC_UTILIZATION))
+            && (gpu->metrics_unsupported & (1 << GPU_METRIC_UTILIZATION))) {
+            roll_up_mig_utilization(gpu, samples);
+        }
+        
+        if (composite && gpu->enabled && gpu->state == GPU_HEALTH_OK) {
+            reduce_util[n_reduced] = (guchar) MIN(sample->utilization, 100);
+            reduce_weight[n_reduced++] = (gdouble) sample->used_memory;
+            composite->total_memory += sample->total_memory;
+            composite->used_memory += sample->used_memory;
+            composite->power += sample->power;
+            composite->throttle_reasons |= sample->throttle_reasons;
+            composite->link_rates[0] += sample->link_rates[0];
+            composite->link_rates[1] += sample->link_rates[1];
+            if (sample->temperature > composite->temperature) {
+                composite->temperature = sample->temperature;
+            }
+        }
+    }
+    
+    if (composite) {
+        reduce_utilization(n_reduced, &composite->reduction);
+        composite->utilization =
+            composite->reduction.value[g_atomic_int_get(&gpu_composite_reduction)];
+    }
+    
+    /* The composite lists the top processes of the enabled GPUs, adding
+     * up the memory of a process that uses several */
+    if (composite && (due & (1 << GPU_METRIC_PROCESSES))) {
+        g_array_set_size(proc_scratch, 0);
+        total = 0;
+        for (gint slot = 0; slot < n_slots; slot++) {
+            gpu = &devices[slot];
+            if (gpu->is_composite || gpu->parent || !gpu->enabled) {
+                continue;
+            }
+            sample = &samples[gpu->slot];
+            for (i = 0; i < sample->n_procs; ++i) {
+                GpuProcess *proc = scratch_process(sample->procs[i].pid);
+                
+                proc->used_memory += sample->procs[i].used_memory;
+                proc->sm_util = MAX(proc->sm_util, sample->procs[i].sm_util);
+                g_strlcpy(proc->comm, sample->procs[i].comm, GPU_COMM_LEN);
+            }
+            total += sample->procs_total;
+        }
+        publish_processes(composite);
+        composite->procs_total = total;
+    }
+    
+    for (gint slot = 0; slot < n_slots; slot++) {
+        evaluate_alerts(&devices[slot], &samples[slot], now);
+    }
+    
+    /* Report the NVML call count whenever it changes */
+    if (nvml_calls_sample != nvml_calls_last) {
+        g_debug("GPU plugin: %u NVML calls per sample (%u without batching)\n",
+                nvml_calls_sample, nvml_calls_sample_unbatched);
+        nvml_calls_last = nvml_calls_sample;
+    }
+    g_atomic_int_add(&gpu_nvml_calls_total, nvml_calls_sample);
+}
+
+/* The chart marks of the throttle reasons a GPU reads */
+static guint
+throttle_marks(guint reasons)
+{
+    guint marks = 0;
+    
+    for (gint c = 0; c < N_GPU_THROTTLE; ++c) {
+        if (reasons & gpu_throttle_categories[c].reasons) {
+            marks |= gpu_throttle_categories[c].mark;
+        }
+    }
+    return marks;
+}
+
+/* Fold the utilization readings of a pass into the chart column stats.
+ * Called with sampler_lock held, just before the back buffer is
+ * published; if the UI took the previous column the stats start over. */
+static void
+merge_column_pass(GpuSample *samples)
+{
+    gint i;
+    GpuDevice *gpu;
+    GpuSample *sample, *composite = NULL;
+    GpuColumnPass *pass;
+    GpuReduction reduction;
+    gboolean restart = (column_epoch != column_epoch_seen);
+    gint n = 0;
+    
+    column_epoch_seen = column_epoch;
+    
+    if (composite_device) {
+        composite = &samples[composite_device->slot];
+        composite->column_peak = 0;
+        composite->column_events = 0;
+        composite->xid_count = 0;
+        composite->last_xid = 0;
+    }
+    
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &devices[i];
+        if (gpu->is_composite) {
+            continue;
+        }
+        sample = &samples[gpu->slot];
+        pass = &column_pass[gpu->slot];
+        
+        if (restart) {
+            sample->column_sum = 0.0;
+            sample->column_count = 0;
+            sample->column_peak = 0;
+            sample->column_events = 0;
+        }
+        sample->column_events |= pass->events | throttle_marks(sample->throttle_reasons);
+        sample->xid_count += pass->xids;
+        if (pass->xids > 0) {
+            sample->last_xid = pass->last_xid;
+        }
+        sample->column_sum += pass->sum;
+        sample->column_count += pass->count;
+        sample->util_sum_total += pass->sum;
+        sample->util_count_total += pass->count;
+        if (pass->peak > sample->column_peak) {
+            sample->column_peak = pass->peak;
+        }
+        memset(pass, 0, sizeof(GpuColumnPass));
+        
+        /* The composite column reduces the GPU means the same way as
+         * the utilization and has the highest GPU peak; MIG devices are
+         * already in their GPU's */
+        if (composite && !gpu->parent && gpu->enabled && sample->column_count > 0) {
+            reduce_util[n] = (guchar) MIN(round(sample->column_sum / sample->column_count), 100);
+            reduce_weight[n++] = (gdouble) sample->used_memory;
+            if (sample->column_peak > composite->column_peak) {
+                composite->column_peak = sample->column_peak;
+            }
+        }
+        if (composite && !gpu->parent && gpu->enabled) {
+            composite->column_events |= sample->column_events;
+            composite->xid_count += sample->xid_count;
+            if (sample->last_xid) {
+                composite->last_xid = sample->last_xid;
+            }
+        }
+    }
+    
+    if (composite) {
+        reduce_utilization(n, &reduction);
+        composite->column_sum = reduction.value[g_atomic_int_get(&gpu_composite_reduction)];
+        composite->column_count = n > 0 ? 1 : 0;
+    }
+}
+
+/* Work out which metrics are due at time now */
+static guint
+schedule_due_metrics(gint64 now)
+{
+    guint due = 0;
+    
+    for (gint i = 0; i < N_GPU_METRICS; ++i) {
+        if (now >= gpu_metric_schedule[i].next_due) {
+            due |= 1 << i;
+        }
+    }
+    
+    return due;
+}
+
+/* Reschedule the metrics just sampled and return the next wake up time */
+static gint64
+schedule_next_wake(gint64 now, guint sampled)
+{
+    gint64 interval, wake_time = G_MAXINT64;
+    
+    for (gint i = 0; i < N_GPU_METRICS; ++i) {
+        if (sampled & (1 << i)) {
+            interval = (gint64) g_atomic_int_get(&gpu_metric_schedule[i].interval_ms)
+                       * sample_backoff * G_TIME_SPAN_MILLISECOND;
+            gpu_metric_schedule[i].next_due = now + interval;
+        }
+        if (gpu_metric_schedule[i].next_due < wake_time) {
+            wake_time = gpu_metric_schedule[i].next_due;
+        }
+    }
+    
+    return wake_time;
+}
+
+/* Back off sampling while every GPU stays idle, and snap back to the
+ * configured rates as soon as any of them gets busy */
+static void
+update_sample_backoff(const GpuSample *samples, gint64 now)
+{
+    gint i;
+    GpuDevice *gpu;
+    gboolean idle = TRUE;
+    
+    for (i = 0; i < n_slots; ++i) {
+        gpu = &devices[i];
+        if (!gpu->is_composite && samples[gpu->slot].utilization > GPU_IDLE_UTILIZATION) {
+            idle = FALSE;
+            break;
+        }
+    }
+    
+    if (!idle || !g_atomic_int_get(&gpu_idle_backoff)) {
+        idle_since = 0;
+        sample_backoff = 1;
+        return;
+    }
+    
+    if (idle_since == 0) {
+        idle_since = now;
+    }
+    else if (now - idle_since >= GPU_IDLE_HOLDOFF_MS * G_TIME_SPAN_MILLISECOND) {
+        /* Double the intervals for every hold off period spent idle */
+        if (sample_backoff < GPU_MAX_BACKOFF) {
+            sample_backoff *= 2;
+        }
+        idle_since = now;
+    }
+}
+
+/* Note an event against the GPU it came from, for the next chart column.
+ * TRUE if the event has the GPU sampled again. */
+static gboolean
+record_event(const nvmlEventData_t *data)
+{
+    GpuDevice *gpu;
+    GpuColumnPass *pass;
+    
+    for (gint slot = 0; slot < n_slots; slot++) {
+        gpu = &devices[slot];
+        if (gpu->is_composite || gpu->parent || gpu->device != data->device) {
+            continue;
+        }
+        pass = &column_pass[gpu->slot];
+        if (data->eventType & nvmlEventTypeXidCriticalError) {
+            pass->events |= GPU_MARK_XID;
+            pass->xids++;
+            pass->last_xid = data->eventData;
+            g_warning("GPU plugin: XID %llu on %s\n", data->eventData, gpu->label);
+        }
+        if (data->eventType & nvmlEventTypeClock) {
+            pass->events |= GPU_MARK_CLOCK;
+        }
+        if (data->eventType & nvmlEventTypePState) {
+            pass->events |= GPU_MARK_PSTATE;
+        }
+        if (data->eventType & GPU_RESAMPLE_EVENTS) {
+            gpu->resample = TRUE;
+            return TRUE;
+        }
+        break;
+    }
+    return FALSE;
+}
+
+/* Wait for NVML events until wake_time.  The wait is cut into slices so
+ * the sampler notices when it is stopped.  An XID or power state event
+ * cuts it short to sample its GPU again, but no sooner than a utilization
+ * interval after the last time an event did. */
+static void
+wait_for_events(gint64 wake_time)
+{
+    nvmlEventData_t data;
+    nvmlReturn_t result;
+    gboolean running = TRUE, resample = FALSE;
+    gint64 now, timeout;
+    
+    while (running && (now = g_get_monotonic_time()) < wake_time) {
+        timeout = MIN((wake_time - now + 999) / 1000, GPU_EVENT_SLICE_MS);
+        result = nvml->EventSetWait(event_set, &data, (unsigned int) timeout);
+        if (result == NVML_SUCCESS) {
+            do {
+                if (record_event(&data)) {
+                    resample = TRUE;
+                }
+            } while (nvml->EventSetWait(event_set, &data, 0) == NVML_SUCCESS);
+            if (resample) {
+                wake_time = MIN(wake_time, MAX(now, resample_at));
+            }
+        }
+        else if (result != NVML_ERROR_TIMEOUT) {
+            /* Go back to polling rather than spin on a broken set */
+            g_warning("GPU plugin: event wait failed: %s\n", nvml->ErrorString(result));
+            event_set_failed = TRUE;
+            break;
+        }
+        
+        g_mutex_lock(&sampler_lock);
+        running = sampler_running;
+        g_mutex_unlock(&sampler_lock);
+    }
+    
+    if (resample) {
+        resample_at = g_get_monotonic_time()
+                      + (gint64) g_atomic_int_get(&gpu_metric_schedule[GPU_METRIC_UTILIZATION].interval_ms)
+                        * sample_backoff * G_TIME_SPAN_MILLISECOND;
+    }
+}
+
+/* Copy a sample into the fixed-width shared layout.  The process list is
+ * only copied when it changed since out was last filled. */
+static void
+fill_shared_sample(GpuSharedSample *out, const GpuSample *sample)
+{
+    out->utilization = sample->utilization;
+    out->health = sample->health;
+    out->total_memory = sample->total_memory;
+    out->used_memory = sample->used_memory;
+    out->temperature = sample->temperature;
+    out->power = sample->power;
+    out->util_sum = sample->util_sum_total;
+    out->util_readings = sample->util_count_total;
+    out->column_peak = sample->column_peak;
+    out->column_events = sample->column_events;
+    for (gint r = 0; r < N_GPU_REDUCTIONS; ++r) {
+        out->reduction[r] = sample->reduction.value[r];
+    }
+    out->busy = sample->reduction.busy;
+    out->n_reduced = sample->reduction.n;
+    out->xid_count = sample->xid_count;
+    out->last_xid = sample->last_xid;
+    for (gint c = 0; c < GPU_LINK_COUNTERS; ++c) {
+        out->link_rates[c] = sample->link_rates[c];
+    }
+    out->throttle_reasons = sample->throttle_reasons;
+    if (out->procs_serial != sample->procs_serial) {
+        for (gint p = 0; p < GPU_TOP_PROCESSES; ++p) {
+            out->procs[p].pid = sample->procs[p].pid;
+            out->procs[p].sm_util = sample->procs[p].sm_util;
+            out->procs[p].used_memory = sample->procs[p].used_memory;
+            memcpy(out->procs[p].comm, sample->procs[p].comm, GPU_COMM_LEN);
+        }
+        out->n_procs = sample->n_procs;
+        out->procs_total = sample->procs_total;
+        out->procs_serial = sample->procs_serial;
+    }
+}
+
+/* Publish the samples just swapped in to the other instances, sampler
+ * thread only */
+static void
+publish_shared_samples(const GpuSample *samples)
+{
+    gpu_shared_write_begin(shared_header);
+    for (gint slot = 0; slot < n_slots; slot++) {
+        fill_shared_sample(&gpu_shared_samples(shared_header, n_slots)[slot], &samples[slot]);
+    }
+    gpu_shared_write_end(shared_header);
+}
+
+/* Sampler thread main loop: sample into the back buffer, then publish it */
+static gpointer
+sampler_thread_main(gpointer data)
+{
+    GpuSample *back;
+    gint64 now, wake_time;
+    guint due;
+    
+    g_mutex_lock(&sampler_lock);
+    while (sampler_running) {
+        /* Only this thread writes the buffers, so the front buffer can be
+         * read without the lock to carry forward the previous values */
+        back = sample_buffers[1 - sample_front];
+        memcpy(back, sample_buffers[sample_front], n_slots * sizeof(GpuSample));
+        g_mutex_unlock(&sampler_lock);
+        
+        now = g_get_monotonic_time();
+        due = schedule_due_metrics(now);
+        read_gpu_data(back, due);
+        if (due & (1 << GPU_METRIC_UTILIZATION)) {
+            update_sample_backoff(back, now);
+        }
+        wake_time = schedule_next_wake(now, due);
+        
+        g_mutex_lock(&sampler_lock);
+        merge_column_pass(back);
+        sample_front = 1 - sample_front;
+        if (shared_header) {
+            publish_shared_samples(back);
+        }
+        
+        /* Sleep until the next metric is due, or until an event asks
+         * for its GPU to be sampled again */
+        if (event_set && !event_set_failed && g_atomic_int_get(&gpu_use_events)) {
+            g_mutex_unlock(&sampler_lock);
+            wait_for_events(wake_time);
+            g_mutex_lock(&sampler_lock);
+            continue;
+        }
+        while (sampler_running) {
+            if (!g_cond_wait_until(&sampler_cond, &sampler_lock, wake_time)) {
+                break;
+            }
+        }
+    }
+    g_mutex_unlock(&sampler_lock);
+    
+    return NULL;
+}
+
+/* Start the background sampler thread, unless the samples come from
+ * elsewhere */
+void
+gpu_sampler_start(void)
+{
+    gint role = g_atomic_int_get(&shared_role);
+    
+    if (sampler_thread || !devices || role == GPU_ROLE_READER || role == GPU_ROLE_REMOTE) {
+        return;
+    }
+    
+    for (gint i = 0; i < N_GPU_METRICS; ++i) {
+        gpu_metric_schedule[i].next_due = 0;
+    }
+    sample_backoff = 1;
+    idle_since = 0;
+    
+    sampler_running = TRUE;
+    sampler_thread = g_thread_new("gkrellm-gpu", sampler_thread_main, NULL);
+}
+
+/* Stop the background sampler thread and wait for it to exit */
+void
+gpu_sampler_stop(void)
+{
+    if (!sampler_thread) {
+        return;
+    }
+    
+    g_mutex_lock(&sampler_lock);
+    sampler_running = FALSE;
+    g_cond_signal(&sampler_cond);
+    g_mutex_unlock(&sampler_lock);
+    
+    g_thread_join(sampler_thread);
+    sampler_thread = NULL;
+}
+
+/* Fill the front buffer from a shared snapshot, as the sampler thread
+ * would.  The chart column is this instance's own: it averages the
+ * readings the sampler made since the column started, found from the
+ * running totals, and the composite column reduces those averages.  The
+ * peak and events of a snapshot only count once, when it is fresh. */
+static void
+merge_shared_samples(const GpuSharedSample *snapshot, gboolean fresh)
+{
+    GpuSample *sample, *composite = NULL;
+    const GpuSharedSample *in;
+    GpuDevice *gpu;
+    gboolean restart = (column_epoch != column_epoch_seen);
+    gint64 now = g_get_monotonic_time();
+    gint n = 0;
+    
+    column_epoch_seen = column_epoch;
+    
+    for (gint slot = 0; slot < n_slots; slot++) {
+        gpu = &devices[slot];
+        sample = &sample_buffers[sample_front][slot];
+        in = &snapshot[slot];
+        
+        sample->utilization = in->utilization;
+        sample->health = in->health;
+        sample->total_memory = in->total_memory;
+        sample->used_memory = in->used_memory;
+        sample->temperature = in->temperature;
+        sample->power = in->power;
+        sample->throttle_reasons = in->throttle_reasons;
+        for (gint r = 0; r < N_GPU_REDUCTIONS; ++r) {
+            sample->reduction.value[r] = in->reduction[r];
+        }
+        sample->reduction.busy = in->busy;
+        sample->reduction.n = in->n_reduced;
+        sample->xid_count = in->xid_count;
+        sample->last_xid = in->last_xid;
+        for (gint c = 0; c < GPU_LINK_COUNTERS; ++c) {
+            sample->link_rates[c] = in->link_rates[c];
+        }
+        if (in->procs_serial != sample->procs_serial) {
+            for (gint p = 0; p < GPU_TOP_PROCESSES; ++p) {
+                sample->procs[p].pid = in->procs[p].pid;
+                sample->procs[p].sm_util = in->procs[p].sm_util;
+                sample->procs[p].used_memory = in->procs[p].used_memory;
+                copy_shared_string(sample->procs[p].comm, GPU_COMM_LEN,
+                                   in->procs[p].comm, sizeof(in->procs[p].comm));
+            }
+            sample->n_procs = CLAMP(in->n_procs, 0, GPU_TOP_PROCESSES);
+            sample->procs_total = in->procs_total;
+            sample->procs_serial = in->procs_serial;
+        }
+        
+        if (restart) {
+            sample->column_sum = 0.0;
+            sample->column_count = 0;
+            sample->column_peak = 0;
+            sample->column_events = 0;
+        }
+        if (gpu->is_composite) {
+            composite = sample;
+            continue;
+        }
+        
+        /* Totals that went down are from a new sampler, start from them */
+        if (in->util_readings >= gpu->shared_count && in->util_sum >= gpu->shared_sum) {
+            sample->column_sum += in->util_sum - gpu->shared_sum;
+            sample->column_count += in->util_readings - gpu->shared_count;
+        }
+        gpu->shared_sum = in->util_sum;
+        gpu->shared_count = in->util_readings;
+        if (fresh) {
+            sample->column_peak = MAX(sample->column_peak, in->column_peak);
+            sample->column_events |= in->column_events;
+        }
+    }
+    
+    /* Alerts are this instance's own, on the values taken in */
+    if (fresh) {
+        for (gint slot = 0; slot < n_slots; slot++) {
+            evaluate_alerts(&devices[slot], &sample_buffers[sample_front][slot], now);
+        }
+    }
+    
+    if (!composite) {
+        return;
+    }
+    composite->column_peak = 0;
+    composite->column_events = 0;
+    for (gint slot = 0; slot < n_slots; slot++) {
+        gpu = &devices[slot];
+        sample = &sample_buffers[sample_front][slot];
+        if (gpu->is_composite || gpu->parent || !gpu->enabled) {
+            continue;
+        }
+        if (sample->column_count > 0) {
+            reduce_util[n] = (guchar) MIN(round(sample->column_sum / sample->column_count), 100);
+            reduce_weight[n++] = (gdouble) sample->used_memory;
+        }
+        composite->column_peak = MAX(composite->column_peak, sample->column_peak);
+        composite->column_events |= sample->column_events;
+    }
+    if (n > 0) {
+        GpuReduction reduction;
+        
+        reduce_utilization(n, &reduction);
+        composite->column_sum = reduction.value[g_atomic_int_get(&gpu_composite_reduction)];
+        composite->column_count = 1;
+    }
+}
+
+/* Take in the sampler's latest snapshot, if there is a new one.  The
+ * GPUs read as stale while the sampler has stopped publishing. */
+static void
+read_shared_samples(void)
+{
+    const GpuSharedHeader *header = gpu_shared_map(shared);
+    gboolean copied = FALSE;
+    gint64 published = 0;
+    guint32 seq = 0;
+    
+    if (header && header->n_slots == n_slots && gpu_shared_covers(shared, n_slots)) {
+        for (gint tries = 0; tries < 4 && !copied; ++tries) {
+            seq = gpu_shared_read_begin(header);
+            published = header->published;
+            memcpy(shared_scratch, gpu_shared_samples(header, n_slots),
+                   n_slots * sizeof(GpuSharedSample));
+            copied = !gpu_shared_read_retry(header, seq);
+        }
+    }
+    
+    if (!copied || g_get_monotonic_time() - published > GPU_SHARED_STALE_MS * 1000) {
+        for (gint slot = 0; slot < n_slots; slot++) {
+            if (!devices[slot].is_composite) {
+                sample_buffers[sample_front][slot].health = GPU_HEALTH_STALE;
+            }
+        }
+        return;
+    }
+    if (seq != shared_seq_seen || column_epoch != column_epoch_seen) {
+        merge_shared_samples(shared_scratch, seq != shared_seq_seen);
+        shared_seq_seen = seq;
+    }
+}
+
+static gpointer
+takeover_thread_main(gpointer data)
+{
+    nvmlReturn_t result = NVML_ERROR_LIBRARY_NOT_FOUND;
+    
+    nvml = select_backend();
+    if (nvml) {
+        result = nvml->Init();
+        if (result != NVML_SUCCESS) {
+            g_warning("GPU plugin: cannot take over sampling: %s\n", nvml->ErrorString(result));
+        }
+    }
+    g_atomic_int_set(&takeover_state, result == NVML_SUCCESS ? GPU_INIT_DONE : GPU_INIT_FAILED);
+    return NULL;
+}
+
+/* A reader whose sampler went away wins its lock and takes over.  NVML is
+ * initialized on a thread; the sampler then finds the GPUs again by UUID
+ * the way it recovers from a failing GPU.  A reader that cannot start NVML
+ * lets go of the lock, and tries again with backoff.  A reader of another
+ * user's segment cannot take over, and samples alone instead. */
+void
+gpu_sampler_poll(void)
+{
+    gint64 now = g_get_monotonic_time();
+    gint state;
+    
+    if (g_atomic_int_get(&shared_role) != GPU_ROLE_READER) {
+        return;
+    }
+    if (!takeover_thread) {
+        if (now >= takeover_at && (gpu_shared_elect(shared) || gpu_shared_orphaned(shared))) {
+            g_atomic_int_set(&takeover_state, GPU_INIT_RUNNING);
+            takeover_thread = g_thread_new("gkrellm-gpu-takeover", takeover_thread_main, NULL);
+        }
+        return;
+    }
+    state = g_atomic_int_get(&takeover_state);
+    if (state == GPU_INIT_RUNNING) {
+        return;
+    }
+    g_thread_join(takeover_thread);
+    takeover_thread = NULL;
+    
+    if (state == GPU_INIT_FAILED) {
+        gpu_shared_resign(shared);
+        takeover_ms = CLAMP(takeover_ms * 2, GPU_RESTART_MIN_MS, GPU_RESTART_MAX_MS);
+        takeover_at = now + (gint64) takeover_ms * 1000;
+        return;
+    }
+    
+    g_message(gpu_shared_elect(shared)
+              ? "GPU plugin: the sampler went away, sampling for this host now\n"
+              : "GPU plugin: the sampler went away, sampling alone\n");
+    /* Stale, so that each GPU goes through device_recovered() once it
+     * resolves, which creates the event set and registers it */
+    for (gint slot = 0; slot < n_slots; slot++) {
+        devices[slot].device_valid = FALSE;
+        devices[slot].state = GPU_HEALTH_STALE;
+        devices[slot].retry_ms = GPU_RETRY_MIN_MS;
+        devices[slot].retry_at = 0;
+    }
+    nvml_started = TRUE;
+    g_atomic_int_set(&shared_role, GPU_ROLE_SAMPLER);
+    publish_shared_devices();
+    gpu_sampler_start();
+}
+
+/* Set up the devices gkrellmd describes; their samples come from it */
+gboolean
+gpu_sampler_init_remote(const GpuSharedDevice *described, gint count)
+{
+    if (devices || count <= 0) {
+        return FALSE;
+    }
+    
+    setup_described_devices(described, count, GPU_ROLE_REMOTE);
+    return TRUE;
+}
+
+gint
+gpu_sampler_slots(void)
+{
+    return n_slots;
+}
+
+gint
+gpu_sampler_gpus(void)
+{
+    return n_gpus;
+}
+
+GpuDevice *
+gpu_sampler_device(gint slot)
+{
+    return (slot >= 0 && slot < n_slots) ? &devices[slot] : NULL;
+}
+
+gint
+gpu_sampler_role(void)
+{
+    return g_atomic_int_get(&shared_role);
+}
+
+/* Take in the remote snapshot if it changed, or if a new column started */
+static void
+read_remote_samples(void)
+{
+    if (remote_seq != shared_seq_seen || column_epoch != column_epoch_seen) {
+        merge_shared_samples(shared_scratch, remote_seq != shared_seq_seen);
+        shared_seq_seen = remote_seq;
+    }
+}
+
+const GpuSample *
+gpu_sampler_lock(void)
+{
+    gint role = g_atomic_int_get(&shared_role);
+    
+    if (role == GPU_ROLE_READER) {
+        read_shared_samples();
+    }
+    else if (role == GPU_ROLE_REMOTE) {
+        read_remote_samples();
+    }
+    
+    g_mutex_lock(&sampler_lock);
+    return sample_buffers[sample_front];
+}
+
+void
+gpu_sampler_unlock(gboolean take_column)
+{
+    if (take_column) {
+        column_epoch++;
+    }
+    g_mutex_unlock(&sampler_lock);
+}
+
+void
+gpu_sampler_describe(GpuSharedDevice *described)
+{
+    for (gint slot = 0; slot < n_slots; slot++) {
+        describe_device(&devices[slot], &described[slot]);
+    }
+}
+
+void
+gpu_sampler_snapshot(GpuSharedSample *samples, gboolean take_column)
+{
+    const GpuSample *front = gpu_sampler_lock();
+    
+    for (gint slot = 0; slot < n_slots; slot++) {
+        fill_shared_sample(&samples[slot], &front[slot]);
+    }
+    gpu_sampler_unlock(take_column);
+}
+
+GpuSharedSample *
+gpu_sampler_remote_samples(void)
+{
+    return shared_scratch;
+}
+
+void
+gpu_sampler_remote_update(void)
+{
+    remote_seq++;
+}
+
+void
+gpu_sampler_shutdown(void)
+{
+    GpuDevice *gpu;
+    
+    /* Stop sampling before tearing anything down; a takeover that got
+     * NVML going leaves it to be shut down */
+    gpu_sampler_stop();
+    if (takeover_thread) {
+        g_thread_join(takeover_thread);
+        takeover_thread = NULL;
+        if (g_atomic_int_get(&takeover_state) == GPU_INIT_DONE) {
+            nvml_started = TRUE;
+        }
+    }
+    gpu_shared_close(shared);
+    shared = NULL;
+    shared_header = NULL;
+    g_free(shared_scratch);
+    shared_scratch = NULL;
+    shared_seq_seen = 0;
+    remote_seq = 0;
+    takeover_at = 0;
+    takeover_ms = 0;
+    if (event_set) {
+        nvml->EventSetFree(event_set);
+        event_set = NULL;
+    }
+    event_set_failed = FALSE;
+    
+    for (gint i = 0; i < n_slots; ++i) {
+        gpu = &devices[i];
+        g_free(gpu->name);
+        g_free(gpu->label);
+        g_free(gpu->util_samples);
+        g_free(gpu->proc_info);
+        g_free(gpu->proc_util);
+        for (gint j = 0; j < 2; ++j) {
+            if (gpu->gpm_samples[j]) {
+                nvml->GpmSampleFree(gpu->gpm_samples[j]);
+            }
+        }
+    }
+    g_free(devices);
+    devices = NULL;
+    composite_device = NULL;
+    n_slots = 0;
+    
+    g_free(sample_buffers[0]);
+    g_free(sample_buffers[1]);
+    sample_buffers[0] = sample_buffers[1] = NULL;
+    g_free(column_pass);
+    column_pass = NULL;
+    g_free(reduce_util);
+    g_free(reduce_weight);
+    reduce_util = NULL;
+    reduce_weight = NULL;
+    
+    /* Process lists and the command name cache */
+    if (proc_scratch) {
+        g_array_free(proc_scratch, TRUE);
+        proc_scratch = NULL;
+    }
+    if (comm_cache) {
+        g_hash_table_destroy(comm_cache);
+        comm_cache = NULL;
+    }
+    while (!g_queue_is_empty(&comm_lru)) {
+        g_free(g_queue_pop_head_link(&comm_lru)->data);
+    }
+    
+    /* Shutdown NVML, which a reader never started */
+    if (nvml_started) {
+        nvml->Shutdown();
+        nvml_started = FALSE;
+    }
+    g_atomic_int_set(&shared_role, GPU_ROLE_ALONE);
+}
+
+guint
+gpu_throttle_decode(guint reasons)
+{
+    guint categories = 0;
+    
+    for (gint c = 0; c < N_GPU_THROTTLE; ++c) {
+        if (reasons & gpu_throttle_categories[c].reasons) {
+            categories |= 1u << c;
+        }
+    }
+    return categories;
+}
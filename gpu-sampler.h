@@ -0,0 +1,354 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Sampling core
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#ifndef GPU_SAMPLER_H
+#define GPU_SAMPLER_H
+
+#include <glib.h>
+#include <nvml.h>
+
+#include "gpu-backend.h"
+#include "gpu-shared.h"
+
+/* The sampling core finds the GPUs and samples them on a thread of its
+ * own into a double-buffered GpuSample array, or takes the samples from
+ * another instance that does.  It uses no GTK or GKrellM calls, so the
+ * GKrellM plugin and the gkrellmd server plugin are both built on it.
+ *
+ * Devices are kept in slots: the composite first if there are several
+ * GPUs, then each GPU followed by its MIG devices.  The front buffer is
+ * read between gpu_sampler_lock() and gpu_sampler_unlock(). */
+
+#define GPU_IDLE_UTILIZATION 5        /* At or below this all GPUs count as idle */
+#define GPU_TOP_PROCESSES 5           /* Processes listed per GPU */
+#define GPU_COMM_LEN 16               /* Command name length, as TASK_COMM_LEN */
+#define GPU_MAX_NVLINKS 18            /* NVLinks per GPU, as on an H100 */
+#define GPU_LINK_COUNTERS (2 + 2 * GPU_MAX_NVLINKS) /* PCIe and NVLink TX/RX */
+
+/* Metrics sampled by the sampler thread, each on its own cadence */
+enum {
+    GPU_METRIC_UTILIZATION,
+    GPU_METRIC_MEMORY,
+    GPU_METRIC_TEMPERATURE,
+    GPU_METRIC_POWER,
+    GPU_METRIC_PROCESSES,
+    GPU_METRIC_INTERCONNECT,
+    GPU_METRIC_THROTTLE,
+    N_GPU_METRICS
+};
+
+typedef struct {
+    const gchar  *name;            /* Config keyword for the metric */
+    const gchar  *label;           /* Label for the config dialog */
+    gint         interval_ms;      /* Sampling interval (atomic) */
+    gint64       next_due;         /* Next sample time, sampler thread only */
+    unsigned int field_id;         /* NVML field id for batched reads, 0 if none */
+} GpuMetricSchedule;
+
+/* Previous reading of a monotonic counter, to turn it into a rate */
+typedef struct {
+    unsigned long long value;
+    gint64       timestamp;        /* When value was read in microseconds, 0 if never */
+} GpuCounter;
+
+/* Health of a GPU as seen by the sampler */
+typedef enum {
+    GPU_HEALTH_OK,                 /* Sampled normally */
+    GPU_HEALTH_STALE,              /* NVML calls fail; retried with backoff */
+    GPU_HEALTH_LOST                /* Fell off the bus; retried with backoff */
+} GpuHealth;
+
+/* Events marked on the charts, one bit each */
+enum {
+    GPU_MARK_XID    = 1 << 0,      /* Critical XID error */
+    GPU_MARK_CLOCK  = 1 << 1,      /* Clock change */
+    GPU_MARK_PSTATE = 1 << 2,      /* Power state change */
+    GPU_MARK_ALERT  = 1 << 3,      /* Alert raised, set by the plugin */
+    GPU_MARK_POWER_CAP  = 1 << 4,  /* Clocks held down by the power cap */
+    GPU_MARK_THERMAL    = 1 << 5,  /* By the temperature */
+    GPU_MARK_HW_SLOWDOWN = 1 << 6, /* By the hardware slowdown signal */
+    GPU_MARK_SYNC_BOOST = 1 << 7   /* By the clocks of a sync boost group */
+};
+
+/* Throttle reasons that hold the clocks below what the load asks for, as
+ * opposed to an idle GPU or clocks set that way on purpose */
+#define GPU_THROTTLE_LIMITING (nvmlClocksThrottleReasonSwPowerCap \
+                               | nvmlClocksThrottleReasonHwSlowdown \
+                               | nvmlClocksThrottleReasonSwThermalSlowdown \
+                               | nvmlClocksThrottleReasonHwThermalSlowdown \
+                               | nvmlClocksThrottleReasonHwPowerBrakeSlowdown)
+
+/* The throttle reasons grouped by what holds the clocks down */
+enum {
+    GPU_THROTTLE_POWER_CAP,
+    GPU_THROTTLE_THERMAL,
+    GPU_THROTTLE_HW_SLOWDOWN,
+    GPU_THROTTLE_SYNC_BOOST,
+    GPU_THROTTLE_CLOCK_SETTING,
+    GPU_THROTTLE_IDLE,
+    N_GPU_THROTTLE
+};
+
+typedef struct {
+    const gchar  *name;            /* Name in labels and commands */
+    const gchar  *label;           /* Name in the tooltip */
+    guint        reasons;          /* nvmlClocksThrottleReason* bits */
+    guint        mark;             /* GPU_MARK_* drawn while held, 0 for none */
+} GpuThrottleCategory;
+
+/* Conditions alerted on, evaluated on every sample */
+enum {
+    GPU_ALERT_UTILIZATION,
+    GPU_ALERT_MEMORY,
+    GPU_ALERT_TEMPERATURE,
+    GPU_ALERT_POWER,
+    GPU_ALERT_THROTTLE,
+    N_GPU_ALERTS
+};
+
+/* An alert is raised once its value has stayed at or above raise_at for
+ * dwell_s seconds, and cleared once it has stayed below clear_at as long */
+typedef struct {
+    const gchar  *name;            /* Config keyword */
+    const gchar  *label;           /* Label for the config dialog */
+    const gchar  *unit;            /* Unit of the limits, NULL if they are fixed */
+    gint         enabled;          /* (atomic) */
+    gint         raise_at;         /* (atomic) */
+    gint         clear_at;         /* (atomic) */
+    gint         dwell_s;          /* (atomic) */
+} GpuAlertRule;
+
+/* Ways of reducing the utilization of the GPUs to the composite's */
+enum {
+    GPU_REDUCE_MEAN,
+    GPU_REDUCE_WEIGHTED,
+    GPU_REDUCE_MIN,
+    GPU_REDUCE_MAX,
+    GPU_REDUCE_P90,
+    N_GPU_REDUCTIONS
+};
+
+/* Utilization of a set of GPUs reduced every way at once */
+typedef struct {
+    gulong       value[N_GPU_REDUCTIONS]; /* Indexed by GPU_REDUCE_* */
+    guint        busy;             /* GPUs above GPU_IDLE_UTILIZATION */
+    guint        n;                /* GPUs reduced */
+} GpuReduction;
+
+/* A process using a GPU */
+typedef struct {
+    guint        pid;
+    gulong       used_memory;      /* GPU memory used in bytes, 0 if unknown */
+    guint        sm_util;          /* SM utilization in percent */
+    gchar        comm[GPU_COMM_LEN]; /* Command name */
+} GpuProcess;
+
+/* Values sampled for one GPU by the sampler thread */
+typedef struct {
+    gulong       utilization;      /* GPU utilization in percent */
+    gulong       total_memory;     /* Total memory available */
+    gulong       used_memory;      /* Currently used memory */
+    gfloat       temperature;      /* Temperature in C */
+    gfloat       power;            /* Power draw in W */
+    
+    /* Utilization statistics for the chart column being filled */
+    gdouble      column_sum;       /* Sum of the utilization readings */
+    guint        column_count;     /* Number of utilization readings */
+    gulong       column_peak;      /* Highest utilization reading */
+    guint        column_events;    /* GPU_MARK_* events seen */
+    gdouble      util_sum_total;   /* Sum of all utilization readings, for readers */
+    guint64      util_count_total; /* Number of all utilization readings */
+    
+    GpuReduction reduction;        /* Reductions over the GPUs, composite only */
+    
+    guint        xid_count;        /* Critical XID errors since start */
+    gulong       last_xid;         /* Most recent XID, 0 if none */
+    
+    GpuHealth    health;
+    
+    guint        throttle_reasons; /* nvmlClocksThrottleReason* bits */
+    guint        alerts;           /* GPU_ALERT_* bits raised */
+    
+    gulong       link_rates[GPU_LINK_COUNTERS]; /* Interconnect traffic in KiB/s */
+    
+    /* Busiest processes, by GPU memory then SM utilization */
+    GpuProcess   procs[GPU_TOP_PROCESSES];
+    gint         n_procs;          /* Processes in procs */
+    gint         procs_total;      /* Processes running on the GPU */
+    guint        procs_serial;     /* Bumped whenever procs is refreshed */
+} GpuSample;
+
+/* A GPU, MIG device or the composite as the sampler knows it */
+typedef struct _GpuDevice {
+    gchar        *name;            /* Config name like "gpu0", "gpu0mig1" or "gpu" */
+    gchar        *label;           /* Display label like "GPU0", "MIG0.1" or "GPU" */
+    gint         instance;         /* GPU device index, the parent's for a MIG device */
+    gint         slot;             /* Index into the devices and the sample buffers */
+    gint         enabled;          /* If the GPU counts towards the composite (atomic) */
+    gboolean     is_composite;     /* If this is the composite GPU (average of all GPUs) */
+    gint         want_temperature; /* If the temperature is read (atomic) */
+    
+    /* MIG hierarchy: MIG devices follow their GPU */
+    struct _GpuDevice *parent;     /* GPU of a MIG device, NULL otherwise */
+    gint         mig_index;        /* MIG device index on the parent, -1 if not MIG */
+    gint         n_children;       /* Number of MIG devices of a GPU */
+    
+    /* Device handle and static properties, owned by the sampler once it runs */
+    nvmlDevice_t device;           /* Cached NVML device handle */
+    gboolean     device_valid;     /* If the cached handle/properties are usable */
+    gchar        device_name[NVML_DEVICE_NAME_BUFFER_SIZE];        /* Product name */
+    gchar        uuid[NVML_DEVICE_UUID_BUFFER_SIZE];               /* Device UUID */
+    gchar        pci_bus_id[NVML_DEVICE_PCI_BUS_ID_BUFFER_SIZE];   /* PCI bus id */
+    gulong       device_memory;    /* Total memory of the device */
+    guint        temp_slowdown;    /* Slowdown temperature threshold in C */
+    guint        temp_shutdown;    /* Shutdown temperature threshold in C */
+    guint        fields_unsupported; /* Metrics the field value API cannot read */
+    guint        metrics_unsupported; /* Metrics the device cannot report at all */
+    
+    /* Failure handling, sampler thread only.  A failing device is left
+     * alone until retry_at, so a hung driver call costs one pass per
+     * retry rather than every pass. */
+    GpuHealth    state;            /* Health as of the last pass */
+    nvmlReturn_t last_error;       /* Error that took the device down */
+    gint64       retry_at;         /* Monotonic time of the next resolve attempt */
+    guint        retry_ms;         /* Current retry interval */
+    gboolean     resample;         /* Read again at once after an XID or power state event */
+    
+    /* Interconnect counters, sampler thread only */
+    gint         n_nvlinks;        /* NVLinks of the GPU */
+    guint64      links_unsupported; /* Counters the device cannot report */
+    GpuCounter   link_counters[GPU_LINK_COUNTERS];
+    gboolean     links_live;       /* If the counters have readings */
+    
+    /* GPM utilization of a MIG device, sampler thread only */
+    gboolean     gpm_supported;    /* If the GPU supports GPM, set on the parent */
+    guint        gpu_instance_id;  /* GPU instance id of a MIG device */
+    nvmlGpmSample_t gpm_samples[2];/* Previous and current GPM samples */
+    gint         gpm_current;      /* Index of the sample taken next */
+    gboolean     gpm_primed;       /* If the previous sample is valid */
+    
+    /* Buffered utilization samples, sampler thread only */
+    nvmlSample_t *util_samples;    /* Buffer for nvmlDeviceGetSamples */
+    guint        n_util_samples;   /* Size of the buffer */
+    unsigned long long last_sample_ts; /* Timestamp of the newest sample seen */
+    gboolean     samples_unsupported; /* If the device has no sample buffer */
+    
+    /* Process list buffers, sampler thread only */
+    nvmlProcessInfo_t *proc_info;  /* Buffer for the running process calls */
+    guint        n_proc_info;      /* Size of the buffer */
+    nvmlProcessUtilizationSample_t *proc_util; /* Buffer for nvmlDeviceGetProcessUtilization */
+    guint        n_proc_util;      /* Size of the buffer */
+    unsigned long long last_proc_util_ts; /* Timestamp of the newest process sample seen */
+    
+    /* When the condition that would raise or clear each alert started
+     * to hold, 0 while it does not; whoever fills the samples */
+    gint64       alert_since[N_GPU_ALERTS];
+    
+    /* Utilization totals of the last snapshot taken in, readers only */
+    gdouble      shared_sum;
+    guint64      shared_count;
+} GpuDevice;
+
+/* Where the samples of this process come from */
+enum {
+    GPU_ROLE_ALONE,                /* Sampling for this instance only */
+    GPU_ROLE_SAMPLER,              /* Sampling and publishing for the host */
+    GPU_ROLE_READER,               /* Reading what the host's sampler publishes */
+    GPU_ROLE_REMOTE                /* Fed by gkrellmd through gpu_sampler_remote_samples() */
+};
+
+/* Progress of an initialization run on a thread of its own */
+enum {
+    GPU_INIT_RUNNING,
+    GPU_INIT_DONE,
+    GPU_INIT_FAILED
+};
+
+/* Settings read by the sampler thread (atomic) */
+extern GpuMetricSchedule gpu_metric_schedule[N_GPU_METRICS];
+extern GpuAlertRule gpu_alert_rules[N_GPU_ALERTS];
+extern const GpuThrottleCategory gpu_throttle_categories[N_GPU_THROTTLE];
+extern gint gpu_composite_reduction;   /* Reduction shown as the composite's, GPU_REDUCE_* */
+extern gint gpu_idle_backoff;          /* Slow down sampling when all GPUs idle */
+extern gint gpu_buffered_utilization;  /* Drain the driver sample buffer */
+extern gint gpu_show_interconnect;     /* Read PCIe and NVLink traffic */
+extern gint gpu_use_events;            /* Wake the sampler on NVML events */
+
+/* Running total of sampling calls (atomic), exported for tests/bench */
+extern gint gpu_nvml_calls_total;
+
+/* Initialize the sampling backend and find the GPUs, or with
+ * GKRELLM_GPU_SHARED=1 those another instance samples.  This can take
+ * seconds, so GKrellM runs it on a thread of its own. */
+gboolean gpu_sampler_init(void);
+
+/* Set up devices described by gkrellmd, counting the physical GPUs among
+ * them.  Their samples are then written to gpu_sampler_remote_samples(). */
+gboolean gpu_sampler_init_remote(const GpuSharedDevice *devices, gint count);
+
+gint gpu_sampler_slots(void);
+gint gpu_sampler_gpus(void);
+GpuDevice *gpu_sampler_device(gint slot);
+gint gpu_sampler_role(void);
+
+/* Start and stop the sampler thread; nothing to do for a reader */
+void gpu_sampler_start(void);
+void gpu_sampler_stop(void);
+
+/* Once a second: a reader takes over if the host's sampler went away */
+void gpu_sampler_poll(void);
+
+/* Lock and return the front buffer, after taking in a new snapshot if
+ * the samples come from elsewhere.  Unlocking with take_column starts a
+ * new chart column. */
+const GpuSample *gpu_sampler_lock(void);
+void gpu_sampler_unlock(gboolean take_column);
+
+/* The devices and the latest samples in the fixed-width shared layout,
+ * taking the current column as gpu_sampler_unlock() does */
+void gpu_sampler_describe(GpuSharedDevice *devices);
+void gpu_sampler_snapshot(GpuSharedSample *samples, gboolean take_column);
+
+/* Samples of a remote sampler, to be updated in place; say so after an
+ * update with gpu_sampler_remote_update() */
+GpuSharedSample *gpu_sampler_remote_samples(void);
+void gpu_sampler_remote_update(void);
+
+/* Stop sampling and free everything, shutting down NVML if it was used */
+void gpu_sampler_shutdown(void);
+
+/* GPU_THROTTLE_* bits of the categories throttle reasons fall in */
+guint gpu_throttle_decode(guint reasons);
+
+#endif /* GPU_SAMPLER_H */
@@ -0,0 +1,177 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - gkrellmd server plugin serving the GPUs to clients
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#include <gkrellm2/gkrellmd.h>
+
+#include "gpu-sampler.h"
+#include "gpu-remote.h"
+
+#include <string.h>
+
+/* The gkrellmd side of the plugin: the same sampler as in GKrellM, with
+ * every metric on, whose samples are served once a second as the changes
+ * since the previous second (see gpu-remote.h) */
+
+#define BANDWIDTH_LOG_S 60             /* How often the bytes served per GPU are logged */
+
+static gint n_slots = 0;
+static gint n_gpus = 0;
+static GpuSharedSample *served = NULL; /* Samples as of the last update served */
+static GpuSharedSample *latest = NULL; /* Samples just taken */
+static GpuSharedSample *zeroed = NULL; /* What a new client starts from */
+static GString *update_text = NULL;    /* Changes from the previous update */
+static guint64 *bytes_served = NULL;   /* Update bytes per slot since the last log */
+static gint log_seconds = 0;
+
+static void
+log_bandwidth(void)
+{
+    GpuDevice *dev;
+    
+    for (gint slot = 0; slot < n_slots; slot++) {
+        dev = gpu_sampler_device(slot);
+        g_debug("GPU plugin: %s updates take %.1f bytes/s per client\n",
+                dev->name, (gdouble) bytes_served[slot] / BANDWIDTH_LOG_S);
+        bytes_served[slot] = 0;
+    }
+}
+
+static void
+update_gpu(GkrellmdMonitor *mon, gboolean first_update)
+{
+    if (!n_slots || (!first_update && !gkrellmd_ticks()->second_tick)) {
+        return;
+    }
+    
+    /* A sampler elsewhere on the host may have gone away */
+    gpu_sampler_poll();
+    gpu_sampler_snapshot(latest, TRUE);
+    
+    g_string_truncate(update_text, 0);
+    for (gint slot = 0; slot < n_slots; slot++) {
+        bytes_served[slot] += gpu_remote_format_delta(update_text, slot,
+                                                      &served[slot], &latest[slot]);
+    }
+    memcpy(served, latest, n_slots * sizeof(GpuSharedSample));
+    if (update_text->len) {
+        gkrellmd_need_serve(mon);
+    }
+    
+    if (++log_seconds >= BANDWIDTH_LOG_S) {
+        log_bandwidth();
+        log_seconds = 0;
+    }
+}
+
+static void
+serve_gpu_data(GkrellmdMonitor *mon, gboolean first_serve)
+{
+    GString *full;
+    
+    if (!n_slots) {
+        return;
+    }
+    gkrellmd_set_serve_name(mon, GPU_REMOTE_KEY);
+    
+    /* Every field is sent whole, so a new client that also gets this
+     * second's update just sets the same values twice */
+    if (first_serve) {
+        full = g_string_new("reset\n");
+        for (gint slot = 0; slot < n_slots; slot++) {
+            gpu_remote_format_delta(full, slot, &zeroed[slot], &served[slot]);
+        }
+        gkrellmd_serve_data(mon, full->str);
+        g_string_free(full, TRUE);
+    }
+    else if (update_text->len) {
+        gkrellmd_serve_data(mon, update_text->str);
+    }
+}
+
+static void
+serve_gpu_setup(GkrellmdMonitor *mon)
+{
+    GpuSharedDevice *described;
+    gchar *line;
+    
+    line = g_strdup_printf("version %d\n", GPU_REMOTE_VERSION);
+    gkrellmd_plugin_serve_setup(mon, GPU_REMOTE_KEY, line);
+    g_free(line);
+    line = g_strdup_printf("gpus %d %d\n", n_slots, n_gpus);
+    gkrellmd_plugin_serve_setup(mon, GPU_REMOTE_KEY, line);
+    g_free(line);
+    
+    described = g_new0(GpuSharedDevice, MAX(n_slots, 1));
+    gpu_sampler_describe(described);
+    for (gint slot = 0; slot < n_slots; slot++) {
+        line = gpu_remote_format_device(slot, &described[slot]);
+        gkrellmd_plugin_serve_setup(mon, GPU_REMOTE_KEY, line);
+        g_free(line);
+    }
+    g_free(described);
+}
+
+static GkrellmdMonitor gpu_monitor = {
+    .name = GPU_REMOTE_KEY,
+    .update_monitor = update_gpu,
+    .serve_data = serve_gpu_data,
+    .serve_setup = serve_gpu_setup,
+};
+
+/* Entry point for the plugin - this function is called by gkrellmd */
+GkrellmdMonitor *
+gkrellmd_init_plugin(void)
+{
+    /* No one is waiting on a panel here, so the GPUs are found right away */
+    if (!gpu_sampler_init()) {
+        g_warning("GPU plugin: failed to initialize NVML\n");
+        return &gpu_monitor;
+    }
+    
+    /* Clients choose what to show, so everything is sampled */
+    n_slots = gpu_sampler_slots();
+    n_gpus = gpu_sampler_gpus();
+    for (gint slot = 0; slot < n_slots; slot++) {
+        g_atomic_int_set(&gpu_sampler_device(slot)->want_temperature, TRUE);
+    }
+    gpu_show_interconnect = TRUE;
+    gpu_sampler_start();
+    
+    served = g_new0(GpuSharedSample, n_slots);
+    latest = g_new0(GpuSharedSample, n_slots);
+    zeroed = g_new0(GpuSharedSample, n_slots);
+    bytes_served = g_new0(guint64, n_slots);
+    update_text = g_string_new(NULL);
+    return &gpu_monitor;
+}
@@ -0,0 +1,292 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Shared sample segment and sampler election
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#include "gpu-shared.h"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+struct _GpuShared {
+    gint         fd;               /* Read-only, holds the lock */
+    gint         write_fd;         /* Read-write, opened by the sampler, or -1 */
+    gboolean     owner;            /* If the segment belongs to this user */
+    gboolean     sampler;          /* If this process holds the lock */
+    gpointer     map;
+    gsize        map_size;
+    gboolean     map_writable;
+};
+
+/* Size of a segment holding n_slots devices */
+static gsize
+segment_size(gint n_slots)
+{
+    return sizeof(GpuSharedHeader)
+           + n_slots * (sizeof(GpuSharedDevice) + sizeof(GpuSharedSample));
+}
+
+static void
+shared_unmap(GpuShared *shared)
+{
+    if (shared->map) {
+        munmap(shared->map, shared->map_size);
+        shared->map = NULL;
+        shared->map_size = 0;
+    }
+}
+
+static gboolean
+shared_remap(GpuShared *shared, gsize size, gboolean writable)
+{
+    gpointer map;
+    
+    map = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ,
+               MAP_SHARED, writable ? shared->write_fd : shared->fd, 0);
+    if (map == MAP_FAILED) {
+        g_warning("GPU plugin: cannot map " GPU_SHARED_NAME ": %s\n", g_strerror(errno));
+        return FALSE;
+    }
+    shared_unmap(shared);
+    shared->map = map;
+    shared->map_size = size;
+    shared->map_writable = writable;
+    return TRUE;
+}
+
+GpuShared *
+gpu_shared_open(void)
+{
+    GpuShared *shared;
+    struct stat st;
+    gint fd;
+    
+    /* The segment belongs to the user who creates it: only their GKrellMs
+     * may sample into it, and everyone maps it read-only until then */
+    fd = shm_open(GPU_SHARED_NAME, O_RDONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0 && errno == EEXIST) {
+        fd = shm_open(GPU_SHARED_NAME, O_RDONLY, 0);
+    }
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        g_warning("GPU plugin: cannot open " GPU_SHARED_NAME ": %s\n", g_strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return NULL;
+    }
+    
+    shared = g_new0(GpuShared, 1);
+    shared->fd = fd;
+    shared->write_fd = -1;
+    shared->owner = (st.st_uid == geteuid());
+    if (shared->owner && (st.st_mode & 0777) != 0644) {
+        fchmod(fd, 0644);           /* Also takes back a segment others could write */
+    }
+    gpu_shared_elect(shared);
+    return shared;
+}
+
+void
+gpu_shared_close(GpuShared *shared)
+{
+    if (!shared) {
+        return;
+    }
+    shared_unmap(shared);
+    if (shared->write_fd >= 0) {
+        close(shared->write_fd);
+    }
+    close(shared->fd);              /* Releases the lock */
+    g_free(shared);
+}
+
+gboolean
+gpu_shared_elect(GpuShared *shared)
+{
+    if (!shared->sampler && shared->owner) {
+        shared->sampler = (flock(shared->fd, LOCK_EX | LOCK_NB) == 0);
+    }
+    return shared->sampler;
+}
+
+gboolean
+gpu_shared_orphaned(GpuShared *shared)
+{
+    if (shared->owner || flock(shared->fd, LOCK_SH | LOCK_NB) < 0) {
+        return FALSE;
+    }
+    flock(shared->fd, LOCK_UN);
+    return TRUE;
+}
+
+void
+gpu_shared_resign(GpuShared *shared)
+{
+    if (shared->sampler) {
+        flock(shared->fd, LOCK_UN);
+        shared->sampler = FALSE;
+    }
+}
+
+GpuSharedHeader *
+gpu_shared_create(GpuShared *shared, gint n_slots)
+{
+    GpuSharedHeader *header;
+    struct stat st, locked;
+    gsize size = segment_size(n_slots);
+    
+    if (!shared->sampler) {
+        return NULL;
+    }
+    
+    /* Only the sampler opens the segment for writing, and only the one it
+     * holds the lock on */
+    if (shared->write_fd < 0) {
+        shared->write_fd = shm_open(GPU_SHARED_NAME, O_RDWR, 0);
+        if (shared->write_fd < 0 || fstat(shared->write_fd, &st) < 0
+            || fstat(shared->fd, &locked) < 0
+            || st.st_dev != locked.st_dev || st.st_ino != locked.st_ino) {
+            g_warning("GPU plugin: cannot write " GPU_SHARED_NAME "\n");
+            if (shared->write_fd >= 0) {
+                close(shared->write_fd);
+                shared->write_fd = -1;
+            }
+            return NULL;
+        }
+    }
+    
+    /* Readers may have mapped the segment at its current size, so it is
+     * only ever grown */
+    if (fstat(shared->write_fd, &st) < 0) {
+        return NULL;
+    }
+    if ((gsize) st.st_size < size && ftruncate(shared->write_fd, (off_t) size) < 0) {
+        g_warning("GPU plugin: cannot size " GPU_SHARED_NAME ": %s\n", g_strerror(errno));
+        return NULL;
+    }
+    if (!shared_remap(shared, MAX(size, (gsize) st.st_size), TRUE)) {
+        return NULL;
+    }
+    
+    header = shared->map;
+    gpu_shared_write_begin(header);
+    memcpy(header->magic, GPU_SHARED_MAGIC, sizeof(header->magic));
+    header->version = GPU_SHARED_VERSION;
+    header->header_size = sizeof(GpuSharedHeader);
+    header->device_size = sizeof(GpuSharedDevice);
+    header->sample_size = sizeof(GpuSharedSample);
+    header->n_slots = n_slots;
+    header->sampler_pid = getpid();
+    memset(gpu_shared_devices(header), 0,
+           n_slots * (sizeof(GpuSharedDevice) + sizeof(GpuSharedSample)));
+    return header;
+}
+
+const GpuSharedHeader *
+gpu_shared_map(GpuShared *shared)
+{
+    const GpuSharedHeader *header;
+    struct stat st;
+    gint n_slots;
+    
+    /* Map whatever is there, then make sure it covers what the header
+     * says it holds */
+    if (!shared->map || shared->map_size < sizeof(GpuSharedHeader)) {
+        if (fstat(shared->fd, &st) < 0 || (gsize) st.st_size < sizeof(GpuSharedHeader)
+            || !shared_remap(shared, st.st_size, FALSE)) {
+            return NULL;
+        }
+    }
+    header = shared->map;
+    if (memcmp(header->magic, GPU_SHARED_MAGIC, sizeof(header->magic)) != 0
+        || header->version != GPU_SHARED_VERSION
+        || header->header_size != sizeof(GpuSharedHeader)
+        || header->device_size != sizeof(GpuSharedDevice)
+        || header->sample_size != sizeof(GpuSharedSample)) {
+        return NULL;
+    }
+    n_slots = __atomic_load_n(&header->n_slots, __ATOMIC_RELAXED);
+    if (n_slots <= 0) {
+        return NULL;
+    }
+    if (!gpu_shared_covers(shared, n_slots)) {
+        if (shared->map_writable || fstat(shared->fd, &st) < 0
+            || (gsize) st.st_size < segment_size(n_slots)
+            || !shared_remap(shared, st.st_size, FALSE)) {
+            return NULL;
+        }
+        header = shared->map;
+    }
+    return header;
+}
+
+gboolean
+gpu_shared_covers(GpuShared *shared, gint n_slots)
+{
+    /* Bounded first so that segment_size() cannot overflow */
+    return n_slots > 0 && (gsize) n_slots <= shared->map_size / sizeof(GpuSharedDevice)
+           && segment_size(n_slots) <= shared->map_size;
+}
+
+/* A seqlock: the sequence is odd while the sampler writes, and a reader
+ * whose copy straddled a write sees it change */
+void
+gpu_shared_write_begin(GpuSharedHeader *header)
+{
+    __atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+void
+gpu_shared_write_end(GpuSharedHeader *header)
+{
+    header->published = g_get_monotonic_time();
+    __atomic_store_n(&header->seq, header->seq + 1, __ATOMIC_RELEASE);
+}
+
+guint32
+gpu_shared_read_begin(const GpuSharedHeader *header)
+{
+    return __atomic_load_n(&header->seq, __ATOMIC_ACQUIRE);
+}
+
+gboolean
+gpu_shared_read_retry(const GpuSharedHeader *header, guint32 seq)
+{
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return (seq & 1) || __atomic_load_n(&header->seq, __ATOMIC_RELAXED) != seq;
+}
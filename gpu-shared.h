@@ -0,0 +1,172 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Shared sample segment
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#ifndef GPU_SHARED_H
+#define GPU_SHARED_H
+
+#include <glib.h>
+
+/* One GKrellM on a host, the sampler, polls NVML and publishes what it
+ * reads in a POSIX shared memory segment; every other instance, and any
+ * other local tool, reads it from there.  The sampler is whoever holds
+ * an exclusive flock() on the segment, so when it exits for any reason
+ * the next instance to try the lock takes over.  Only processes of the
+ * user who created the segment may become the sampler; it is 0644 and
+ * everyone else maps it read-only.
+ *
+ * The segment is a GpuSharedHeader, then n_slots GpuSharedDevice, then
+ * n_slots GpuSharedSample.  All of it is guarded by the sequence number
+ * in the header, which is odd while the sampler writes: copy what you
+ * need between gpu_shared_read_begin() and gpu_shared_read_retry() and
+ * start over if the latter says so.  The layout only changes with
+ * GPU_SHARED_VERSION. */
+
+#define GPU_SHARED_NAME "/gkrellm-gpu"
+#define GPU_SHARED_MAGIC "GKGPUSHM"
+#define GPU_SHARED_VERSION 1
+
+#define GPU_SHARED_NAME_LEN 96         /* Room for a product name or UUID */
+#define GPU_SHARED_REDUCTIONS 5        /* Mean, weighted, min, max, p90 */
+#define GPU_SHARED_PROCESSES 5         /* Busiest processes listed per GPU */
+#define GPU_SHARED_COMM_LEN 16         /* Command name length */
+#define GPU_SHARED_LINK_RATES 38       /* PCIe TX/RX, then TX/RX of 18 NVLinks */
+
+typedef struct {
+    gchar        magic[8];         /* GPU_SHARED_MAGIC, not terminated */
+    guint32      version;          /* GPU_SHARED_VERSION */
+    guint32      header_size;      /* sizeof(GpuSharedHeader) */
+    guint32      device_size;      /* sizeof(GpuSharedDevice) */
+    guint32      sample_size;      /* sizeof(GpuSharedSample) */
+    gint32       n_slots;          /* Devices, 0 until the sampler is set up */
+    gint32       n_gpus;           /* Physical GPUs */
+    gint32       sampler_pid;
+    guint32      seq;              /* Odd while the sampler writes */
+    gint64       published;        /* CLOCK_MONOTONIC time of the last write in us */
+} GpuSharedHeader;
+
+/* A device as found by the sampler: a GPU, a MIG device or the composite */
+typedef struct {
+    gchar        name[32];         /* "gpu0", "gpu0mig1" or "gpu" */
+    gchar        label[32];
+    gchar        uuid[GPU_SHARED_NAME_LEN];
+    gchar        device_name[GPU_SHARED_NAME_LEN];
+    gint32       instance;         /* GPU index, -1 for the composite */
+    gint32       mig_index;        /* MIG device index, -1 if not MIG */
+    gint32       parent;           /* Slot of the GPU of a MIG device, -1 otherwise */
+    gint32       n_children;       /* MIG devices of a GPU */
+    gint32       is_composite;
+    gint32       n_nvlinks;
+    guint64      device_memory;    /* Total memory in bytes */
+} GpuSharedDevice;
+
+typedef struct {
+    guint32      pid;
+    guint32      sm_util;          /* SM utilization in percent */
+    guint64      used_memory;      /* GPU memory used in bytes */
+    gchar        comm[GPU_SHARED_COMM_LEN];
+} GpuSharedProcess;
+
+typedef struct {
+    guint32      utilization;      /* Latest reading in percent */
+    guint32      health;           /* 0 ok, 1 stale, 2 lost */
+    guint64      total_memory;     /* Bytes */
+    guint64      used_memory;      /* Bytes */
+    gfloat       temperature;      /* C */
+    gfloat       power;            /* W */
+    
+    /* Every utilization reading since the sampler started, so a reader
+     * can average over its own interval from two snapshots */
+    gdouble      util_sum;
+    guint64      util_readings;
+    guint32      column_peak;      /* Highest reading in the sampler's current second */
+    guint32      column_events;    /* Events in it: 1 XID, 2 clock, 4 power state */
+    
+    guint32      reduction[GPU_SHARED_REDUCTIONS]; /* Composite only */
+    guint32      busy;             /* Busy GPUs, composite only */
+    guint32      n_reduced;        /* GPUs reduced, composite only */
+    
+    guint32      xid_count;        /* Critical XID errors since the sampler started */
+    guint64      last_xid;
+    guint64      link_rates[GPU_SHARED_LINK_RATES]; /* KiB/s */
+    
+    GpuSharedProcess procs[GPU_SHARED_PROCESSES];
+    gint32       n_procs;
+    gint32       procs_total;
+    guint32      procs_serial;     /* Bumped whenever procs is refreshed */
+    guint32      throttle_reasons; /* nvmlClocksThrottleReason* bits */
+} GpuSharedSample;
+
+typedef struct _GpuShared GpuShared;
+
+/* Open, creating if need be, the segment and try to become the sampler.
+ * NULL if there is no shared memory to use. */
+GpuShared *gpu_shared_open(void);
+
+void gpu_shared_close(GpuShared *shared);
+
+/* If this process is the sampler; if not, try again to become it */
+gboolean gpu_shared_elect(GpuShared *shared);
+
+/* If nobody samples into a segment that belongs to another user, so
+ * this process cannot take over and has to sample alone */
+gboolean gpu_shared_orphaned(GpuShared *shared);
+
+/* Let another process become the sampler */
+void gpu_shared_resign(GpuShared *shared);
+
+/* As the sampler, size the segment for n_slots and map it for writing.
+ * The header is filled in and left being written, with n_slots set; end
+ * with gpu_shared_write_end() once the devices are in.  NULL on error. */
+GpuSharedHeader *gpu_shared_create(GpuShared *shared, gint n_slots);
+
+/* Map the segment to read it, NULL until a sampler has published into
+ * it.  The mapping stays valid until gpu_shared_close(). */
+const GpuSharedHeader *gpu_shared_map(GpuShared *shared);
+
+/* If the mapping holds n_slots devices.  The sampler may rewrite n_slots
+ * at any time, so read it once and check that before copying. */
+gboolean gpu_shared_covers(GpuShared *shared, gint n_slots);
+
+void gpu_shared_write_begin(GpuSharedHeader *header);
+void gpu_shared_write_end(GpuSharedHeader *header);
+guint32 gpu_shared_read_begin(const GpuSharedHeader *header);
+gboolean gpu_shared_read_retry(const GpuSharedHeader *header, guint32 seq);
+
+#define gpu_shared_devices(header) \
+    ((GpuSharedDevice *) ((guint8 *) (header) + sizeof(GpuSharedHeader)))
+#define gpu_shared_samples(header, n_slots) \
+    ((GpuSharedSample *) ((guint8 *) gpu_shared_devices(header) \
+                          + (n_slots) * sizeof(GpuSharedDevice)))
+
+#endif /* GPU_SHARED_H */
@@ -0,0 +1,155 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Rolling statistics over fixed windows
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#include "gpu-stats.h"
+
+#include <string.h>
+#include <math.h>
+
+/* Every window is kept up to date on each second: the reading entering
+ * it is added and the one leaving it, still in the ring of the last
+ * seconds, taken out again.  The readings are small integers, so the
+ * sums stay exact however long this runs, and a histogram of them gives
+ * the quantiles and the maximum without keeping the readings sorted. */
+
+#define GPU_STATS_RING 900         /* Seconds in the longest window */
+#define GPU_STATS_BINS (GPU_STATS_MAX_VALUE + 1)
+
+static const guint window_seconds[GPU_STATS_WINDOWS] = { 60, 300, 900 };
+
+/* The readings of one series in one window */
+typedef struct {
+    guint32      count;
+    guint32      sum;
+    guint32      sum_squares;
+    guint16      bins[GPU_STATS_BINS]; /* Readings by value */
+} GpuStatsWindow;
+
+struct _GpuStats {
+    guint8       ring[GPU_STATS_RING][GPU_STATS_SERIES]; /* The last seconds */
+    guint        head;             /* Next second to write */
+    GpuStatsWindow windows[GPU_STATS_SERIES][GPU_STATS_WINDOWS];
+};
+
+G_STATIC_ASSERT(GPU_STATS_RING * GPU_STATS_MAX_VALUE * GPU_STATS_MAX_VALUE <= G_MAXUINT32);
+G_STATIC_ASSERT(GPU_STATS_RING <= G_MAXUINT16);
+
+GpuStats *
+gpu_stats_new(void)
+{
+    GpuStats *stats = g_new0(GpuStats, 1);
+    
+    memset(stats->ring, GPU_STATS_NONE, sizeof(stats->ring));
+    return stats;
+}
+
+void
+gpu_stats_free(GpuStats *stats)
+{
+    g_free(stats);
+}
+
+guint
+gpu_stats_window_seconds(gint window)
+{
+    return window_seconds[window];
+}
+
+void
+gpu_stats_push(GpuStats *stats, const guint8 *values)
+{
+    GpuStatsWindow *w;
+    guint8 in, out;
+    
+    for (gint s = 0; s < GPU_STATS_SERIES; ++s) {
+        in = values[s];
+        if (in != GPU_STATS_NONE) {
+            in = MIN(in, GPU_STATS_MAX_VALUE);
+        }
+        for (gint i = 0; i < GPU_STATS_WINDOWS; ++i) {
+            w = &stats->windows[s][i];
+            out = stats->ring[(stats->head + GPU_STATS_RING - window_seconds[i]) % GPU_STATS_RING][s];
+            if (out != GPU_STATS_NONE) {
+                w->count--;
+                w->sum -= out;
+                w->sum_squares -= (guint32) out * out;
+                w->bins[out]--;
+            }
+            if (in != GPU_STATS_NONE) {
+                w->count++;
+                w->sum += in;
+                w->sum_squares += (guint32) in * in;
+                w->bins[in]++;
+            }
+        }
+        stats->ring[stats->head][s] = in;
+    }
+    stats->head = (stats->head + 1) % GPU_STATS_RING;
+}
+
+gdouble
+gpu_stats_get(GpuStats *stats, gint series, gint window, gint kind)
+{
+    GpuStatsWindow *w = &stats->windows[series][window];
+    guint32 rank, seen = 0;
+    gint64 spread;
+    gint v;
+    
+    if (w->count == 0) {
+        return -1.0;
+    }
+    switch (kind) {
+        case GPU_STATS_MEAN:
+            return (gdouble) w->sum / w->count;
+        case GPU_STATS_STDDEV:
+            /* count^2 times the variance, exactly */
+            spread = (gint64) w->count * w->sum_squares - (gint64) w->sum * w->sum;
+            return sqrt((gdouble) MAX(spread, 0)) / w->count;
+        case GPU_STATS_P95:
+            /* The nearest rank, so always a value that was read */
+            rank = (w->count * 95 + 99) / 100;
+            for (v = 0; v < GPU_STATS_MAX_VALUE; ++v) {
+                seen += w->bins[v];
+                if (seen >= rank) {
+                    break;
+                }
+            }
+            return v;
+        case GPU_STATS_MAX:
+            for (v = GPU_STATS_MAX_VALUE; v > 0 && w->bins[v] == 0; --v) {
+            }
+            return v;
+    }
+    return -1.0;
+}
@@ -0,0 +1,85 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Rolling statistics
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#ifndef GPU_STATS_H
+#define GPU_STATS_H
+
+#include <glib.h>
+
+/* Values the statistics are kept for, recorded once a second */
+enum {
+    GPU_STATS_UTILIZATION,         /* Mean utilization over the second, percent */
+    GPU_STATS_MEMORY,              /* Memory used, percent */
+    GPU_STATS_TEMPERATURE,         /* Temperature, degrees C */
+    GPU_STATS_SERIES
+};
+
+/* Windows the statistics are kept over */
+enum {
+    GPU_STATS_1MIN,
+    GPU_STATS_5MIN,
+    GPU_STATS_15MIN,
+    GPU_STATS_WINDOWS
+};
+
+/* Statistics of a series over a window */
+enum {
+    GPU_STATS_MEAN,
+    GPU_STATS_STDDEV,
+    GPU_STATS_P95,
+    GPU_STATS_MAX,
+    GPU_STATS_KINDS
+};
+
+#define GPU_STATS_NONE 0xff        /* A second without a reading */
+#define GPU_STATS_MAX_VALUE 127    /* Larger values are counted as this */
+
+typedef struct _GpuStats GpuStats;
+
+GpuStats *gpu_stats_new(void);
+
+void gpu_stats_free(GpuStats *stats);
+
+/* Record the GPU_STATS_SERIES values of the next second, GPU_STATS_NONE
+ * for those not read.  Constant time whatever the windows. */
+void gpu_stats_push(GpuStats *stats, const guint8 *values);
+
+/* A statistic of a series over a window, -1 if the window holds no
+ * reading of the series */
+gdouble gpu_stats_get(GpuStats *stats, gint series, gint window, gint kind);
+
+/* Seconds in a window */
+guint gpu_stats_window_seconds(gint window);
+
+#endif /* GPU_STATS_H */
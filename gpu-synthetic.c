@@ -0,0 +1,1238 @@
+/* GKrellM
+|  Copyright (C) 2025 Jayce Dowell
+|
+|  Based on GKrellM codebase by Bill Wilson
+|
+|  GKrellM GPU plugin - Synthetic sampling backend for testing without a GPU
+|
+|
+|  GKrellM is free software: you can redistribute it and/or modify it
+|  under the terms of the GNU General Public License as published by
+|  the Free Software Foundation, either version 3 of the License, or
+|  (at your option) any later version.
+|
+|  GKrellM is distributed in the hope that it will be useful, but WITHOUT
+|  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+|  or FITNESS FOR A PARTICULAR PURPOSE. See the GNU General Public
+|  License for more details.
+|
+|  You should have received a copy of the GNU General Public License
+|  along with this program. If not, see http://www.gnu.org/licenses/
+|
+|
+|  Additional permission under GNU GPL version 3 section 7
+|
+|  If you modify this program, or any covered work, by linking or
+|  combining it with the OpenSSL project's OpenSSL library (or a
+|  modified version of that library), containing parts covered by
+|  the terms of the OpenSSL or SSLeay licenses, you are granted
+|  additional permission to convey the resulting work.
+|  Corresponding Source for a non-source form of such a combination
+|  shall include the source code for the parts of OpenSSL used as well
+|  as that of the covered work.
+*/
+
+#include "gpu-backend.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+
+/* The synthetic backend fakes a configurable set of GPUs whose load
+ * follows scripted waveforms of time.  Everything is derived from the
+ * time since Init, so runs are reproducible.  The spec string is a comma
+ * separated list of key=value pairs:
+ *
+ *   gpus=N            number of GPUs (default 2)
+ *   wave=NAME         load waveform for all GPUs: idle, constant, sine,
+ *                     square, saw, burst or random (default sine)
+ *   waveI=NAME        waveform for GPU I only
+ *   level=PERCENT     load of the constant waveform (default 50)
+ *   period=SECONDS    waveform period (default 60)
+ *   memory=MIB        memory size of each GPU (default 16384)
+ *   latency=USEC      delay injected into every call (default 0)
+ *   lost=I[@SECONDS]  GPU I is lost after SECONDS (default immediately)
+ *   found=I@SECONDS   lost GPU I is back after SECONDS
+ *   flaky=I@PERCENT   PERCENT of the calls to GPU I time out
+ *   xid=I@SECONDS     GPU I reports a critical XID error after SECONDS
+ *   mig=N             split every GPU into N MIG instances (default 0)
+ *   procs=N           processes on every GPU or MIG device (default 2)
+ *   nvlinks=N         NVLinks of every GPU (default 0)
+ *   unsupported=A+B   calls that return NOT_SUPPORTED: temperature,
+ *                     power, fields, samples, gpm, procs, throttle
+ *
+ * The keys lost, found, flaky, xid and waveI may be repeated.  Registered
+ * event sets also see a clock change whenever a GPU's load crosses 50% and
+ * a power state change whenever it goes idle or busy.  A GPU reports its
+ * clocks held down by the power cap above 90% load, and by thermal
+ * slowdown above 95%. */
+
+#define SYNTHETIC_SAMPLE_PERIOD_US 166667   /* Driver sample rate of ~6 Hz */
+#define SYNTHETIC_SAMPLE_BUFFER 100         /* Samples kept by the "driver" */
+#define SYNTHETIC_MAX_MIG 7                 /* MIG devices per GPU, as on an A100 */
+#define SYNTHETIC_MAX_PROCS 64              /* Processes per device */
+#define SYNTHETIC_MAX_NVLINKS 18            /* NVLinks per GPU */
+#define SYNTHETIC_PCIE_BPS 16e9             /* PCIe bytes per second at full load */
+#define SYNTHETIC_NVLINK_BPS 25e9           /* NVLink bytes per second at full load */
+#define SYNTHETIC_TRAFFIC_STEP 0.05         /* Integration step of the traffic counters */
+#define SYNTHETIC_EVENT_POLL_US 20000       /* How often a waiting event set looks for events */
+#define SYNTHETIC_XID 79                    /* XID reported: GPU has fallen off the bus */
+
+enum {
+    WAVE_IDLE,
+    WAVE_CONSTANT,
+    WAVE_SINE,
+    WAVE_SQUARE,
+    WAVE_SAW,
+    WAVE_BURST,
+    WAVE_RANDOM
+};
+
+static const gchar *wave_names[] = {
+    "idle", "constant", "sine", "square", "saw", "burst", "random"
+};
+
+enum {
+    UNSUPPORTED_TEMPERATURE = 1 << 0,
+    UNSUPPORTED_POWER       = 1 << 1,
+    UNSUPPORTED_FIELDS      = 1 << 2,
+    UNSUPPORTED_SAMPLES     = 1 << 3,
+    UNSUPPORTED_GPM         = 1 << 4,
+    UNSUPPORTED_PROCS       = 1 << 5,
+    UNSUPPORTED_THROTTLE    = 1 << 6
+};
+
+typedef struct _SyntheticGpu SyntheticGpu;
+
+struct _SyntheticGpu {
+    gint         index;            /* Device index, unique across MIG devices too */
+    gint         wave;             /* Load waveform */
+    gdouble      phase;            /* Waveform phase offset in seconds */
+    gdouble      lost_after;       /* Seconds until the GPU is lost, < 0 for never */
+    gdouble      found_after;      /* Seconds until a lost GPU is back, < 0 for never */
+    gint         flaky;            /* Percent of calls that time out */
+    guint        calls;            /* Calls made to this GPU */
+    
+    SyntheticGpu *parent;          /* GPU of a MIG device, NULL for a GPU */
+    SyntheticGpu *migs;            /* MIG devices of a GPU */
+    gint         n_migs;           /* Number of MIG devices */
+    unsigned int gpu_instance_id;  /* GPU instance id of a MIG device */
+    
+    gdouble      xid_after;        /* Seconds until an XID error, < 0 for never */
+    
+    gdouble      traffic;          /* Load integrated over time, in seconds */
+    gdouble      traffic_t;        /* Time traffic was integrated up to */
+};
+
+/* An event set remembers the GPUs registered with it and how far it has
+ * looked for their events */
+typedef struct {
+    GPtrArray    *gpus;            /* Registered SyntheticGpu */
+    GArray       *types;           /* Event types registered, per GPU */
+    GQueue       pending;          /* nvmlEventData_t found but not yet returned */
+    gdouble      checked_t;        /* Time up to which events were found */
+} SyntheticEventSet;
+
+/* A GPM sample remembers which MIG device it was taken from and when */
+typedef struct {
+    SyntheticGpu *gpu;
+    gdouble      t;
+} SyntheticGpmSample;
+
+static struct {
+    gint         n_gpus;
+    gint         wave;
+    gdouble      level;
+    gdouble      period;
+    unsigned long long memory;
+    gulong       latency;
+    guint        unsupported;
+    gint         mig;
+    gint         procs;
+    gint         nvlinks;
+    SyntheticGpu *gpus;
+    SyntheticGpu *migs;            /* MIG devices of all GPUs, mig per GPU */
+    gint64       start;            /* Monotonic time of Init, 0 when shut down */
+    gint64       real_start;       /* Real time of Init for sample timestamps */
+} synth;
+
+/* Cheap deterministic hash used for the random waveform and flaky calls */
+static guint32
+synthetic_hash(guint32 a, guint32 b)
+{
+    guint32 h = a * 0x9e3779b1u ^ (b + 0x7f4a7c15u + (a << 6) + (a >> 2));
+    
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+/* Load of a GPU in the range 0-1 at t seconds after Init */
+static gdouble
+synthetic_load(SyntheticGpu *gpu, gdouble t)
+{
+    gdouble x = (t + gpu->phase) / synth.period;
+    gdouble frac = x - floor(x);
+    gdouble sum = 0.0;
+    
+    /* A GPU split into MIG devices is as busy as its instances */
+    if (gpu->n_migs > 0) {
+        for (gint i = 0; i < gpu->n_migs; ++i) {
+            sum += synthetic_load(&gpu->migs[i], t);
+        }
+        return sum / gpu->n_migs;
+    }
+    
+    switch (gpu->wave) {
+        case WAVE_IDLE:
+            return 0.0;
+        case WAVE_CONSTANT:
+            return synth.level / 100.0;
+        case WAVE_SINE:
+            return 0.5 + 0.5 * sin(2 * M_PI * x);
+        case WAVE_SQUARE:
+            return frac < 0.5 ? 1.0 : 0.0;
+        case WAVE_SAW:
+            return frac;
+        case WAVE_BURST:
+            /* 100 ms of full load at the start of every second */
+            return t - floor(t) < 0.1 ? 1.0 : 0.0;
+        case WAVE_RANDOM:
+            return (synthetic_hash(gpu->index, (guint32) (t * 6)) % 101) / 100.0;
+    }
+    
+    return 0.0;
+}
+
+/* Seconds since Init */
+static gdouble
+synthetic_time(void)
+{
+    return (g_get_monotonic_time() - synth.start) / (gdouble) G_USEC_PER_SEC;
+}
+
+/* Common entry for every device call: inject latency and errors */
+static nvmlReturn_t
+synthetic_enter(nvmlDevice_t device, SyntheticGpu **gpu)
+{
+    SyntheticGpu *root;
+    
+    if (synth.latency > 0) {
+        g_usleep(synth.latency);
+    }
+    if (synth.start == 0) {
+        return NVML_ERROR_UNINITIALIZED;
+    }
+    
+    *gpu = (SyntheticGpu *) device;
+    if (!*gpu) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+    (*gpu)->calls++;
+    
+    /* A MIG device goes away with its GPU */
+    root = (*gpu)->parent ? (*gpu)->parent : *gpu;
+    if (root->lost_after >= 0 && synthetic_time() >= root->lost_after
+        && (root->found_after < 0 || synthetic_time() < root->found_after)) {
+        return NVML_ERROR_GPU_IS_LOST;
+    }
+    if ((*gpu)->flaky > 0
+        && synthetic_hash((*gpu)->index, (*gpu)->calls) % 100 < (guint) (*gpu)->flaky) {
+        return NVML_ERROR_TIMEOUT;
+    }
+    
+    return NVML_SUCCESS;
+}
+
+static gint
+synthetic_parse_wave(const gchar *name)
+{
+    for (gint i = 0; i < (gint) G_N_ELEMENTS(wave_names); ++i) {
+        if (!strcmp(wave_names[i], name)) {
+            return i;
+        }
+    }
+    g_warning("GPU plugin: unknown synthetic waveform '%s'\n", name);
+    return WAVE_SINE;
+}
+
+/* Apply the per-GPU keys of the spec once the GPUs exist */
+static void
+synthetic_parse_gpu_key(const gchar *key, const gchar *value)
+{
+    gint index = -1;
+    gdouble arg = -1;
+    
+    if (!strncmp(key, "wave", 4) && key[4] != '\0') {
+        index = atoi(key + 4);
+        if (index >= 0 && index < synth.n_gpus) {
+            synth.gpus[index].wave = synthetic_parse_wave(value);
+        }
+        return;
+    }
+    
+    if (sscanf(value, "%d@%lf", &index, &arg) < 1 || index < 0 || index >= synth.n_gpus) {
+        return;
+    }
+    if (!strcmp(key, "lost")) {
+        synth.gpus[index].lost_after = arg < 0 ? 0 : arg;
+    }
+    else if (!strcmp(key, "found")) {
+        synth.gpus[index].found_after = arg < 0 ? 0 : arg;
+    }
+    else if (!strcmp(key, "flaky")) {
+        synth.gpus[index].flaky = CLAMP((gint) arg, 0, 100);
+    }
+    else if (!strcmp(key, "xid")) {
+        synth.gpus[index].xid_after = arg < 0 ? 0 : arg;
+    }
+}
+
+static void
+synthetic_configure(const gchar *spec)
+{
+    gchar **items, **kv;
+    gint i;
+    
+    synth.n_gpus = 2;
+    synth.wave = WAVE_SINE;
+    synth.level = 50;
+    synth.period = 60;
+    synth.memory = 16384;
+    synth.latency = 0;
+    synth.unsupported = 0;
+    synth.mig = 0;
+    synth.procs = 2;
+    synth.nvlinks = 0;
+    
+    items = g_strsplit(spec ? spec : "", ",", -1);
+    
+    /* Global keys first, they size the GPU table */
+    for (i = 0; items[i]; ++i) {
+        kv = g_strsplit(g_strstrip(items[i]), "=", 2);
+        if (kv[0] && kv[1]) {
+            if (!strcmp(kv[0], "gpus"))
+                synth.n_gpus = CLAMP(atoi(kv[1]), 0, 4096);
+            else if (!strcmp(kv[0], "wave"))
+                synth.wave = synthetic_parse_wave(kv[1]);
+            else if (!strcmp(kv[0], "level"))
+                synth.level = CLAMP(g_ascii_strtod(kv[1], NULL), 0, 100);
+            else if (!strcmp(kv[0], "period"))
+                synth.period = MAX(g_ascii_strtod(kv[1], NULL), 0.1);
+            else if (!strcmp(kv[0], "memory"))
+                synth.memory = g_ascii_strtoull(kv[1], NULL, 10);
+            else if (!strcmp(kv[0], "latency"))
+                synth.latency = strtoul(kv[1], NULL, 10);
+            else if (!strcmp(kv[0], "mig"))
+                synth.mig = CLAMP(atoi(kv[1]), 0, SYNTHETIC_MAX_MIG);
+            else if (!strcmp(kv[0], "nvlinks"))
+                synth.nvlinks = CLAMP(atoi(kv[1]), 0, SYNTHETIC_MAX_NVLINKS);
+            else if (!strcmp(kv[0], "procs"))
+                synth.procs = CLAMP(atoi(kv[1]), 0, SYNTHETIC_MAX_PROCS);
+            else if (!strcmp(kv[0], "unsupported")) {
+                if (strstr(kv[1], "temperature"))
+                    synth.unsupported |= UNSUPPORTED_TEMPERATURE;
+                if (strstr(kv[1], "power"))
+                    synth.unsupported |= UNSUPPORTED_POWER;
+                if (strstr(kv[1], "fields"))
+                    synth.unsupported |= UNSUPPORTED_FIELDS;
+                if (strstr(kv[1], "samples"))
+                    synth.unsupported |= UNSUPPORTED_SAMPLES;
+                if (strstr(kv[1], "gpm"))
+                    synth.unsupported |= UNSUPPORTED_GPM;
+                if (strstr(kv[1], "procs"))
+                    synth.unsupported |= UNSUPPORTED_PROCS;
+                if (strstr(kv[1], "throttle"))
+                    synth.unsupported |= UNSUPPORTED_THROTTLE;
+            }
+        }
+        g_strfreev(kv);
+    }
+    
+    g_free(synth.gpus);
+    synth.gpus = g_new0(SyntheticGpu, MAX(synth.n_gpus, 1));
+    for (i = 0; i < synth.n_gpus; ++i) {
+        synth.gpus[i].index = i;
+        synth.gpus[i].wave = synth.wave;
+        synth.gpus[i].phase = synth.period * i / MAX(synth.n_gpus, 1);
+        synth.gpus[i].lost_after = -1;
+        synth.gpus[i].found_after = -1;
+        synth.gpus[i].xid_after = -1;
+    }
+    
+    /* MIG devices get their own waveform phase, spread over the GPUs */
+    g_free(synth.migs);
+    synth.migs = g_new0(SyntheticGpu, MAX(synth.n_gpus * synth.mig, 1));
+    for (i = 0; i < synth.n_gpus * synth.mig; ++i) {
+        SyntheticGpu *mig = &synth.migs[i];
+        
+        mig->parent = &synth.gpus[i / synth.mig];
+        mig->index = synth.n_gpus + i;
+        mig->wave = synth.wave;
+        mig->phase = synth.period * i / (synth.n_gpus * synth.mig);
+        mig->lost_after = -1;
+        mig->found_after = -1;
+        mig->xid_after = -1;
+        mig->gpu_instance_id = 1 + i % synth.mig;
+        if (i % synth.mig == 0) {
+            mig->parent->migs = mig;
+            mig->parent->n_migs = synth.mig;
+        }
+    }
+    
+    for (i = 0; items[i]; ++i) {
+        kv = g_strsplit(items[i], "=", 2);
+        if (kv[0] && kv[1]) {
+            synthetic_parse_gpu_key(kv[0], kv[1]);
+        }
+        g_strfreev(kv);
+    }
+    
+    g_strfreev(items);
+}
+
+static nvmlReturn_t
+synthetic_init(void)
+{
+    synth.start = g_get_monotonic_time();
+    synth.real_start = g_get_real_time();
+    return NVML_SUCCESS;
+}
+
+static nvmlReturn_t
+synthetic_shutdown(void)
+{
+    synth.start = 0;
+    return NVML_SUCCESS;
+}
+
+static const char *
+synthetic_error_string(nvmlReturn_t result)
+{
+    switch (result) {
+        case NVML_SUCCESS:
+            return "Success";
+        case NVML_ERROR_UNINITIALIZED:
+            return "Uninitialized";
+        case NVML_ERROR_INVALID_ARGUMENT:
+            return "Invalid Argument";
+        case NVML_ERROR_NOT_SUPPORTED:
+            return "Not Supported";
+        case NVML_ERROR_NOT_FOUND:
+            return "Not Found";
+        case NVML_ERROR_INSUFFICIENT_SIZE:
+            return "Insufficient Size";
+        case NVML_ERROR_TIMEOUT:
+            return "Timeout";
+        case NVML_ERROR_GPU_IS_LOST:
+            return "GPU is lost";
+        default:
+            return "Unknown Error";
+    }
+}
+
+static nvmlReturn_t
+synthetic_device_get_count(unsigned int *deviceCount)
+{
+    if (synth.start == 0) {
+        return NVML_ERROR_UNINITIALIZED;
+    }
+    *deviceCount = synth.n_gpus;
+    return NVML_SUCCESS;
+}
+
+static nvmlReturn_t
+synthetic_device_get_handle_by_index(unsigned int index, nvmlDevice_t *device)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result;
+    
+    if (index >= (unsigned int) synth.n_gpus) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+    result = synthetic_enter((nvmlDevice_t) &synth.gpus[index], &gpu);
+    if (result == NVML_SUCCESS) {
+        *device = (nvmlDevice_t) gpu;
+    }
+    return result;
+}
+
+/* UUIDs are made up by synthetic_device_get_uuid and end in the index */
+static nvmlReturn_t
+synthetic_device_get_handle_by_uuid(const char *uuid, nvmlDevice_t *device)
+{
+    const gchar *tail = strrchr(uuid, '-');
+    
+    if (strncmp(uuid, "GPU-", 4) != 0 || !tail) {
+        return NVML_ERROR_NOT_FOUND;
+    }
+    return synthetic_device_get_handle_by_index((unsigned int) strtoul(tail + 1, NULL, 16),
+                                                device);
+}
+
+static nvmlReturn_t
+synthetic_device_get_name(nvmlDevice_t device, char *name, unsigned int length)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        if (gpu->parent) {
+            g_snprintf(name, length, "Synthetic MIG 1g.%lluMiB (%s)",
+                       synth.memory / gpu->parent->n_migs, wave_names[gpu->wave]);
+        }
+        else {
+            g_snprintf(name, length, "Synthetic GPU (%s)", wave_names[gpu->wave]);
+        }
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_uuid(nvmlDevice_t device, char *uuid, unsigned int length)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        g_snprintf(uuid, length, "%s-00000000-0000-0000-0000-%012x",
+                   gpu->parent ? "MIG" : "GPU", gpu->index);
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_pci_info(nvmlDevice_t device, nvmlPciInfo_t *pci)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        if (gpu->parent)
+            return NVML_ERROR_NOT_SUPPORTED;
+        memset(pci, 0, sizeof(nvmlPciInfo_t));
+        pci->bus = gpu->index + 1;
+        g_snprintf(pci->busId, sizeof(pci->busId), "00000000:%02X:00.0", pci->bus);
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_temperature_threshold(nvmlDevice_t device,
+                                           nvmlTemperatureThresholds_t thresholdType,
+                                           unsigned int *temp)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        if ((synth.unsupported & UNSUPPORTED_TEMPERATURE) || gpu->parent)
+            return NVML_ERROR_NOT_SUPPORTED;
+        *temp = thresholdType == NVML_TEMPERATURE_THRESHOLD_SHUTDOWN ? 95 : 90;
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_utilization_rates(nvmlDevice_t device, nvmlUtilization_t *utilization)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        /* Like the driver, no utilization in MIG mode */
+        if (gpu->parent || gpu->n_migs > 0)
+            return NVML_ERROR_NOT_SUPPORTED;
+        utilization->gpu = (unsigned int) round(100 * synthetic_load(gpu, synthetic_time()));
+        utilization->memory = utilization->gpu / 2;
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_memory_info(nvmlDevice_t device, nvmlMemory_t *memory)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        memory->total = synth.memory * 1024 * 1024;
+        if (gpu->parent) {
+            memory->total /= gpu->parent->n_migs;
+        }
+        memory->used = (unsigned long long)
+                       ((0.1 + 0.8 * synthetic_load(gpu, synthetic_time())) * memory->total);
+        memory->free = memory->total - memory->used;
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_temperature(nvmlDevice_t device, nvmlTemperatureSensors_t sensorType,
+                                 unsigned int *temp)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        if ((synth.unsupported & UNSUPPORTED_TEMPERATURE) || gpu->parent)
+            return NVML_ERROR_NOT_SUPPORTED;
+        *temp = (unsigned int) round(35 + 50 * synthetic_load(gpu, synthetic_time()));
+    }
+    return result;
+}
+
+/* Power draw in milliwatts */
+static unsigned int
+synthetic_power(SyntheticGpu *gpu)
+{
+    return (unsigned int) round(30000 + 270000 * synthetic_load(gpu, synthetic_time()));
+}
+
+static nvmlReturn_t
+synthetic_device_get_power_usage(nvmlDevice_t device, unsigned int *power)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        if ((synth.unsupported & UNSUPPORTED_POWER) || gpu->parent)
+            return NVML_ERROR_NOT_SUPPORTED;
+        *power = synthetic_power(gpu);
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_current_clocks_throttle_reasons(nvmlDevice_t device,
+                                                     unsigned long long *reasons)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    gdouble load;
+    
+    if (result == NVML_SUCCESS) {
+        if ((synth.unsupported & UNSUPPORTED_THROTTLE) || gpu->parent)
+            return NVML_ERROR_NOT_SUPPORTED;
+        load = synthetic_load(gpu, synthetic_time());
+        *reasons = 0;
+        if (load * 100 <= 5)
+            *reasons |= nvmlClocksThrottleReasonGpuIdle;
+        if (load > 0.9)
+            *reasons |= nvmlClocksThrottleReasonSwPowerCap;
+        if (load > 0.95)
+            *reasons |= nvmlClocksThrottleReasonSwThermalSlowdown;
+    }
+    return result;
+}
+
+/* Load of a GPU integrated up to t, which the traffic counters follow.
+ * The integral only moves forward, so the counters are monotonic. */
+static gdouble
+synthetic_traffic(SyntheticGpu *gpu, gdouble t)
+{
+    gdouble dt;
+    
+    while (gpu->traffic_t < t) {
+        dt = MIN(SYNTHETIC_TRAFFIC_STEP, t - gpu->traffic_t);
+        gpu->traffic += synthetic_load(gpu, gpu->traffic_t + dt / 2) * dt;
+        gpu->traffic_t += dt;
+    }
+    return gpu->traffic;
+}
+
+static nvmlReturn_t
+synthetic_device_get_field_values(nvmlDevice_t device, int valuesCount,
+                                  nvmlFieldValue_t *values)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result != NVML_SUCCESS) {
+        return result;
+    }
+    if ((synth.unsupported & UNSUPPORTED_FIELDS) || gpu->parent) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+    
+    for (gint i = 0; i < valuesCount; ++i) {
+        nvmlFieldValue_t *fv = &values[i];
+        
+        fv->timestamp = g_get_real_time();
+        fv->latencyUsec = 0;
+        fv->nvmlReturn = NVML_ERROR_NOT_SUPPORTED;
+        switch (fv->fieldId) {
+#ifdef NVML_FI_DEV_NVLINK_LINK_COUNT
+            case NVML_FI_DEV_NVLINK_LINK_COUNT:
+                fv->valueType = NVML_VALUE_TYPE_UNSIGNED_INT;
+                fv->value.uiVal = synth.nvlinks;
+                fv->nvmlReturn = NVML_SUCCESS;
+                break;
+#endif
+#ifdef NVML_FI_DEV_PCIE_COUNT_TX_BYTES
+            case NVML_FI_DEV_PCIE_COUNT_TX_BYTES:
+            case NVML_FI_DEV_PCIE_COUNT_RX_BYTES:
+                /* Mostly host to device traffic */
+                fv->valueType = NVML_VALUE_TYPE_UNSIGNED_LONG_LONG;
+                fv->value.ullVal = (unsigned long long)
+                    (synthetic_traffic(gpu, synthetic_time()) * SYNTHETIC_PCIE_BPS
+                     * (fv->fieldId == NVML_FI_DEV_PCIE_COUNT_RX_BYTES ? 0.8 : 0.2));
+                fv->nvmlReturn = NVML_SUCCESS;
+                break;
+#endif
+#ifdef NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX
+            case NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_TX:
+            case NVML_FI_DEV_NVLINK_THROUGHPUT_DATA_RX:
+                /* In KiB, the later links less busy than the first */
+                if (fv->scopeId < (unsigned int) synth.nvlinks) {
+                    fv->valueType = NVML_VALUE_TYPE_UNSIGNED_LONG_LONG;
+                    fv->value.ullVal = (unsigned long long)
+                        (synthetic_traffic(gpu, synthetic_time()) * SYNTHETIC_NVLINK_BPS / 1024
+                         / (1 + fv->scopeId));
+                    fv->nvmlReturn = NVML_SUCCESS;
+                }
+                else {
+                    fv->nvmlReturn = NVML_ERROR_INVALID_ARGUMENT;
+                }
+                break;
+#endif
+#ifdef NVML_FI_DEV_POWER_INSTANT
+            case NVML_FI_DEV_POWER_INSTANT:
+                if (!(synth.unsupported & UNSUPPORTED_POWER)) {
+                    fv->valueType = NVML_VALUE_TYPE_UNSIGNED_INT;
+                    fv->value.uiVal = synthetic_power(gpu);
+                    fv->nvmlReturn = NVML_SUCCESS;
+                }
+                break;
+#endif
+            default:
+                break;
+        }
+    }
+    
+    return NVML_SUCCESS;
+}
+
+static nvmlReturn_t
+synthetic_device_get_samples(nvmlDevice_t device, nvmlSamplingType_t type,
+                             unsigned long long lastSeenTimeStamp,
+                             nvmlValueType_t *sampleValType,
+                             unsigned int *sampleCount, nvmlSample_t *samples)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    unsigned long long now, first, ts;
+    unsigned int n = 0;
+    
+    if (result != NVML_SUCCESS) {
+        return result;
+    }
+    if ((synth.unsupported & UNSUPPORTED_SAMPLES) || type != NVML_GPU_UTILIZATION_SAMPLES
+        || gpu->parent || gpu->n_migs > 0) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+    
+    *sampleValType = NVML_VALUE_TYPE_UNSIGNED_INT;
+    if (!samples) {
+        *sampleCount = SYNTHETIC_SAMPLE_BUFFER;
+        return NVML_SUCCESS;
+    }
+    
+    /* Samples sit on a fixed grid after Init; hand out the ones newer
+     * than lastSeenTimeStamp that still fit in the driver buffer */
+    now = g_get_real_time();
+    first = MAX(lastSeenTimeStamp + 1,
+                now - (unsigned long long) SYNTHETIC_SAMPLE_PERIOD_US * SYNTHETIC_SAMPLE_BUFFER);
+    first = MAX(first, (unsigned long long) synth.real_start);
+    ts = synth.real_start
+         + ((first - synth.real_start + SYNTHETIC_SAMPLE_PERIOD_US - 1) / SYNTHETIC_SAMPLE_PERIOD_US)
+           * SYNTHETIC_SAMPLE_PERIOD_US;
+    for (; ts <= now && n < *sampleCount; ts += SYNTHETIC_SAMPLE_PERIOD_US, ++n) {
+        samples[n].timeStamp = ts;
+        samples[n].sampleValue.uiVal = (unsigned int)
+            round(100 * synthetic_load(gpu, (ts - synth.real_start) / (gdouble) G_USEC_PER_SEC));
+    }
+    
+    *sampleCount = n;
+    return n > 0 ? NVML_SUCCESS : NVML_ERROR_NOT_FOUND;
+}
+
+/* Process j of a device.  The first is the monitoring process itself so
+ * that its name resolves; the others have PIDs unlikely to exist. */
+static unsigned int
+synthetic_process_pid(SyntheticGpu *gpu, gint j)
+{
+    return j == 0 ? (unsigned int) getpid() : 400000 + gpu->index * SYNTHETIC_MAX_PROCS + j;
+}
+
+/* Share of the device load and memory taken by process j, decreasing
+ * with j and summing to 1 */
+static gdouble
+synthetic_process_share(gint j)
+{
+    return 2.0 * (synth.procs - j) / (synth.procs * (synth.procs + 1));
+}
+
+/* List the processes of a device into infos, up to max of them, and
+ * return how many there are.  A GPU in MIG mode runs the processes of
+ * its MIG devices; with graphics only the first process is listed. */
+static unsigned int
+synthetic_list_processes(SyntheticGpu *gpu, gboolean graphics, gdouble t,
+                         nvmlProcessInfo_t *infos, unsigned int max)
+{
+    unsigned int n = 0;
+    unsigned long long used;
+    
+    if (gpu->n_migs > 0) {
+        for (gint i = 0; i < gpu->n_migs; ++i) {
+            n += synthetic_list_processes(&gpu->migs[i], graphics, t,
+                                          infos ? infos + MIN(n, max) : NULL,
+                                          max > n ? max - n : 0);
+        }
+        return n;
+    }
+    
+    used = (unsigned long long) ((0.1 + 0.8 * synthetic_load(gpu, t)) * synth.memory * 1024 * 1024);
+    if (gpu->parent) {
+        used /= gpu->parent->n_migs;
+    }
+    for (gint j = 0; j < (graphics ? MIN(synth.procs, 1) : synth.procs); ++j, ++n) {
+        if (n < max) {
+            memset(&infos[n], 0, sizeof(nvmlProcessInfo_t));
+            infos[n].pid = synthetic_process_pid(gpu, j);
+            infos[n].usedGpuMemory = (unsigned long long) (used * synthetic_process_share(j));
+            infos[n].gpuInstanceId = gpu->parent ? gpu->gpu_instance_id : 0xFFFFFFFF;
+            infos[n].computeInstanceId = gpu->parent ? 0 : 0xFFFFFFFF;
+        }
+    }
+    return n;
+}
+
+static nvmlReturn_t
+synthetic_running_processes(nvmlDevice_t device, gboolean graphics,
+                            unsigned int *infoCount, nvmlProcessInfo_t *infos)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    unsigned int n;
+    
+    if (result != NVML_SUCCESS) {
+        return result;
+    }
+    if (synth.unsupported & UNSUPPORTED_PROCS) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+    
+    n = synthetic_list_processes(gpu, graphics, synthetic_time(),
+                                 infos, infos ? *infoCount : 0);
+    result = (n > *infoCount || (!infos && n > 0)) ? NVML_ERROR_INSUFFICIENT_SIZE
+                                                   : NVML_SUCCESS;
+    *infoCount = n;
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_compute_running_processes(nvmlDevice_t device, unsigned int *infoCount,
+                                               nvmlProcessInfo_t *infos)
+{
+    return synthetic_running_processes(device, FALSE, infoCount, infos);
+}
+
+static nvmlReturn_t
+synthetic_device_get_graphics_running_processes(nvmlDevice_t device, unsigned int *infoCount,
+                                                nvmlProcessInfo_t *infos)
+{
+    return synthetic_running_processes(device, TRUE, infoCount, infos);
+}
+
+/* One utilization sample per process, taken on the driver sample grid */
+static nvmlReturn_t
+synthetic_device_get_process_utilization(nvmlDevice_t device,
+                                         nvmlProcessUtilizationSample_t *utilization,
+                                         unsigned int *processSamplesCount,
+                                         unsigned long long lastSeenTimeStamp)
+{
+    SyntheticGpu *gpu, *leaf;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    nvmlProcessInfo_t infos[SYNTHETIC_MAX_MIG * SYNTHETIC_MAX_PROCS];
+    unsigned long long ts;
+    unsigned int n;
+    gdouble t;
+    
+    if (result != NVML_SUCCESS) {
+        return result;
+    }
+    if (synth.unsupported & UNSUPPORTED_PROCS) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+    
+    ts = synth.real_start
+         + ((g_get_real_time() - synth.real_start) / SYNTHETIC_SAMPLE_PERIOD_US)
+           * SYNTHETIC_SAMPLE_PERIOD_US;
+    t = (ts - synth.real_start) / (gdouble) G_USEC_PER_SEC;
+    n = synthetic_list_processes(gpu, FALSE, t, infos, G_N_ELEMENTS(infos));
+    if (!utilization || *processSamplesCount < n) {
+        *processSamplesCount = n;
+        return NVML_ERROR_INSUFFICIENT_SIZE;
+    }
+    if (ts <= lastSeenTimeStamp || n == 0) {
+        *processSamplesCount = 0;
+        return NVML_ERROR_NOT_FOUND;
+    }
+    
+    for (unsigned int i = 0; i < n; ++i) {
+        gint j = i % synth.procs;
+        
+        leaf = gpu->n_migs > 0 ? &gpu->migs[i / synth.procs] : gpu;
+        memset(&utilization[i], 0, sizeof(nvmlProcessUtilizationSample_t));
+        utilization[i].pid = infos[i].pid;
+        utilization[i].timeStamp = ts;
+        utilization[i].smUtil = (unsigned int)
+            round(100 * synthetic_load(leaf, t) * synthetic_process_share(j));
+        utilization[i].memUtil = utilization[i].smUtil / 2;
+    }
+    
+    *processSamplesCount = n;
+    return NVML_SUCCESS;
+}
+
+static const unsigned long long synthetic_event_types =
+    nvmlEventTypeXidCriticalError | nvmlEventTypeClock | nvmlEventTypePState;
+
+static nvmlReturn_t
+synthetic_event_set_create(nvmlEventSet_t *set)
+{
+    SyntheticEventSet *es;
+    
+    if (synth.start == 0) {
+        return NVML_ERROR_UNINITIALIZED;
+    }
+    es = g_new0(SyntheticEventSet, 1);
+    es->gpus = g_ptr_array_new();
+    es->types = g_array_new(FALSE, FALSE, sizeof(unsigned long long));
+    g_queue_init(&es->pending);
+    es->checked_t = synthetic_time();
+    *set = (nvmlEventSet_t) es;
+    return NVML_SUCCESS;
+}
+
+static nvmlReturn_t
+synthetic_device_get_supported_event_types(nvmlDevice_t device, unsigned long long *eventTypes)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        *eventTypes = gpu->parent ? 0 : synthetic_event_types;
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_register_events(nvmlDevice_t device, unsigned long long eventTypes,
+                                 nvmlEventSet_t set)
+{
+    SyntheticEventSet *es = (SyntheticEventSet *) set;
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result != NVML_SUCCESS) {
+        return result;
+    }
+    if (gpu->parent || (eventTypes & ~synthetic_event_types)) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+    g_ptr_array_add(es->gpus, gpu);
+    g_array_append_val(es->types, eventTypes);
+    return NVML_SUCCESS;
+}
+
+/* Queue an event for the GPU if it registered for the type */
+static void
+synthetic_queue_event(SyntheticEventSet *es, gint i, unsigned long long type,
+                      unsigned long long data)
+{
+    nvmlEventData_t *event;
+    
+    if (!(g_array_index(es->types, unsigned long long, i) & type)) {
+        return;
+    }
+    event = g_new0(nvmlEventData_t, 1);
+    event->device = (nvmlDevice_t) g_ptr_array_index(es->gpus, i);
+    event->eventType = type;
+    event->eventData = data;
+    event->gpuInstanceId = 0xFFFFFFFF;
+    event->computeInstanceId = 0xFFFFFFFF;
+    g_queue_push_tail(&es->pending, event);
+}
+
+/* Queue the events of the registered GPUs between checked_t and t */
+static void
+synthetic_find_events(SyntheticEventSet *es, gdouble t)
+{
+    SyntheticGpu *gpu;
+    gdouble before, after;
+    
+    for (guint i = 0; i < es->gpus->len; ++i) {
+        gpu = g_ptr_array_index(es->gpus, i);
+        before = synthetic_load(gpu, es->checked_t);
+        after = synthetic_load(gpu, t);
+        
+        if (gpu->xid_after >= 0 && es->checked_t < gpu->xid_after && gpu->xid_after <= t) {
+            synthetic_queue_event(es, i, nvmlEventTypeXidCriticalError, SYNTHETIC_XID);
+        }
+        if ((before < 0.5) != (after < 0.5)) {
+            synthetic_queue_event(es, i, nvmlEventTypeClock, 0);
+        }
+        if ((before <= 0.05) != (after <= 0.05)) {
+            synthetic_queue_event(es, i, nvmlEventTypePState, 0);
+        }
+    }
+    es->checked_t = t;
+}
+
+static nvmlReturn_t
+synthetic_event_set_wait(nvmlEventSet_t set, nvmlEventData_t *data, unsigned int timeoutms)
+{
+    SyntheticEventSet *es = (SyntheticEventSet *) set;
+    gint64 deadline = g_get_monotonic_time() + (gint64) timeoutms * 1000;
+    nvmlEventData_t *event;
+    
+    if (synth.start == 0) {
+        return NVML_ERROR_UNINITIALIZED;
+    }
+    
+    for (;;) {
+        if (g_queue_is_empty(&es->pending)) {
+            synthetic_find_events(es, synthetic_time());
+        }
+        event = g_queue_pop_head(&es->pending);
+        if (event) {
+            *data = *event;
+            g_free(event);
+            return NVML_SUCCESS;
+        }
+        if (g_get_monotonic_time() >= deadline) {
+            return NVML_ERROR_TIMEOUT;
+        }
+        g_usleep(MIN(SYNTHETIC_EVENT_POLL_US, deadline - g_get_monotonic_time() + 1));
+    }
+}
+
+static nvmlReturn_t
+synthetic_event_set_free(nvmlEventSet_t set)
+{
+    SyntheticEventSet *es = (SyntheticEventSet *) set;
+    
+    g_ptr_array_free(es->gpus, TRUE);
+    g_array_free(es->types, TRUE);
+    g_queue_foreach(&es->pending, (GFunc) g_free, NULL);
+    g_queue_clear(&es->pending);
+    g_free(es);
+    return NVML_SUCCESS;
+}
+
+static nvmlReturn_t
+synthetic_device_get_mig_mode(nvmlDevice_t device, unsigned int *currentMode,
+                              unsigned int *pendingMode)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        if (gpu->parent)
+            return NVML_ERROR_NOT_SUPPORTED;
+        *currentMode = *pendingMode = gpu->n_migs > 0 ? NVML_DEVICE_MIG_ENABLE
+                                                      : NVML_DEVICE_MIG_DISABLE;
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_max_mig_device_count(nvmlDevice_t device, unsigned int *count)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        if (gpu->parent)
+            return NVML_ERROR_NOT_SUPPORTED;
+        *count = SYNTHETIC_MAX_MIG;
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_device_get_mig_device_handle_by_index(nvmlDevice_t device, unsigned int index,
+                                                nvmlDevice_t *migDevice)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result != NVML_SUCCESS) {
+        return result;
+    }
+    if (gpu->parent || index >= SYNTHETIC_MAX_MIG) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+    /* Unused slots are empty, as with a partially partitioned GPU */
+    if (index >= (unsigned int) gpu->n_migs) {
+        return NVML_ERROR_NOT_FOUND;
+    }
+    *migDevice = (nvmlDevice_t) &gpu->migs[index];
+    return NVML_SUCCESS;
+}
+
+static nvmlReturn_t
+synthetic_device_get_gpu_instance_id(nvmlDevice_t device, unsigned int *id)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        if (!gpu->parent)
+            return NVML_ERROR_NOT_SUPPORTED;
+        *id = gpu->gpu_instance_id;
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_gpm_query_device_support(nvmlDevice_t device, nvmlGpmSupport_t *gpmSupport)
+{
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result == NVML_SUCCESS) {
+        gpmSupport->isSupportedDevice = !(synth.unsupported & UNSUPPORTED_GPM);
+    }
+    return result;
+}
+
+static nvmlReturn_t
+synthetic_gpm_sample_alloc(nvmlGpmSample_t *gpmSample)
+{
+    *gpmSample = (nvmlGpmSample_t) g_new0(SyntheticGpmSample, 1);
+    return NVML_SUCCESS;
+}
+
+static nvmlReturn_t
+synthetic_gpm_sample_free(nvmlGpmSample_t gpmSample)
+{
+    g_free(gpmSample);
+    return NVML_SUCCESS;
+}
+
+static nvmlReturn_t
+synthetic_gpm_mig_sample_get(nvmlDevice_t device, unsigned int gpuInstanceId,
+                             nvmlGpmSample_t gpmSample)
+{
+    SyntheticGpmSample *sample = (SyntheticGpmSample *) gpmSample;
+    SyntheticGpu *gpu;
+    nvmlReturn_t result = synthetic_enter(device, &gpu);
+    
+    if (result != NVML_SUCCESS) {
+        return result;
+    }
+    if (synth.unsupported & UNSUPPORTED_GPM) {
+        return NVML_ERROR_NOT_SUPPORTED;
+    }
+    
+    for (gint i = 0; i < gpu->n_migs; ++i) {
+        if (gpu->migs[i].gpu_instance_id == gpuInstanceId) {
+            sample->gpu = &gpu->migs[i];
+            sample->t = synthetic_time();
+            return NVML_SUCCESS;
+        }
+    }
+    return NVML_ERROR_NOT_FOUND;
+}
+
+/* The graphics utilization of a MIG device is its mean load between the
+ * two samples */
+static nvmlReturn_t
+synthetic_gpm_metrics_get(nvmlGpmMetricsGet_t *metricsGet)
+{
+    SyntheticGpmSample *s1 = (SyntheticGpmSample *) metricsGet->sample1;
+    SyntheticGpmSample *s2 = (SyntheticGpmSample *) metricsGet->sample2;
+    gdouble sum, dt;
+    gint i, j;
+    
+    if (!s1 || !s2 || !s1->gpu || s1->gpu != s2->gpu) {
+        return NVML_ERROR_INVALID_ARGUMENT;
+    }
+    
+    dt = (s2->t - s1->t) / 16;
+    for (i = 0; i < (gint) metricsGet->numMetrics; ++i) {
+        nvmlGpmMetric_t *metric = &metricsGet->metrics[i];
+        
+        if (metric->metricId != NVML_GPM_METRIC_GRAPHICS_UTIL) {
+            metric->nvmlReturn = NVML_ERROR_NOT_SUPPORTED;
+            continue;
+        }
+        for (j = 0, sum = 0.0; j < 16; ++j) {
+            sum += synthetic_load(s1->gpu, s1->t + (j + 0.5) * dt);
+        }
+        metric->value = 100 * sum / 16;
+        metric->nvmlReturn = NVML_SUCCESS;
+    }
+    
+    return NVML_SUCCESS;
+}
+
+static const GpuBackend gpu_backend_synthetic_table = {
+    .name                          = "synthetic",
+    
+    .Init                          = synthetic_init,
+    .Shutdown                      = synthetic_shutdown,
+    .ErrorString                   = synthetic_error_string,
+    
+    .DeviceGetCount                = synthetic_device_get_count,
+    .DeviceGetHandleByIndex        = synthetic_device_get_handle_by_index,
+    .DeviceGetHandleByUUID         = synthetic_device_get_handle_by_uuid,
+    .DeviceGetName                 = synthetic_device_get_name,
+    .DeviceGetUUID                 = synthetic_device_get_uuid,
+    .DeviceGetPciInfo              = synthetic_device_get_pci_info,
+    .DeviceGetTemperatureThreshold = synthetic_device_get_temperature_threshold,
+    
+    .DeviceGetUtilizationRates     = synthetic_device_get_utilization_rates,
+    .DeviceGetMemoryInfo           = synthetic_device_get_memory_info,
+    .DeviceGetTemperature          = synthetic_device_get_temperature,
+    .DeviceGetPowerUsage           = synthetic_device_get_power_usage,
+    .DeviceGetCurrentClocksThrottleReasons = synthetic_device_get_current_clocks_throttle_reasons,
+    .DeviceGetFieldValues          = synthetic_device_get_field_values,
+    .DeviceGetSamples              = synthetic_device_get_samples,
+    
+    .DeviceGetComputeRunningProcesses  = synthetic_device_get_compute_running_processes,
+    .DeviceGetGraphicsRunningProcesses = synthetic_device_get_graphics_running_processes,
+    .DeviceGetProcessUtilization   = synthetic_device_get_process_utilization,
+    
+    .EventSetCreate                = synthetic_event_set_create,
+    .DeviceGetSupportedEventTypes  = synthetic_device_get_supported_event_types,
+    .DeviceRegisterEvents          = synthetic_device_register_events,
+    .EventSetWait                  = synthetic_event_set_wait,
+    .EventSetFree                  = synthetic_event_set_free,
+    
+    .DeviceGetMigMode              = synthetic_device_get_mig_mode,
+    .DeviceGetMaxMigDeviceCount    = synthetic_device_get_max_mig_device_count,
+    .DeviceGetMigDeviceHandleByIndex = synthetic_device_get_mig_device_handle_by_index,
+    .DeviceGetGpuInstanceId        = synthetic_device_get_gpu_instance_id,
+    
+    .GpmQueryDeviceSupport         = synthetic_gpm_query_device_support,
+    .GpmSampleAlloc                = synthetic_gpm_sample_alloc,
+    .GpmSampleFree                 = synthetic_gpm_sample_free,
+    .GpmMigSampleGet               = synthetic_gpm_mig_sample_get,
+    .GpmMetricsGet                 = synthetic_gpm_metrics_get,
+};
+
+const GpuBackend *
+gpu_backend_synthetic(const gchar *spec)
+{
+    synthetic_configure(spec);
+    return &gpu_backend_synthetic_table;
+}
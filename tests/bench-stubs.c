@@ -0,0 +1,111 @@
+/* Stand-ins for the GKrellM and GTK functions used by the plugin.
+ *
+ * This file deliberately does not include gkrellm.h: the stubs only need
+ * to satisfy the dynamic linker and do just enough to let create_monitor
+ * and update_monitor run headless.  Anything that needs the real
+ * structure layouts is done by the bench_* helpers in bench.c. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Helpers from bench.c */
+extern void *bench_chart_new(void);
+extern void *bench_panel_new(void);
+extern void *bench_krell_new(void *panel);
+extern void *bench_decal_new(void);
+extern void bench_register_draw(void *func, void *data);
+
+/* Objects and constants */
+void *gkrellm_chart_new0(void) { return bench_chart_new(); }
+void *gkrellm_panel_new0(void) { return bench_panel_new(); }
+void *gkrellm_panel_style(int id) { return NULL; }
+void *gkrellm_krell_panel_piximage(int id) { return NULL; }
+void *gkrellm_panel_alt_textstyle(int id) { return NULL; }
+void *gkrellm_create_krell(void *p, void *im, void *style) { return bench_krell_new(p); }
+void *gkrellm_create_decal_text(void *p, char *s, void *ts, void *style, int x, int y, int w) { return bench_decal_new(); }
+void *gkrellm_add_default_chartdata(void *cp, char *label) { return bench_decal_new(); }
+int gkrellm_add_chart_style(void *mon, char *name) { return 0; }
+char *gkrellm_get_hostname(void) { return "bench"; }
+/* History files go under $TMPDIR rather than the real home directory */
+char *gkrellm_homedir(void) { return getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp"; }
+int gkrellm_demo_mode(void) { return 0; }
+int gkrellm_client_mode(void) { return 0; }
+void gkrellm_client_plugin_get_setup(char *key, void *func) {}
+void gkrellm_client_plugin_serve_data_connect(void *mon, char *key, void *func) {}
+
+/* Strings, the plugin frees these itself */
+void
+gkrellm_locale_dup_string(char **dst, char *src, char **locale)
+{
+    if (*locale && *locale != *dst)
+        free(*locale);
+    free(*dst);
+    *dst = strdup(src);
+    *locale = *dst;
+}
+
+/* Chart and panel setup */
+void gkrellm_chart_create(void *box, void *mon, void *cp, void **cconfig) {}
+void gkrellm_set_draw_chart_function(void *cp, void *func, void *data) { bench_register_draw(func, data); }
+void gkrellm_monotonic_chartdata(void *cd, int value) {}
+void gkrellm_set_chartdata_draw_style_default(void *cd, int style) {}
+void gkrellm_set_chartdata_flags(void *cd, int flags) {}
+void gkrellm_chartconfig_grid_resolution_adjustment(void *cf, int map, float spin_factor,
+        float low, float high, float step0, float step1, int digits, int width) {}
+void gkrellm_panel_configure(void *p, char *label, void *style) {}
+void gkrellm_panel_create(void *box, void *mon, void *p) {}
+void gkrellm_panel_destroy(void *p) {}
+void gkrellm_set_krell_full_scale(void *k, int full_scale, int scaling) {}
+void gkrellm_setup_launcher(void *p, void *launch, int type, int pad) {}
+void gkrellm_alloc_chartdata(void *cp) {}
+void gkrellm_reset_chart(void *cp) {}
+void gkrellm_chartconfig_grid_resolution_label(void *cf, char *label) {}
+void gkrellm_set_chart_height_default(void *cp, int h) {}
+void gkrellm_chart_hide(void *cp, int do_panel) {}
+void gkrellm_chart_show(void *cp, int do_panel) {}
+void gkrellm_build(void) {}
+void gkrellm_make_decal_visible(void *p, void *d) {}
+int gkrellm_is_decal_visible(void *d) { return 1; }
+
+/* Drawing, all no-ops */
+void gkrellm_store_chartdata(void *cp, unsigned long total, ...) {}
+void gkrellm_store_chartdatav(void *cp, unsigned long *data) {}
+void gkrellm_draw_chartdata(void *cp) {}
+void gkrellm_draw_chart_text(void *cp, int style_id, char *s) {}
+void gkrellm_draw_chart_to_screen(void *cp) {}
+void gkrellm_update_krell(void *p, void *k, unsigned long value) {}
+void gkrellm_draw_panel_layers(void *p) {}
+void gkrellm_draw_decal_text(void *p, void *d, char *s, int value) {}
+void gkrellm_draw_panel_label(void *p) {}
+
+/* Config window, never opened by the benchmark */
+void gkrellm_config_modified(void) {}
+void gkrellm_chartconfig_window_create(void *cp) {}
+void *gkrellm_gtk_framed_notebook_page(void *tabs, char *name) { return NULL; }
+void *gkrellm_gtk_category_vbox(void *box, char *name, int h, int v, int homo) { return NULL; }
+void *gkrellm_gtk_scrolled_vbox(void *box, void **scr, int h, int v) { return NULL; }
+void *gkrellm_gtk_scrolled_text_view(void *box, void **scr, int h, int v) { return NULL; }
+void *gkrellm_gtk_launcher_table_new(void *box, int n) { return NULL; }
+void *gkrellm_gtk_entry_get_text(void **entry) { return ""; }
+void gkrellm_gtk_check_button_connected(void) {}
+void gkrellm_gtk_spin_button(void) {}
+void gkrellm_gtk_text_view_append(void *view, char *s) {}
+
+/* GTK calls made while creating the panels */
+void *gtk_vbox_new(int homogeneous, int spacing) { return NULL; }
+void gtk_container_add(void *container, void *widget) {}
+void gtk_widget_show(void *widget) {}
+void gtk_widget_set_tooltip_text(void *widget, const char *text) {}
+unsigned long g_signal_connect_data(void *instance, const char *signal, void *handler,
+                                    void *data, void *destroy, int flags) { return 0; }
+
+/* GDK drawing for the heat map, on placeholder objects */
+static char gdk_object;
+void *gdk_pixmap_new(void *drawable, int w, int h, int depth) { return &gdk_object; }
+void *gdk_gc_new(void *drawable) { return &gdk_object; }
+void g_object_unref(void *object) {}
+void gdk_gc_set_rgb_fg_color(void *gc, const void *color) {}
+void gdk_draw_rectangle(void *drawable, void *gc, int filled, int x, int y, int w, int h) {}
+void gdk_draw_drawable(void *drawable, void *gc, void *src, int xsrc, int ysrc,
+                       int xdest, int ydest, int w, int h) {}
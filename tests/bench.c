@@ -0,0 +1,345 @@
+/* Headless per-tick latency benchmark for the GPU plugin.
+ *
+ * Loads gpu-plugin.so against the synthetic sampling backend and stubbed
+ * GKrellM functions (bench-stubs.c), then drives create_monitor and
+ * update_monitor at the GKrellM tick rate for several GPU counts.  For
+ * each count it reports the wall time of update_monitor, allocations
+ * per tick, NVML calls per tick and the time until the plugin has found
+ * the GPUs.  It also times the label formatting and config loading paths
+ * on their own.
+ *
+ * Usage: bench [-t ticks] [-r ticks_per_second]
+ */
+
+#define _GNU_SOURCE
+#include <gkrellm2/gkrellm.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_CALLBACKS 1024
+#define FORMAT_ITERATIONS 100000
+#define CONFIG_ITERATIONS 1000
+
+typedef GkrellmMonitor *(*init_plugin_func)(void);
+typedef void (*draw_func)(gpointer data);
+typedef void (*command_func)(gint slot, gchar *src, gchar *buf, gint size);
+
+GkrellmTicks GK;
+
+static int n_migs = 0;
+static int n_nvlinks = -1;           /* Chart interconnect traffic over this many NVLinks */
+static int grid_display = 0;
+static const int gpu_counts[] = { 1, 4, 8, 16, 64 };
+
+static struct {
+    gpointer func, data;
+} draws[MAX_CALLBACKS];
+static int n_draws;
+static command_func format_command;
+
+/* Allocation counting */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static volatile int counting = 0;
+static unsigned long n_allocs = 0;
+
+void *
+malloc(size_t size)
+{
+    if (counting)
+        __atomic_fetch_add(&n_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+void *
+calloc(size_t n, size_t size)
+{
+    if (counting)
+        __atomic_fetch_add(&n_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_calloc(n, size);
+}
+
+void *
+realloc(void *ptr, size_t size)
+{
+    if (counting)
+        __atomic_fetch_add(&n_allocs, 1, __ATOMIC_RELAXED);
+    return __libc_realloc(ptr, size);
+}
+
+/* Helpers for bench-stubs.c that need the GKrellM structure layouts.
+ * Charts get a size and placeholder pixmaps so the heat map draws. */
+static char bench_pixmap;
+
+void *
+bench_chart_new(void)
+{
+    GkrellmChart *cp = calloc(1, sizeof(GkrellmChart));
+
+    cp->w = 60;
+    cp->h = 40;
+    cp->pixmap = cp->bg_pixmap = (GdkPixmap *) &bench_pixmap;
+    return cp;
+}
+
+
+void *bench_panel_new(void) { return calloc(1, sizeof(GkrellmPanel)); }
+void *bench_decal_new(void) { return calloc(1, sizeof(GkrellmDecal)); }
+
+void *
+bench_krell_new(void *panel)
+{
+    GkrellmPanel *p = panel;
+    GkrellmKrell *k = calloc(1, sizeof(GkrellmKrell));
+
+    p->krell = g_list_append(p->krell, k);
+    return k;
+}
+
+void
+bench_register_draw(void *func, void *data)
+{
+    if (n_draws < MAX_CALLBACKS) {
+        draws[n_draws].func = func;
+        draws[n_draws++].data = data;
+    }
+}
+
+static double
+now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+
+    return (x > y) - (x < y);
+}
+
+/* Time a config line through load_user_config */
+static void
+bench_config(GkrellmMonitor *mon, int n_gpus)
+{
+    char line[128];
+    unsigned long allocs;
+    double t0, dt;
+    int i, j;
+
+    allocs = n_allocs;
+    counting = 1;
+    t0 = now_us();
+    for (i = 0; i < CONFIG_ITERATIONS; ++i) {
+        mon->load_user_config("text_format \\f$L\\n$u $m");
+        mon->load_user_config("interval utilization 250");
+        for (j = 0; j < n_gpus; ++j) {
+            snprintf(line, sizeof(line), "enabled gpu%d 1", j);
+            mon->load_user_config(line);
+            snprintf(line, sizeof(line), "extra_info gpu%d 1", j);
+            mon->load_user_config(line);
+        }
+    }
+    dt = now_us() - t0;
+    counting = 0;
+
+    printf("    load_gpu_config: %8.2f us/pass  %6.1f allocs/pass\n",
+           dt / CONFIG_ITERATIONS, (double) (n_allocs - allocs) / CONFIG_ITERATIONS);
+}
+
+/* Time the label formatting through the alert command and chart paths */
+static void
+bench_format(void)
+{
+    char buf[256];
+    unsigned long allocs;
+    double t0, dt;
+    int i;
+
+    if (format_command) {
+        allocs = n_allocs;
+        counting = 1;
+        t0 = now_us();
+        for (i = 0; i < FORMAT_ITERATIONS; ++i)
+            format_command(0, "$L $H: $u $m $U/$T $t $W $A $[u:mean:15] $[t:p95:5]", buf, sizeof(buf));
+        dt = now_us() - t0;
+        counting = 0;
+        printf("    format_gpu_data: %8.3f us/call  %6.2f allocs/call  \"%s\"\n",
+               dt / FORMAT_ITERATIONS, (double) (n_allocs - allocs) / FORMAT_ITERATIONS, buf);
+    }
+
+    if (n_draws > 0) {
+        draw_func func = (draw_func) draws[0].func;
+
+        allocs = n_allocs;
+        counting = 1;
+        t0 = now_us();
+        for (i = 0; i < FORMAT_ITERATIONS; ++i)
+            func(draws[0].data);
+        dt = now_us() - t0;
+        counting = 0;
+        printf("    chart refresh:   %8.3f us/call  %6.2f allocs/call\n",
+               dt / FORMAT_ITERATIONS, (double) (n_allocs - allocs) / FORMAT_ITERATIONS);
+    }
+}
+
+static int
+bench_gpus(int n_gpus, int ticks, int rate)
+{
+    void *handle;
+    init_plugin_func init;
+    GkrellmMonitor *mon;
+    gint *nvml_calls, *startup_us;
+    double *times, t0, next, sum = 0;
+    unsigned long allocs = 0, allocs0;
+    gint calls0;
+    char spec[128];
+    int i;
+
+    snprintf(spec, sizeof(spec), "gpus=%d,wave=random,mig=%d,nvlinks=%d",
+             n_gpus, n_migs, n_nvlinks > 0 ? n_nvlinks : 0);
+    setenv("GKRELLM_GPU_BACKEND", "synthetic", 1);
+    setenv("GKRELLM_GPU_SYNTHETIC", spec, 1);
+    n_draws = 0;
+
+    handle = dlopen("gpu-plugin.so", RTLD_NOW | RTLD_LOCAL);
+    if (!handle) {
+        fprintf(stderr, "Error loading plugin: %s\n", dlerror());
+        return 1;
+    }
+    init = (init_plugin_func) dlsym(handle, "gkrellm_init_plugin");
+    nvml_calls = (gint *) dlsym(handle, "gpu_nvml_calls_total");
+    startup_us = (gint *) dlsym(handle, "gpu_startup_us");
+    format_command = (command_func) dlsym(handle, "gpu_format_command");
+    if (!init || !nvml_calls || !startup_us || !format_command) {
+        fprintf(stderr, "Error finding plugin symbols: %s\n", dlerror());
+        dlclose(handle);
+        return 1;
+    }
+
+    mon = init();
+    if (!mon) {
+        fprintf(stderr, "Plugin init failed for %d GPUs\n", n_gpus);
+        dlclose(handle);
+        return 1;
+    }
+    mon->load_user_config("alert utilization 1 90 80 0");
+    if (grid_display)
+        mon->load_user_config("grid_display 1");
+    if (n_nvlinks >= 0)
+        mon->load_user_config("interconnect 1");
+    mon->create_monitor(NULL, 1);
+
+    /* The GPUs are found in the background; the plugin takes them over
+     * on an update and then rebuilds, which the stubs leave to us */
+    t0 = now_us();
+    while (!__atomic_load_n(startup_us, __ATOMIC_RELAXED)) {
+        if (now_us() - t0 > 10e6) {
+            fprintf(stderr, "Plugin did not find the GPUs for %d GPUs\n", n_gpus);
+            mon->undef2();
+            dlclose(handle);
+            return 1;
+        }
+        mon->update_monitor();
+        usleep(1000);
+    }
+    mon->create_monitor(NULL, 0);
+
+    times = calloc(ticks, sizeof(double));
+    calls0 = __atomic_load_n(nvml_calls, __ATOMIC_RELAXED);
+    next = now_us();
+    for (i = 0; i < ticks; ++i) {
+        GK.second_tick = (i % rate == 0);
+        GK.two_second_tick = (i % (2 * rate) == 0);
+
+        allocs0 = n_allocs;
+        counting = 1;
+        t0 = now_us();
+        mon->update_monitor();
+        times[i] = now_us() - t0;
+        counting = 0;
+        allocs += n_allocs - allocs0;
+        sum += times[i];
+
+        next += 1e6 / rate;
+        t0 = now_us();
+        if (next > t0)
+            usleep((useconds_t) (next - t0));
+    }
+
+    qsort(times, ticks, sizeof(double), cmp_double);
+    printf("%5d %8.1f %8.1f %8.1f %8.1f %12.2f %10.2f %9.1f\n", n_gpus,
+           sum / ticks, times[ticks / 2], times[(int) (ticks * 0.99)], times[ticks - 1],
+           (double) allocs / ticks,
+           (double) (__atomic_load_n(nvml_calls, __ATOMIC_RELAXED) - calls0) / ticks,
+           *startup_us / 1000.0);
+    free(times);
+
+    bench_format();
+    bench_config(mon, n_gpus);
+
+    mon->undef2();
+    dlclose(handle);
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    int ticks = 100, rate = 10, opt;
+    size_t i;
+
+    while ((opt = getopt(argc, argv, "t:r:m:gl:")) != -1) {
+        switch (opt) {
+            case 't':
+                ticks = atoi(optarg);
+                break;
+            case 'r':
+                rate = atoi(optarg);
+                break;
+            case 'm':
+                n_migs = atoi(optarg);
+                break;
+            case 'g':
+                grid_display = 1;
+                break;
+            case 'l':
+                n_nvlinks = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-t ticks] [-r ticks_per_second] [-m migs_per_gpu] [-g] [-l nvlinks]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (ticks < 1 || rate < 1) {
+        fprintf(stderr, "ticks and rate must be positive\n");
+        return 1;
+    }
+
+    printf("%d ticks at %d ticks/s, update_monitor wall time in us\n", ticks, rate);
+    if (n_migs > 0)
+        printf("%d MIG devices per GPU\n", n_migs);
+    if (grid_display)
+        printf("heat map display\n");
+    if (n_nvlinks >= 0)
+        printf("interconnect charts, %d NVLinks per GPU\n", n_nvlinks);
+    printf("%5s %8s %8s %8s %8s %12s %10s %9s\n",
+           "gpus", "mean", "p50", "p99", "max", "allocs/tick", "nvml/tick", "start ms");
+    for (i = 0; i < sizeof(gpu_counts) / sizeof(gpu_counts[0]); ++i) {
+        if (bench_gpus(gpu_counts[i], ticks, rate))
+            return 1;
+    }
+
+    return 0;
+}